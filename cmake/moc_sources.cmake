@@ -25,6 +25,8 @@ set (bluecherry_client_MOC_SRCS
     src/core/LiveStream.h
     src/core/LiveViewManager.h
     src/core/MJpegStream.h
+    src/core/MJpegStreamIoThread.h
+    src/core/MJpegStreamReader.h
     src/core/PtzPresetsModel.h
     src/core/ServerRequestManager.h
     src/core/TransferRateCalculator.h
@@ -39,6 +41,9 @@ set (bluecherry_client_MOC_SRCS
     src/event/ThumbnailManager.h
 
     src/rtsp-stream/RtspStream.h
+    src/rtsp-stream/RtspStreamReconnectScheduler.h
+    src/rtsp-stream/RtspStreamRecorder.h
+    src/rtsp-stream/RtspStreamRenderScheduler.h
     src/rtsp-stream/RtspStreamThread.h
     src/rtsp-stream/RtspStreamWorker.h
 
@@ -79,6 +84,7 @@ set (bluecherry_client_MOC_SRCS
     src/ui/EventVideoPlayer.h
     src/ui/EventViewWindow.h
     src/ui/ExpandingTextEdit.h
+    src/ui/LiveStreamDiagnosticsWindow.h
     src/ui/MacSplitter.h
     src/ui/MacSplitterHandle.h
     src/ui/MainWindow.h
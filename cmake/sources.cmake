@@ -32,9 +32,13 @@ set (bluecherry_client_main_SRCS
     src/core/EventData.cpp
     src/core/LanguageController.cpp
     src/core/LiveStream.cpp
+    src/core/LiveStreamFrame.cpp
     src/core/LiveViewManager.cpp
     src/core/LoggableUrl.cpp
+    src/core/MJpegMultipartParser.cpp
     src/core/MJpegStream.cpp
+    src/core/MJpegStreamIoThread.cpp
+    src/core/MJpegStreamReader.cpp
     src/core/PtzPresetsModel.cpp
     src/core/ServerRequestManager.cpp
     src/core/ThreadPause.cpp
@@ -57,9 +61,26 @@ set (bluecherry_client_main_SRCS
     src/event/ThumbnailManager.cpp
 
     src/rtsp-stream/RtspStream.cpp
+    src/rtsp-stream/RtspStreamDecodeScheduler.cpp
+    src/rtsp-stream/RtspStreamDecoderThreadBudget.cpp
     src/rtsp-stream/RtspStreamFrame.cpp
+    src/rtsp-stream/RtspStreamFrameConvertTask.cpp
+    src/rtsp-stream/RtspStreamFrameConverter.cpp
+    src/rtsp-stream/RtspStreamFrameConverter_avx2.cpp
+    src/rtsp-stream/RtspStreamFrameConverter_neon.cpp
+    src/rtsp-stream/RtspStreamFrameConverter_sse2.cpp
+    src/rtsp-stream/RtspStreamFrameFanOut.cpp
     src/rtsp-stream/RtspStreamFrameFormatter.cpp
+    src/rtsp-stream/RtspStreamFramePool.cpp
     src/rtsp-stream/RtspStreamFrameQueue.cpp
+    src/rtsp-stream/RtspStreamLatencyMeter.cpp
+    src/rtsp-stream/RtspStreamLossMonitor.cpp
+    src/rtsp-stream/RtspStreamPacketBuffer.cpp
+    src/rtsp-stream/RtspStreamProbeCache.cpp
+    src/rtsp-stream/RtspStreamReconnectScheduler.cpp
+    src/rtsp-stream/RtspStreamRecorder.cpp
+    src/rtsp-stream/RtspStreamRenderScheduler.cpp
+    src/rtsp-stream/RtspStreamStatistics.cpp
     src/rtsp-stream/RtspStreamThread.cpp
     src/rtsp-stream/RtspStreamWorker.cpp
 
@@ -105,6 +126,7 @@ set (bluecherry_client_main_SRCS
     src/ui/EventVideoPlayer.cpp
     src/ui/EventViewWindow.cpp
     src/ui/ExpandingTextEdit.cpp
+    src/ui/LiveStreamDiagnosticsWindow.cpp
     src/ui/MacSplitter.cpp
     src/ui/MacSplitterHandle.cpp
     src/ui/MainWindow.cpp
@@ -130,6 +152,7 @@ set (bluecherry_client_main_SRCS
     src/utils/StringUtils.cpp
     src/utils/ThreadTask.cpp
     src/utils/ThreadTaskCourier.cpp
+    src/utils/ThreadTaskExecutor.cpp
 
     src/video/MediaDownload.cpp
     src/video/VideoHttpBuffer.cpp
@@ -163,6 +186,19 @@ if (WIN32)
     )
 endif (WIN32)
 
+# SIMD kernels are selected at runtime, so only their own files get the instruction set flags
+if (CMAKE_SYSTEM_PROCESSOR MATCHES "^(x86_64|AMD64|amd64|i.86|x86)$")
+    if (MSVC)
+        set_source_files_properties (src/rtsp-stream/RtspStreamFrameConverter_avx2.cpp
+            PROPERTIES COMPILE_FLAGS "/arch:AVX2")
+    else (MSVC)
+        set_source_files_properties (src/rtsp-stream/RtspStreamFrameConverter_sse2.cpp
+            PROPERTIES COMPILE_FLAGS "-msse2")
+        set_source_files_properties (src/rtsp-stream/RtspStreamFrameConverter_avx2.cpp
+            PROPERTIES COMPILE_FLAGS "-mavx2")
+    endif (MSVC)
+endif (CMAKE_SYSTEM_PROCESSOR MATCHES "^(x86_64|AMD64|amd64|i.86|x86)$")
+
 list (APPEND bluecherry_client_SRCS
     ${bluecherry_client_main_SRCS}
 )
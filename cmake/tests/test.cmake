@@ -23,5 +23,20 @@ if (NOT APPLE)
     bluecherry_add_test (DateTimeRangeTestCase tests/src/utils/DateTimeRangeTestCase.cpp)
     bluecherry_add_test (RangeMapTestCase tests/src/utils/RangeMapTestCase.cpp)
     bluecherry_add_test (RangeTestCase tests/src/utils/RangeTestCase.cpp)
+    bluecherry_add_test (ImageDecodeTaskTestCase tests/src/utils/ImageDecodeTaskTestCase.cpp)
+    bluecherry_add_test (ThreadTaskExecutorTestCase tests/src/utils/ThreadTaskExecutorTestCase.cpp)
     bluecherry_add_test (EventParserTestCase tests/src/event/EventParserTestCase.cpp)
+    bluecherry_add_test (MJpegMultipartParserTestCase tests/src/core/MJpegMultipartParserTestCase.cpp)
+    bluecherry_add_test (MJpegStreamReaderTestCase tests/src/core/MJpegStreamReaderTestCase.cpp)
+    bluecherry_add_test (RtspStreamFrameQueueTestCase tests/src/rtsp-stream/RtspStreamFrameQueueTestCase.cpp)
+    bluecherry_add_test (RtspStreamFrameConverterTestCase tests/src/rtsp-stream/RtspStreamFrameConverterTestCase.cpp)
+    bluecherry_add_test (RtspStreamFrameFanOutTestCase tests/src/rtsp-stream/RtspStreamFrameFanOutTestCase.cpp)
+    bluecherry_add_test (RtspStreamDecoderThreadBudgetTestCase tests/src/rtsp-stream/RtspStreamDecoderThreadBudgetTestCase.cpp)
+    bluecherry_add_test (RtspStreamProbeCacheTestCase tests/src/rtsp-stream/RtspStreamProbeCacheTestCase.cpp)
+    bluecherry_add_test (RtspStreamPacketBufferTestCase tests/src/rtsp-stream/RtspStreamPacketBufferTestCase.cpp)
+    bluecherry_add_test (RtspStreamRecorderTestCase tests/src/rtsp-stream/RtspStreamRecorderTestCase.cpp)
+    bluecherry_add_test (RtspStreamLossMonitorTestCase tests/src/rtsp-stream/RtspStreamLossMonitorTestCase.cpp)
+    bluecherry_add_test (RtspStreamLatencyMeterTestCase tests/src/rtsp-stream/RtspStreamLatencyMeterTestCase.cpp)
+    bluecherry_add_test (RtspStreamStatisticsTestCase tests/src/rtsp-stream/RtspStreamStatisticsTestCase.cpp)
+    bluecherry_add_test (RtspStreamReconnectSchedulerTestCase tests/src/rtsp-stream/RtspStreamReconnectSchedulerTestCase.cpp)
 endif (NOT APPLE)
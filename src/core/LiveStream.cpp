@@ -17,7 +17,113 @@
 
 #include "LiveStream.h"
 
+bool LiveStream::m_latencyMeasurementEnabled = false;
+
+/* Hidden streams decode only keyframes after this long, and are paused after hiddenPauseDelay */
+static const int hiddenKeyframesDelay = 3000;
+static const int hiddenPauseDelay = 60000;
+/* A hidden stream that could not be paused, or was resumed by reconnecting, is checked this often */
+static const int hiddenCheckInterval = 10000;
+
 LiveStream::LiveStream(QObject *parent) :
-    QObject(parent)
+    QObject(parent), m_hidden(false), m_hiddenKeyframesOnly(false), m_hiddenPaused(false)
+{
+    m_hiddenTimer.setSingleShot(true);
+    connect(&m_hiddenTimer, SIGNAL(timeout()), SLOT(hiddenTimeout()));
+}
+
+void LiveStream::setConsumerVisible(const QObject *consumer, bool visible)
+{
+    QHash<const QObject *, bool>::iterator it = m_consumerVisibility.find(consumer);
+    if (it != m_consumerVisibility.end() && *it == visible)
+        return;
+
+    m_consumerVisibility.insert(consumer, visible);
+    updateHidden();
+}
+
+void LiveStream::removeConsumerVisibility(const QObject *consumer)
+{
+    if (m_consumerVisibility.remove(consumer))
+        updateHidden();
+}
+
+void LiveStream::updateHidden()
+{
+    bool hidden = !m_consumerVisibility.isEmpty();
+    for (QHash<const QObject *, bool>::const_iterator it = m_consumerVisibility.constBegin();
+         hidden && it != m_consumerVisibility.constEnd(); ++it)
+        hidden = !*it;
+
+    if (hidden == m_hidden)
+        return;
+
+    m_hidden = hidden;
+    if (m_hidden)
+    {
+        m_hiddenTimer.start(hiddenKeyframesDelay);
+        return;
+    }
+
+    m_hiddenTimer.stop();
+
+    if (m_hiddenPaused)
+    {
+        m_hiddenPaused = false;
+        if (isPaused())
+            setPaused(false);
+    }
+
+    if (m_hiddenKeyframesOnly)
+    {
+        m_hiddenKeyframesOnly = false;
+        setHiddenKeyframesOnly(false);
+    }
+}
+
+void LiveStream::hiddenTimeout()
+{
+    if (!m_hidden)
+        return;
+
+    if (!m_hiddenKeyframesOnly)
+    {
+        m_hiddenKeyframesOnly = true;
+        setHiddenKeyframesOnly(true);
+        m_hiddenTimer.start(hiddenPauseDelay - hiddenKeyframesDelay);
+        return;
+    }
+
+    /* A stream the user paused stays paused when it is visible again */
+    if (!isPaused() && canPauseWhileHidden())
+    {
+        setPaused(true);
+        m_hiddenPaused = m_hiddenPaused || isPaused();
+    }
+
+    m_hiddenTimer.start(hiddenCheckInterval);
+}
+
+QVariantMap LiveStream::diagnostics() const
+{
+    static const char * const stateNames[] = {
+        "error", "offline", "notConnected", "connecting", "buffering", "streaming", "paused"
+    };
+
+    QVariantMap result;
+    result.insert(QLatin1String("state"), QLatin1String(stateNames[state()]));
+    result.insert(QLatin1String("receivedFps"), double(receivedFps()));
+    result.insert(QLatin1String("width"), streamSize().width());
+    result.insert(QLatin1String("height"), streamSize().height());
+    result.insert(QLatin1String("bandwidthMode"), bandwidthMode());
+    result.insert(QLatin1String("hwAccel"), hwAccelStatus());
+    result.insert(QLatin1String("hidden"), m_hidden);
+    if (state() == Error)
+        result.insert(QLatin1String("error"), errorMessage());
+    return result;
+}
+
+void LiveStream::setLatencyMeasurementEnabled(bool enabled)
 {
+    m_latencyMeasurementEnabled = enabled;
 }
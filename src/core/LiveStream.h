@@ -18,9 +18,13 @@
 #ifndef LIVESTREAM_H
 #define LIVESTREAM_H
 
+#include <QHash>
 #include <QImage>
 #include <QObject>
 #include <QSize>
+#include <QTimer>
+#include <QVariantMap>
+#include "core/LiveStreamFrame.h"
 
 class LiveStream : public QObject
 {
@@ -37,6 +41,8 @@ class LiveStream : public QObject
     Q_PROPERTY(bool audio READ hasAudio NOTIFY audioChanged)
     Q_PROPERTY(bool audioPlaying READ isAudioEnabled NOTIFY audioChanged)
     Q_PROPERTY(bool hwVA READ hwAccelStatus NOTIFY hwAccelChanged)
+    Q_PROPERTY(bool replaying READ isReplaying NOTIFY replayingChanged)
+    Q_PROPERTY(bool recordingLocally READ isRecordingLocally NOTIFY localRecordingChanged)
 
 public:
     enum State
@@ -58,7 +64,11 @@ public:
     virtual State state() const = 0;
     virtual QString errorMessage() const = 0;
 
-    virtual QImage currentFrame() const = 0;
+    virtual LiveStreamFrame currentFrame() const = 0;
+    /* Frame prepared for one consumer, at the size it reported with setFrameSizeHint() */
+    virtual LiveStreamFrame currentFrame(const QObject *consumer) const { Q_UNUSED(consumer); return currentFrame(); }
+    /* Current frame at full resolution, for saving snapshots */
+    virtual QImage snapshot() const { return currentFrame().toImage(); }
     virtual QSize streamSize() const = 0;
 
     virtual float receivedFps() const = 0;
@@ -68,9 +78,37 @@ public:
 
     virtual bool hasAudio() const = 0;
     virtual bool isAudioEnabled() const  = 0;
-    virtual void setFrameSizeHint(int width, int height) = 0;
-    virtual void ref() = 0;
-    virtual void unref() = 0;
+    virtual void setFrameSizeHint(const QObject *consumer, int width, int height) = 0;
+    virtual void ref(const QObject *consumer) = 0;
+    virtual void unref(const QObject *consumer) = 0;
+
+    /* Consumers report whether they can currently be seen. Once none of them can, the
+     * stream decodes only keyframes after a few seconds and is paused after a minute;
+     * it resumes as soon as one of them is visible again. Streams no consumer has
+     * reported for are treated as visible. */
+    void setConsumerVisible(const QObject *consumer, bool visible);
+    void removeConsumerVisibility(const QObject *consumer);
+    bool isHidden() const { return m_hidden; }
+
+    /* Seconds of recent video that replay() can show again; 0 if unsupported */
+    virtual int replayBufferDuration() const { return 0; }
+    virtual bool isReplaying() const { return false; }
+
+    /* Recording of the received stream to a local file, without transcoding */
+    virtual bool canRecordLocally() const { return false; }
+    virtual bool isRecordingLocally() const { return false; }
+
+    /* Called by views after painting the current frame, with the time painting took
+     * in microseconds; used to measure latency and for diagnostics */
+    virtual void framePainted(qint64 paintTime) { Q_UNUSED(paintTime); }
+
+    /* Counters and timings for the diagnostics window, as names and plain values
+     * that can be written out as JSON. Subclasses add to the base values. */
+    virtual QVariantMap diagnostics() const;
+
+    /* Latency measurement mode, set at startup with --measure-latency */
+    static void setLatencyMeasurementEnabled(bool enabled);
+    static bool isLatencyMeasurementEnabled() { return m_latencyMeasurementEnabled; }
 
 public slots:
     virtual void start() = 0;
@@ -82,12 +120,18 @@ public slots:
     virtual void setBandwidthMode(int bandwidthMode) = 0;
     virtual void enableAudio(bool enable) = 0;
     virtual void enableHWAccel(bool hwAccel) = 0;
+    virtual void replay(int seconds) { Q_UNUSED(seconds); }
+    virtual void startLocalRecording(const QString &fileName) { Q_UNUSED(fileName); }
+    virtual void stopLocalRecording() {}
 
 signals:
     void stateChanged(int newState);
     void pausedChanged(bool paused);
     void bandwidthModeChanged(int mode);
     void hwAccelChanged(bool status);
+    void replayingChanged(bool replaying);
+    void localRecordingChanged(bool recording);
+    void localRecordingFailed(const QString &message);
 
     void streamRunning();
     void streamStopped();
@@ -95,7 +139,26 @@ signals:
     void updated();
     void audioChanged();
 
-    
+protected:
+    /* Called when the stream has been hidden for a while, and when it is visible again */
+    virtual void setHiddenKeyframesOnly(bool keyframesOnly) { Q_UNUSED(keyframesOnly); }
+    /* Whether a hidden stream may be paused now, e.g. not while it is recorded */
+    virtual bool canPauseWhileHidden() const { return true; }
+
+private slots:
+    void hiddenTimeout();
+
+private:
+    static bool m_latencyMeasurementEnabled;
+
+    QHash<const QObject *, bool> m_consumerVisibility;
+    QTimer m_hiddenTimer;
+    bool m_hidden;
+    bool m_hiddenKeyframesOnly;
+    bool m_hiddenPaused;
+
+    void updateHidden();
+
 };
 
 #endif // LIVESTREAM_H
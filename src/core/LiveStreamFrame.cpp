@@ -0,0 +1,41 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LiveStreamFrame.h"
+
+LiveStreamFrame::LiveStreamFrame()
+{
+}
+
+LiveStreamFrame::LiveStreamFrame(const QImage &image)
+    : m_image(image)
+{
+}
+
+LiveStreamFrame::LiveStreamFrame(const QImage &image, const QSharedPointer<LiveStreamFrameBuffer> &buffer)
+    : m_image(image), m_buffer(buffer)
+{
+}
+
+QImage LiveStreamFrame::toImage() const
+{
+    /* Images that do not own their pixels must be detached from the buffer */
+    if (m_buffer)
+        return m_image.copy();
+
+    return m_image;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIVESTREAMFRAME_H
+#define LIVESTREAMFRAME_H
+
+#include <QImage>
+#include <QSharedPointer>
+#include <QSize>
+
+/* Pixel memory owned by a stream implementation. Subclasses free the memory in
+ * their destructor, which runs once the last LiveStreamFrame referencing it is gone. */
+class LiveStreamFrameBuffer
+{
+public:
+    virtual ~LiveStreamFrameBuffer() {}
+};
+
+/* Immutable, reference counted handle to a decoded live frame.
+ *
+ * Copying a handle never copies pixels. The image may point directly into memory
+ * owned by the decoder; it is only valid while a handle to the frame exists, so keep
+ * the handle around while painting and use toImage() to keep pixels beyond that. */
+class LiveStreamFrame
+{
+public:
+    LiveStreamFrame();
+    explicit LiveStreamFrame(const QImage &image);
+    LiveStreamFrame(const QImage &image, const QSharedPointer<LiveStreamFrameBuffer> &buffer);
+
+    bool isNull() const { return m_image.isNull(); }
+    QSize size() const { return m_image.size(); }
+
+    const QImage & image() const { return m_image; }
+    QImage toImage() const;
+
+private:
+    QImage m_image;
+    QSharedPointer<LiveStreamFrameBuffer> m_buffer;
+};
+
+#endif // LIVESTREAMFRAME_H
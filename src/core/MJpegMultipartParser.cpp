@@ -0,0 +1,283 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MJpegMultipartParser.h"
+#include <cstring>
+
+/* A few frames at the usual MJPEG sizes, so a new buffer is rarely needed */
+static const int defaultBufferSize = 512 * 1024;
+
+MJpegMultipartParser::MJpegMultipartParser(int maxSize)
+    : m_maxSize(qMax(1, maxSize)), m_readPos(0), m_scanPos(0), m_writePos(0),
+      m_state(ParserBoundary), m_bodyLength(0), m_copiedBytes(0)
+{
+    for (int i = 0; i < 256; ++i)
+        m_skip[i] = 1;
+}
+
+void MJpegMultipartParser::setBoundary(const QByteArray &boundary)
+{
+    m_boundary = boundary;
+
+    /* Horspool shift: distance from the last occurrence of a byte to the end of the
+     * boundary, ignoring the last byte itself */
+    const int length = m_boundary.size();
+    for (int i = 0; i < 256; ++i)
+        m_skip[i] = qMax(1, length);
+    for (int i = 0; i < length - 1; ++i)
+        m_skip[uchar(m_boundary.at(i))] = length - 1 - i;
+
+    clear();
+}
+
+void MJpegMultipartParser::clear()
+{
+    m_buffer.clear();
+    m_readPos = m_scanPos = m_writePos = 0;
+    m_state = ParserBoundary;
+    m_bodyLength = 0;
+    m_copiedBytes = 0;
+}
+
+void MJpegMultipartParser::startBuffer(int capacity)
+{
+    QSharedPointer<QByteArray> buffer(new QByteArray(capacity, Qt::Uninitialized));
+
+    /* Only the unparsed tail moves; parts handed out keep the old buffer */
+    int pending = m_writePos - m_readPos;
+    if (pending > 0)
+    {
+        memcpy(buffer->data(), m_buffer->constData() + m_readPos, pending);
+        m_copiedBytes += pending;
+    }
+
+    m_buffer = buffer;
+    m_scanPos -= m_readPos;
+    m_writePos = pending;
+    m_readPos = 0;
+}
+
+char * MJpegMultipartParser::writePointer(int *size)
+{
+    if (!m_buffer || m_writePos == m_buffer->size())
+    {
+        int pending = m_writePos - m_readPos;
+        if (pending >= m_maxSize)
+        {
+            if (size)
+                *size = 0;
+            return 0;
+        }
+
+        startBuffer(qMin(m_maxSize, qMax(defaultBufferSize, pending * 2)));
+    }
+
+    if (size)
+        *size = m_buffer->size() - m_writePos;
+    /* The buffer is never shared, so this does not detach */
+    return m_buffer->data() + m_writePos;
+}
+
+void MJpegMultipartParser::written(int size)
+{
+    if (m_buffer)
+        m_writePos += qBound(0, size, m_buffer->size() - m_writePos);
+}
+
+bool MJpegMultipartParser::append(const char *data, int size)
+{
+    while (size > 0)
+    {
+        int available = 0;
+        char *dst = writePointer(&available);
+        if (!dst)
+            return false;
+
+        int n = qMin(size, available);
+        memcpy(dst, data, n);
+        written(n);
+
+        data += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+int MJpegMultipartParser::findBoundary()
+{
+    const int length = m_boundary.size();
+    const char *needle = m_boundary.constData();
+    const char *data = m_buffer->constData();
+
+    int pos = m_scanPos;
+    while (pos + length <= m_writePos)
+    {
+        int i = length - 1;
+        while (data[pos + i] == needle[i])
+        {
+            if (i == 0)
+                return pos;
+            --i;
+        }
+
+        pos += m_skip[uchar(data[pos + length - 1])];
+    }
+
+    /* The shifts only skipped positions that cannot match, whatever data follows */
+    m_scanPos = pos;
+    return -1;
+}
+
+bool MJpegMultipartParser::parseBoundary()
+{
+    const char *data = m_buffer->constData();
+
+    for (;;)
+    {
+        int boundary = findBoundary();
+        if (boundary < 0)
+        {
+            /* Nothing before the search position can be the start of a boundary */
+            m_readPos = m_scanPos;
+            return false;
+        }
+
+        int end = boundary + m_boundary.size();
+        int size = m_writePos - end;
+
+        if (size >= 2 && data[end] == '-' && data[end+1] == '-')
+        {
+            end += 2;
+            size -= 2;
+        }
+
+        if (size && data[end] == '\n')
+        {
+            end++;
+        }
+        else if (size >= 2 && data[end] == '\r' && data[end+1] == '\n')
+        {
+            end += 2;
+        }
+        else if (size < 2)
+        {
+            /* Not enough to finish the boundary; wait at its start */
+            m_readPos = m_scanPos = boundary;
+            return false;
+        }
+        else
+        {
+            /* Invalid characters mean this isn't a boundary; skip it */
+            m_readPos = m_scanPos = boundary + m_boundary.size();
+            continue;
+        }
+
+        /* Reached the end of the boundary; headers follow */
+        m_readPos = m_scanPos = end;
+        m_state = ParserHeaders;
+        m_bodyLength = 0;
+        return true;
+    }
+}
+
+bool MJpegMultipartParser::parseHeaders()
+{
+    const char *data = m_buffer->constData();
+
+    /* m_scanPos is at the start of the first line not read yet */
+    for (int lineStart = m_scanPos;; )
+    {
+        const char *newline = static_cast<const char *>(memchr(data + lineStart, '\n', m_writePos - lineStart));
+        if (!newline)
+        {
+            /* All complete lines are processed */
+            m_readPos = m_scanPos = lineStart;
+            return false;
+        }
+
+        int lineEnd = int(newline - data);
+        if (lineStart == lineEnd || (lineEnd - lineStart == 1 && data[lineStart] == '\r'))
+        {
+            /* Empty line; the body follows */
+            m_readPos = m_scanPos = lineEnd + 1;
+            m_state = ParserBody;
+            return true;
+        }
+
+        /* We only care about Content-Length */
+        if ((lineEnd - lineStart) > 15 && qstrnicmp(data + lineStart, "Content-Length:", 15) == 0)
+        {
+            bool ok = false;
+            m_bodyLength = QByteArray(data + lineStart + 15, lineEnd - lineStart - 15).trimmed().toInt(&ok);
+            if (!ok || m_bodyLength < 0)
+                m_bodyLength = 0;
+        }
+
+        lineStart = lineEnd + 1;
+    }
+}
+
+bool MJpegMultipartParser::takePart(Part *part)
+{
+    if (!m_buffer || m_boundary.isEmpty())
+        return false;
+
+    for (;;)
+    {
+        if (m_state == ParserBoundary && !parseBoundary())
+            return false;
+
+        if (m_state == ParserHeaders && !parseHeaders())
+            return false;
+
+        if (m_bodyLength)
+        {
+            /* The easy route; Content-Length tells us where the body ends */
+            if (m_writePos - m_readPos < m_bodyLength)
+                return false;
+        }
+        else
+        {
+            /* Without Content-Length, the body ends at the next boundary */
+            int boundary = findBoundary();
+            if (boundary < 0)
+                return false;
+
+            m_bodyLength = boundary - m_readPos;
+        }
+
+        int offset = m_readPos;
+        int length = m_bodyLength;
+
+        m_readPos = m_scanPos = offset + length;
+        m_state = ParserBoundary;
+        m_bodyLength = 0;
+
+        if (!length)
+            continue;
+
+        if (part)
+        {
+            part->buffer = m_buffer;
+            part->offset = offset;
+            part->length = length;
+        }
+
+        return true;
+    }
+}
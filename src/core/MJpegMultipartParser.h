@@ -0,0 +1,111 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MJPEG_MULTIPART_PARSER_H
+#define MJPEG_MULTIPART_PARSER_H
+
+#include <QByteArray>
+#include <QMetaType>
+#include <QSharedPointer>
+
+/* Splits a multipart/x-mixed-replace stream into its parts.
+ *
+ * Data is read straight into the parser's buffer (writePointer() and written()).
+ * Parsed data is never moved: positions just advance, and parts are handed out as
+ * slices of the buffer. Reads keep filling the buffer after parts were handed out,
+ * but only past the parsed data, so they never overlap those parts. When the buffer
+ * is full, a new one is started and only the unparsed tail, usually a partial frame,
+ * is copied over. Parts still being decoded keep the old buffer alive; it is never
+ * written again.
+ *
+ * The boundary is found with a Boyer-Moore-Horspool search that continues where the
+ * previous one stopped, so every byte is looked at about once no matter how the
+ * stream is split into reads. */
+class MJpegMultipartParser
+{
+    Q_DISABLE_COPY(MJpegMultipartParser)
+
+public:
+    /* Part body; valid for as long as the Part is kept */
+    struct Part
+    {
+        QSharedPointer<QByteArray> buffer;
+        int offset;
+        int length;
+
+        Part() : offset(0), length(0) {}
+
+        const char * constData() const { return buffer ? buffer->constData() + offset : 0; }
+        /* Shares the buffer instead of copying; keep the Part while the result is used */
+        QByteArray data() const { return QByteArray::fromRawData(constData(), length); }
+    };
+
+    /* maxSize bounds the data buffered for a single part */
+    explicit MJpegMultipartParser(int maxSize = 2 * 1024 * 1024);
+
+    /* Resets the parser; parts are delimited by boundary as given in the Content-Type */
+    void setBoundary(const QByteArray &boundary);
+    QByteArray boundary() const { return m_boundary; }
+    void clear();
+
+    /* Space to read into, at least 1 byte; 0 if maxSize bytes of an unfinished part are
+     * buffered already */
+    char * writePointer(int *size);
+    void written(int size);
+    /* Copies data in; false if it does not fit into maxSize */
+    bool append(const char *data, int size);
+
+    /* Takes the next complete part; false if more data is needed */
+    bool takePart(Part *part);
+
+    /* Bytes copied when starting new buffers, for benchmarks */
+    qint64 copiedBytes() const { return m_copiedBytes; }
+
+private:
+    enum State
+    {
+        ParserBoundary,
+        ParserHeaders,
+        ParserBody
+    };
+
+    const int m_maxSize;
+    QByteArray m_boundary;
+    int m_skip[256];
+
+    QSharedPointer<QByteArray> m_buffer;
+    /* Start of the data not consumed yet, where the next search starts, end of the data */
+    int m_readPos;
+    int m_scanPos;
+    int m_writePos;
+
+    State m_state;
+    int m_bodyLength;
+    qint64 m_copiedBytes;
+
+    /* Position of the boundary, searching on from m_scanPos; -1 if it is not there yet,
+     * and m_scanPos is moved to where the next search can start */
+    int findBoundary();
+    void startBuffer(int capacity);
+    bool parseBoundary();
+    bool parseHeaders();
+
+};
+
+Q_DECLARE_METATYPE(MJpegMultipartParser::Part)
+
+#endif // MJPEG_MULTIPART_PARSER_H
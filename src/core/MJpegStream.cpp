@@ -18,35 +18,33 @@
 #include "BluecherryApp.h"
 #include "MJpegStream.h"
 #include "LiveViewManager.h"
-#include "utils/ImageDecodeTask.h"
+#include "MJpegStreamReader.h"
 #include "audio/AudioPlayer.h"
-#include <QNetworkAccessManager>
-#include <QNetworkRequest>
-#include <QNetworkReply>
+#include <QBuffer>
 #include <QDebug>
 #include <QImage>
-#include <QThreadPool>
+#include <QImageReader>
 #include <QTimer>
-#include <QDateTime>
+
+/* main.cpp */
+extern const char *jpegFormatName;
 
 MJpegStream::MJpegStream(DVRCamera *camera, QObject *parent)
-    : LiveStream(parent), m_camera(camera), m_httpReply(0), m_currentFrameNo(0), m_latestFrameNo(0), m_fpsRecvTs(0), m_fpsRecvNo(0),
-      m_decodeTask(0), m_lastActivity(0), m_receivedFps(0), m_nam(0), m_httpBodyLength(0), m_state(NotConnected),
-      m_parserState(ParserBoundary), m_autoStart(false), m_paused(false), m_interval(1)
+    : LiveStream(parent), m_camera(camera), m_reader(0), m_receivedFps(0), m_state(NotConnected),
+      m_autoStart(false), m_paused(false), m_interval(1)
 {
     Q_ASSERT(m_camera);
     //connect(m_camera.data(), SIGNAL(destroyed(QObject*)), this, SLOT(deleteLater()));
 
     bcApp->liveView->addStream(this);
-    connect(&m_activityTimer, SIGNAL(timeout()), SLOT(checkActivity()));
 }
 
 MJpegStream::~MJpegStream()
 {
     bcApp->liveView->removeStream(this);
 
-    if (m_httpReply)
-        m_httpReply->deleteLater();
+    if (m_reader)
+        m_reader->deleteLater();
 }
 
 void MJpegStream::enableAudio(bool enable)
@@ -124,36 +122,30 @@ void MJpegStream::start()
 
     currentUrl.addEncodedQueryItem("activity", "1");
 
-    m_nam = bcApp->createNam();
+    /* Reading and decoding happen on the network thread */
+    m_reader = new MJpegStreamReader;
+    m_reader->moveToThread(MJpegStreamReader::ioThread());
+    connect(m_reader, SIGNAL(streamStarted()), SLOT(streamStarted()));
+    connect(m_reader, SIGNAL(frameDecoded(QImage,QSize,float,MJpegMultipartParser::Part)),
+            SLOT(frameDecoded(QImage,QSize,float,MJpegMultipartParser::Part)));
+    connect(m_reader, SIGNAL(error(QString)), SLOT(setError(QString)));
 
-    m_httpReply = m_nam->get(QNetworkRequest(currentUrl));
-    m_httpReply->ignoreSslErrors();
-    connect(m_httpReply, SIGNAL(error(QNetworkReply::NetworkError)), SLOT(requestError()));
-    connect(m_httpReply, SIGNAL(finished()), SLOT(requestError()));
-    connect(m_httpReply, SIGNAL(readyRead()), SLOT(readable()));
+    QMetaObject::invokeMethod(m_reader, "setFrameSizeHint", Qt::QueuedConnection, Q_ARG(QSize, m_frameSizeHint));
 
-    m_activityTimer.start(30000);
+    QMetaObject::invokeMethod(m_reader, "start", Qt::QueuedConnection, Q_ARG(QUrl, currentUrl));
 }
 
 void MJpegStream::stop()
 {
-    if (m_httpReply)
-    {
-        m_httpReply->disconnect(this);
-        m_httpReply->abort();
-        m_httpReply->deleteLater();
-        m_httpReply = 0;
-    }
-
-    if (m_nam)
+    if (m_reader)
     {
-        m_nam->deleteLater();
-        m_nam = 0;
+        /* Stops reading once the network thread gets to it; frames still on their way
+         * are not delivered anymore */
+        m_reader->disconnect(this);
+        m_reader->deleteLater();
+        m_reader = 0;
     }
 
-    m_httpBuffer.clear();
-    m_httpBoundary.clear();
-
     if (state() > NotConnected)
     {
         if (state() != Paused)
@@ -162,9 +154,6 @@ void MJpegStream::stop()
         m_autoStart = false;
     }
 
-    m_activityTimer.stop();
-    m_fpsRecvTs = 0;
-    m_fpsRecvNo = 0;
     m_receivedFps = 0;
 }
 
@@ -238,267 +227,84 @@ void MJpegStream::setPaused(bool pause)
     emit pausedChanged(pause);
 }
 
-bool MJpegStream::processHeaders()
+void MJpegStream::streamStarted()
 {
-    Q_ASSERT(m_httpReply);
-
-    QByteArray data = m_httpReply->header(QNetworkRequest::ContentTypeHeader).toByteArray();
-    QByteArray dataL = data.toLower();
-
-    /* Get the MIME type */
-    QByteArray mimeType;
-
-    int sep = dataL.indexOf(';');
-    if (sep > 0)
-        mimeType = dataL.left(sep).trimmed();
-
-    m_httpBoundary.clear();
-    sep = dataL.indexOf("boundary=", sep);
-    if (sep > 0)
-        m_httpBoundary = data.mid(sep+9);
-
-    if (mimeType != "multipart/x-mixed-replace" || m_httpBoundary.isEmpty())
-    {
-        setError(QLatin1String("Invalid content type"));
-        return false;
-    }
-
-//    if (m_httpBoundary.startsWith("--"))
-//    {
-//        /* Hack to work around broken MJPEG feeds, particularly some Axis devices,
-//         * which incorrectly include '--' in their boundary header (which would mean
-//         * that the actual boundary is ----xxx). We'll silently discard any extra data
-//         * before a boundary, so we can remove the extra --'s and it will work fine whether
-//         * they're properly included or not. */
-//        m_httpBoundary.remove(0, 2);
-//    }
-
-//    m_httpBoundary.prepend("\n--");
-    return true;
+    if (m_reader)
+        setState(Buffering);
 }
 
-void MJpegStream::readable()
+void MJpegStream::frameDecoded(const QImage &frame, const QSize &streamSize, float receivedFps,
+                               const MJpegMultipartParser::Part &jpeg)
 {
-    if (!m_httpReply)
+    if (!m_reader)
         return;
 
-    m_lastActivity = QDateTime::currentDateTime().toTime_t();
+    bool sizeChanged = streamSize != m_streamSize;
+    m_currentFrame = frame;
+    m_currentJpeg = jpeg;
+    m_streamSize = streamSize;
+    m_receivedFps = receivedFps;
 
-    if (m_httpBoundary.isNull())
-    {
-        if (!processHeaders())
-            return;
-        Q_ASSERT(!m_httpBoundary.isNull());
-
-        m_parserState = ParserBoundary;
-        setState(Buffering);
-    }
-
-    /* Don't allow the buffer to exceed 2MB */
-    static const int maxBuffer = 2*1024*1024;
-
-    for (;;)
-    {
-        qint64 avail = m_httpReply->bytesAvailable();
-        if (avail < 1)
-            break;
-
-        if (m_httpBuffer.size() >= maxBuffer)
-        {
-            setError(QLatin1String("Exceeded maximum buffer size"));
-            return;
-        }
-
-        int maxRead = qMin((int)avail, maxBuffer - m_httpBuffer.size());
-        int readPos = m_httpBuffer.size();
-        m_httpBuffer.resize(m_httpBuffer.size()+maxRead);
-
-        int rd = m_httpReply->read(m_httpBuffer.data()+readPos, maxRead);
-        if (rd < 0)
-        {
-            setError(QLatin1String("Read error"));
-            return;
-        }
-
-        if (rd < maxRead)
-            m_httpBuffer.truncate(readPos+rd);
+    if (sizeChanged)
+        emit streamSizeChanged(m_streamSize);
+    emit updated();
 
-        if (!parseBuffer() || !m_httpReply)
-            return;
-    }
+    if (m_state == Buffering)
+        setState(Streaming);
 }
 
-bool MJpegStream::parseBuffer()
+QImage MJpegStream::snapshot() const
 {
-    if (m_parserState == ParserBoundary)
-    {
-        /* Search for the boundary */
-        int boundary = m_httpBuffer.indexOf(m_httpBoundary);
-        if (boundary < 0)
-        {
-            /* Everything up to the last m_httpBoundary-2 bytes may be safely discarded */
-            m_httpBuffer.remove(0, m_httpBuffer.size() - (m_httpBoundary.size()-2));
-            return true;
-        }
-
-        int boundaryStart = boundary;
-        if (boundaryStart && m_httpBuffer[boundaryStart-1] == '\r')
-            --boundaryStart;
-
-        boundary += m_httpBoundary.size();
-        int sz = m_httpBuffer.size() - boundary;
-
-        if (sz >= 2 && m_httpBuffer[boundary] == '-' && m_httpBuffer[boundary+1] == '-')
-        {
-            boundary += 2;
-            sz -= 2;
-        }
-
-        if (sz && m_httpBuffer[boundary] == '\n')
-        {
-            boundary++;
-        }
-        else if (sz >= 2 && m_httpBuffer[boundary] == '\r' && m_httpBuffer[boundary+1] == '\n')
-        {
-            boundary += 2;
-        }
-        else if (sz < 2)
-        {
-            /* Not enough to finish the boundary; remove everything up to the start and wait */
-            m_httpBuffer.remove(0, boundaryStart);
-            return true;
-        }
-        else
-        {
-            /* Invalid characters mean this isn't a boundary. Remove it. */
-            m_httpBuffer.remove(0, boundaryStart + m_httpBoundary.size());
-            return true;
-        }
-
-        /* Reached the end of the boundary; headers follow */
-        m_httpBuffer.remove(0, boundary);
-        m_parserState = ParserHeaders;
-        m_httpBodyLength = 0;
-    }
-
-    if (m_parserState == ParserHeaders)
+    /* Frames are only decoded at the size of the tiles showing them */
+    if (m_currentFrame.size() == m_streamSize || !m_currentJpeg.length)
+        return m_currentFrame;
+
+    QByteArray data = m_currentJpeg.data();
+    QBuffer buffer(&data);
+    if (!buffer.open(QIODevice::ReadOnly))
+        return m_currentFrame;
+
+    QImageReader reader(&buffer, jpegFormatName);
+    QImage image = reader.read();
+    if (image.isNull())
     {
-        int lnStart = 0, lnEnd = 0;
-        for (; (lnEnd = m_httpBuffer.indexOf('\n', lnStart)) >= 0; lnStart = lnEnd+1)
-        {
-            if (lnStart == lnEnd || ((lnEnd-lnStart) == 1 && m_httpBuffer[lnStart] == '\r'))
-            {
-                m_parserState = ParserBody;
-                /* Skip the final \n */
-                lnStart = lnEnd+1;
-
-                break;
-            }
-
-            /* We only care about Content-Length */
-            if ((lnEnd - lnStart) > 15 && qstrnicmp(m_httpBuffer.data()+lnStart, "Content-Length:", 15) == 0)
-            {
-                bool ok = false;
-                m_httpBodyLength = m_httpBuffer.mid(lnStart+15, lnEnd-lnStart-15).trimmed().toUInt(&ok);
-                if (!ok)
-                    m_httpBodyLength = 0;
-            }
-        }
-
-        /* All processed headers can be removed */
-        m_httpBuffer.remove(0, lnStart);
+        qDebug() << "mjpeg: snapshot decoding error:" << reader.errorString();
+        return m_currentFrame;
     }
 
-    if (m_parserState == ParserBody)
-    {
-        if (m_httpBodyLength)
-        {
-            /* The easy route; Content-Length tells us where the body ends */
-            if (m_httpBuffer.size() < m_httpBodyLength)
-            {
-                /* Not enough data yet. */
-                return true;
-            }
-        }
-        else
-        {
-            /* Scan for the boundary */
-            int boundary = m_httpBuffer.indexOf(m_httpBoundary);
-            if (boundary < 0)
-                return true;
-
-            m_httpBodyLength = boundary;
-        }
-
-        /* End of the body; m_httpBodyLength is its length, at the beginning of m_httpBuffer */
-        /* Create a QByteArray for just the body, without copying */
-        decodeFrame(QByteArray(m_httpBuffer.data(), m_httpBodyLength));
-
-        m_httpBuffer.remove(0, m_httpBodyLength);
-        m_parserState = ParserBoundary;
-
-        /* Parse again; recursion isn't a problem because this should be a very rare case */
-        if (!m_httpBuffer.isEmpty())
-            parseBuffer();
-    }
-
-    return true;
+    return image;
 }
 
-void MJpegStream::checkActivity()
+void MJpegStream::setFrameSizeHint(const QObject *consumer, int width, int height)
 {
-    if (QDateTime::currentDateTime().toTime_t() - m_lastActivity > 30)
-        setError(QLatin1String("Stream timeout"));
+    m_frameSizeHints.insert(consumer, QSize(width, height));
+    updateFrameSizeHint();
 }
 
-void MJpegStream::requestError()
+void MJpegStream::unref(const QObject *consumer)
 {
-    if (m_httpReply->error() == QNetworkReply::NoError)
-        setError(QLatin1String("Connection lost"));
-    else
-        setError(QString::fromLatin1("HTTP error: %1").arg(m_httpReply->errorString()));
+    m_frameSizeHints.remove(consumer);
+    updateFrameSizeHint();
 }
 
-void MJpegStream::decodeFrame(const QByteArray &data)
+void MJpegStream::updateFrameSizeHint()
 {
-    /* This will cancel the task if it hasn't started yet; in-progress or completed tasks will still
-     * deliver a result */
-    if (m_decodeTask)
-        m_decodeTask->cancel();
-
-    m_decodeTask = new ImageDecodeTask(this, "decodeFrameResult", ++m_latestFrameNo);
-    m_decodeTask->setData(data);
-
-    QThreadPool::globalInstance()->start(m_decodeTask);
-
-    quint64 now = QDateTime::currentMSecsSinceEpoch();
-    if (now - m_fpsRecvTs >= 1500)
+    /* Decoded for the largest view; full size if any view did not tell its size */
+    QSize hint;
+    foreach (const QSize &size, m_frameSizeHints)
     {
-        if (m_fpsRecvTs)
-            m_receivedFps = float((m_latestFrameNo - m_fpsRecvNo) * 1000 / double(now - m_fpsRecvTs));
-
-        m_fpsRecvTs = now;
-        m_fpsRecvNo = m_latestFrameNo;
+        if (size.isEmpty())
+        {
+            hint = QSize();
+            break;
+        }
+        hint = hint.expandedTo(size);
     }
-}
 
-void MJpegStream::decodeFrameResult(ThreadTask *task)
-{
-    ImageDecodeTask *decodeTask = static_cast<ImageDecodeTask*>(task);
-    if (m_decodeTask == decodeTask)
-        m_decodeTask = 0;
-
-    if (decodeTask->result().isNull() || decodeTask->imageId <= m_currentFrameNo)
+    if (hint == m_frameSizeHint)
         return;
 
-    bool sizeChanged = decodeTask->result().size() != m_currentFrame.size();
-    m_currentFrame = decodeTask->result();
-    m_currentFrameNo = decodeTask->imageId;
-
-    if (sizeChanged)
-        emit streamSizeChanged(m_currentFrame.size());
-    emit updated();
-
-    if (m_state == Buffering)
-        setState(Streaming);
+    m_frameSizeHint = hint;
+    if (m_reader)
+        QMetaObject::invokeMethod(m_reader, "setFrameSizeHint", Qt::QueuedConnection, Q_ARG(QSize, m_frameSizeHint));
 }
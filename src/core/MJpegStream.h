@@ -18,18 +18,17 @@
 #ifndef MJPEGSTREAM_H
 #define MJPEGSTREAM_H
 
+#include <QHash>
 #include <QObject>
+#include <QPointer>
 #include <QUrl>
 #include <QPixmap>
-#include <QTimer>
 #include "camera/DVRCamera.h"
 #include "core/LiveViewManager.h"
 #include "core/LiveStream.h"
+#include "core/MJpegMultipartParser.h"
 
-class QNetworkAccessManager;
-class QNetworkReply;
-class ThreadTask;
-class ImageDecodeTask;
+class MJpegStreamReader;
 
 class MJpegStream : public LiveStream
 {
@@ -48,8 +47,12 @@ public:
     State state() const { return m_state; }
     QString errorMessage() const { return m_errorMessage; }
 
-    QImage currentFrame() const { return m_currentFrame; }
-    QSize streamSize() const { return m_currentFrame.size(); }
+    using LiveStream::currentFrame;
+    LiveStreamFrame currentFrame() const { return LiveStreamFrame(m_currentFrame); }
+    /* Decodes the current frame again at full size */
+    QImage snapshot() const;
+    /* Frames may be decoded at a fraction of this size, see setFrameSizeHint() */
+    QSize streamSize() const { return m_streamSize; }
 
     float receivedFps() const { return m_receivedFps; }
 
@@ -58,9 +61,9 @@ public:
 
     bool hasAudio() const { return false; }
     bool isAudioEnabled() const { return false; }
-    void setFrameSizeHint(int width, int height) { return; }
-    void ref() {}
-    void unref() {}
+    void setFrameSizeHint(const QObject *consumer, int width, int height);
+    void ref(const QObject *consumer) { Q_UNUSED(consumer); }
+    void unref(const QObject *consumer);
 
 public slots:
     void start();
@@ -71,48 +74,35 @@ public slots:
     void setOnline(bool online);
     void setBandwidthMode(int bandwidthMode);
     void enableAudio(bool);
-    void enableHWAccel(bool hwAccel) {}
+    void enableHWAccel(bool hwAccel) { Q_UNUSED(hwAccel); }
 
 private slots:
-    void readable();
-    void requestError();
-    void checkActivity();
+    void setError(const QString &message);
+    void streamStarted();
+    void frameDecoded(const QImage &frame, const QSize &streamSize, float receivedFps,
+                      const MJpegMultipartParser::Part &jpeg);
 
 private:
     QWeakPointer<DVRCamera> m_camera;
 
     QString m_errorMessage;
-    QNetworkReply *m_httpReply;
-    QByteArray m_httpBoundary;
-    QByteArray m_httpBuffer;
+    /* Deleted with the io thread if the application quits first */
+    QPointer<MJpegStreamReader> m_reader;
     QImage m_currentFrame;
-    quint64 m_currentFrameNo, m_latestFrameNo;
-    quint64 m_fpsRecvTs, m_fpsRecvNo;
-    ImageDecodeTask *m_decodeTask;
-    QTimer m_activityTimer;
-    uint m_lastActivity;
+    /* Data of m_currentFrame; keeps a parser buffer of the reader alive */
+    MJpegMultipartParser::Part m_currentJpeg;
+    QSize m_streamSize;
     float m_receivedFps;
+    QHash<const QObject *, QSize> m_frameSizeHints;
+    QSize m_frameSizeHint;
 
-    QNetworkAccessManager *m_nam;
-
-    int m_httpBodyLength;
     State m_state;
-    enum {
-        ParserBoundary,
-        ParserHeaders,
-        ParserBody
-    } m_parserState;
     bool m_autoStart, m_paused;
     qint8 m_interval;
     LiveViewManager::BandwidthMode m_bandwidthMode;
 
     void setState(State newState);
-    void setError(const QString &message);
-
-    bool processHeaders();
-    bool parseBuffer();
-    void decodeFrame(const QByteArray &data);
-    Q_INVOKABLE void decodeFrameResult(ThreadTask *task);
+    void updateFrameSizeHint();
 };
 
 #endif // MJPEGSTREAM_H
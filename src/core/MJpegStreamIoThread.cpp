@@ -0,0 +1,47 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MJpegStreamIoThread.h"
+#include "MJpegStreamReader.h"
+#include <QCoreApplication>
+
+MJpegStreamIoThread::MJpegStreamIoThread(QObject *parent)
+    : QThread(parent)
+{
+    if (QCoreApplication::instance())
+        connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), SLOT(shutdown()));
+}
+
+MJpegStreamIoThread::~MJpegStreamIoThread()
+{
+    shutdown();
+}
+
+void MJpegStreamIoThread::shutdown()
+{
+    if (!isRunning())
+        return;
+
+    quit();
+    wait();
+}
+
+void MJpegStreamIoThread::run()
+{
+    exec();
+    MJpegStreamReader::deleteReaders();
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MJPEG_STREAM_IO_THREAD_H
+#define MJPEG_STREAM_IO_THREAD_H
+
+#include <QThread>
+
+/* The network thread of all MJpegStreamReaders, see MJpegStreamReader::ioThread().
+ *
+ * Owned by the application and shut down when it is about to quit. Readers still
+ * living on the thread then are deleted there before it finishes, as deleteLater()
+ * has no effect on them anymore. */
+class MJpegStreamIoThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit MJpegStreamIoThread(QObject *parent = 0);
+    virtual ~MJpegStreamIoThread();
+
+public slots:
+    /* Ends the event loop and waits for the thread to finish */
+    void shutdown();
+
+protected:
+    virtual void run();
+
+};
+
+#endif // MJPEG_STREAM_IO_THREAD_H
@@ -0,0 +1,296 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MJpegStreamReader.h"
+#include "MJpegStreamIoThread.h"
+#include "utils/ImageDecodeTask.h"
+#include "utils/ThreadTaskExecutor.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QThread>
+
+/* Enough for the frame on display, one on its way to it and one to decode into */
+static const int recentFramesCount = 3;
+
+QThreadStorage<QNetworkAccessManager*> MJpegStreamReader::threadNAM;
+QSet<MJpegStreamReader*> MJpegStreamReader::readers;
+QMutex MJpegStreamReader::readersLock;
+
+MJpegStreamReader::MJpegStreamReader(QObject *parent)
+    : QObject(parent), m_reply(0), m_decodeTask(0), m_currentFrameNo(0), m_latestFrameNo(0),
+      m_fpsRecvTs(0), m_fpsRecvNo(0), m_receivedFps(0), m_activityTimer(this), m_lastActivity(0)
+{
+    qRegisterMetaType<MJpegMultipartParser::Part>("MJpegMultipartParser::Part");
+    connect(&m_activityTimer, SIGNAL(timeout()), SLOT(checkActivity()));
+
+    QMutexLocker locker(&readersLock);
+    readers.insert(this);
+}
+
+MJpegStreamReader::~MJpegStreamReader()
+{
+    stop();
+
+    QMutexLocker locker(&readersLock);
+    readers.remove(this);
+}
+
+QThread * MJpegStreamReader::ioThread()
+{
+    static MJpegStreamIoThread *thread = 0;
+    if (!thread)
+    {
+        thread = new MJpegStreamIoThread(QCoreApplication::instance());
+        thread->start();
+    }
+
+    return thread;
+}
+
+void MJpegStreamReader::deleteReaders()
+{
+    QMutexLocker locker(&readersLock);
+    QList<MJpegStreamReader*> left;
+    foreach (MJpegStreamReader *reader, readers)
+    {
+        if (reader->thread() == QThread::currentThread())
+            left.append(reader);
+    }
+    locker.unlock();
+
+    qDeleteAll(left);
+}
+
+void MJpegStreamReader::start(const QUrl &url)
+{
+    Q_ASSERT(QThread::currentThread() == thread());
+
+    stop();
+
+    if (!threadNAM.hasLocalData())
+        threadNAM.setLocalData(new QNetworkAccessManager);
+
+    m_reply = threadNAM.localData()->get(QNetworkRequest(url));
+    m_reply->ignoreSslErrors();
+    connect(m_reply, SIGNAL(error(QNetworkReply::NetworkError)), SLOT(requestError()));
+    connect(m_reply, SIGNAL(finished()), SLOT(requestError()));
+    connect(m_reply, SIGNAL(readyRead()), SLOT(readable()));
+
+    m_lastActivity = QDateTime::currentDateTime().toTime_t();
+    m_activityTimer.start(30000);
+}
+
+void MJpegStreamReader::stop()
+{
+    if (m_reply)
+    {
+        m_reply->disconnect(this);
+        m_reply->abort();
+        m_reply->deleteLater();
+        m_reply = 0;
+    }
+
+    /* Cancels the task if it hasn't started yet */
+    if (m_decodeTask)
+    {
+        m_decodeTask->cancel();
+        m_decodeTask = 0;
+    }
+    m_decodingParts.clear();
+
+    m_parser.setBoundary(QByteArray());
+    m_activityTimer.stop();
+    m_fpsRecvTs = 0;
+    m_fpsRecvNo = 0;
+    m_receivedFps = 0;
+}
+
+void MJpegStreamReader::setFrameSizeHint(const QSize &size)
+{
+    m_frameSizeHint = size;
+}
+
+void MJpegStreamReader::sendError(const QString &message)
+{
+    stop();
+    emit error(message);
+}
+
+bool MJpegStreamReader::processHeaders()
+{
+    Q_ASSERT(m_reply);
+
+    QByteArray data = m_reply->header(QNetworkRequest::ContentTypeHeader).toByteArray();
+    QByteArray dataL = data.toLower();
+
+    /* Get the MIME type */
+    QByteArray mimeType;
+
+    int sep = dataL.indexOf(';');
+    if (sep > 0)
+        mimeType = dataL.left(sep).trimmed();
+
+    QByteArray boundary;
+    sep = dataL.indexOf("boundary=", sep);
+    if (sep > 0)
+        boundary = data.mid(sep+9);
+
+    if (mimeType != "multipart/x-mixed-replace" || boundary.isEmpty())
+    {
+        sendError(QLatin1String("Invalid content type"));
+        return false;
+    }
+
+    m_parser.setBoundary(boundary);
+    return true;
+}
+
+void MJpegStreamReader::readable()
+{
+    if (!m_reply)
+        return;
+
+    m_lastActivity = QDateTime::currentDateTime().toTime_t();
+
+    if (m_parser.boundary().isNull())
+    {
+        if (!processHeaders())
+            return;
+        Q_ASSERT(!m_parser.boundary().isNull());
+
+        emit streamStarted();
+    }
+
+    for (;;)
+    {
+        qint64 avail = m_reply->bytesAvailable();
+        if (avail < 1)
+            break;
+
+        /* Read straight into the parser; it holds at most 2MB of a single frame */
+        int size = 0;
+        char *buffer = m_parser.writePointer(&size);
+        if (!buffer)
+        {
+            sendError(QLatin1String("Exceeded maximum buffer size"));
+            return;
+        }
+
+        int rd = m_reply->read(buffer, qMin(avail, qint64(size)));
+        if (rd < 0)
+        {
+            sendError(QLatin1String("Read error"));
+            return;
+        }
+
+        m_parser.written(rd);
+
+        MJpegMultipartParser::Part part;
+        while (m_parser.takePart(&part))
+            decodeFrame(part);
+    }
+}
+
+void MJpegStreamReader::checkActivity()
+{
+    if (QDateTime::currentDateTime().toTime_t() - m_lastActivity > 30)
+        sendError(QLatin1String("Stream timeout"));
+}
+
+void MJpegStreamReader::requestError()
+{
+    if (!m_reply)
+        return;
+
+    if (m_reply->error() == QNetworkReply::NoError)
+        sendError(QLatin1String("Connection lost"));
+    else
+        sendError(QString::fromLatin1("HTTP error: %1").arg(m_reply->errorString()));
+}
+
+void MJpegStreamReader::decodeFrame(const MJpegMultipartParser::Part &part)
+{
+    /* A frame still waiting for the previous one to be decoded is replaced by this one;
+     * it is delivered cancelled, without a result */
+    m_decodeTask = new ImageDecodeTask(this, "decodeFrameResult", ++m_latestFrameNo);
+    /* The task keeps the parser buffer alive instead of copying the frame */
+    m_decodeTask->setData(part.data(), part.buffer);
+    m_decodeTask->setScaleHint(m_frameSizeHint);
+    m_decodeTask->setOutputImage(takeSpareFrame());
+    m_decodingParts.append(qMakePair(m_latestFrameNo, part));
+
+    ThreadTaskExecutor::instance()->start(m_decodeTask, ThreadTaskExecutor::FrameDecodePool,
+                                          ThreadTaskExecutor::NormalPriority, ThreadTaskExecutor::LatestOnly);
+
+    quint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (now - m_fpsRecvTs >= 1500)
+    {
+        if (m_fpsRecvTs)
+            m_receivedFps = float((m_latestFrameNo - m_fpsRecvNo) * 1000 / double(now - m_fpsRecvTs));
+
+        m_fpsRecvTs = now;
+        m_fpsRecvNo = m_latestFrameNo;
+    }
+}
+
+QImage MJpegStreamReader::takeSpareFrame()
+{
+    for (int i = 0; i < m_recentFrames.size(); ++i)
+    {
+        /* Only our reference is left, so decoding into it does not detach */
+        if (m_recentFrames.at(i).isDetached())
+            return m_recentFrames.takeAt(i);
+    }
+
+    return QImage();
+}
+
+void MJpegStreamReader::decodeFrameResult(ThreadTask *task)
+{
+    ImageDecodeTask *decodeTask = static_cast<ImageDecodeTask*>(task);
+    if (m_decodeTask == decodeTask)
+        m_decodeTask = 0;
+
+    /* A task replaced while waiting is delivered before older frames are decoded, so
+     * only a decoded frame makes the data of older frames obsolete */
+    bool decoded = !decodeTask->result().isNull();
+    MJpegMultipartParser::Part part;
+    for (int i = 0; i < m_decodingParts.size(); )
+    {
+        quint64 frameNo = m_decodingParts.at(i).first;
+        if (frameNo == decodeTask->imageId)
+            part = m_decodingParts.takeAt(i).second;
+        else if (decoded && frameNo < decodeTask->imageId)
+            m_decodingParts.removeAt(i);
+        else
+            ++i;
+    }
+
+    if (!decoded || decodeTask->imageId <= m_currentFrameNo)
+        return;
+
+    m_currentFrameNo = decodeTask->imageId;
+    emit frameDecoded(decodeTask->result(), decodeTask->imageSize(), m_receivedFps, part);
+
+    m_recentFrames.append(decodeTask->result());
+    while (m_recentFrames.size() > recentFramesCount)
+        m_recentFrames.removeFirst();
+}
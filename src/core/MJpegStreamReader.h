@@ -0,0 +1,107 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MJPEG_STREAM_READER_H
+#define MJPEG_STREAM_READER_H
+
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QThreadStorage>
+#include <QTimer>
+#include <QUrl>
+#include "core/MJpegMultipartParser.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QThread;
+class ThreadTask;
+class ImageDecodeTask;
+
+/* Reads and decodes one MJPEG stream on the network thread.
+ *
+ * All readers share a single thread, ioThread(), and the QNetworkAccessManager of that
+ * thread. The multipart stream is parsed there and frames are decoded in the thread
+ * pool; only decoded frames are passed on to the stream on the GUI thread. Create the
+ * reader on the GUI thread, move it to ioThread() and call start() and stop() with
+ * queued invocations; deleteLater() stops it too. Readers left when the application
+ * quits are deleted with the thread, so keep them in a QPointer. */
+class MJpegStreamReader : public QObject
+{
+    Q_OBJECT
+
+    friend class MJpegStreamReaderTestCase;
+
+public:
+    explicit MJpegStreamReader(QObject *parent = 0);
+    virtual ~MJpegStreamReader();
+
+    static QThread * ioThread();
+    /* On the io thread once its event loop has ended */
+    static void deleteReaders();
+
+public slots:
+    void start(const QUrl &url);
+    void stop();
+    /* Frames are decoded at a fraction of their size if they still cover size;
+     * an invalid size decodes at full size */
+    void setFrameSizeHint(const QSize &size);
+
+signals:
+    /* The response is a multipart stream; frames will follow */
+    void streamStarted();
+    /* streamSize is the full size of the stream, which frame may be a fraction of;
+     * jpeg is the frame as received, to decode it at full size */
+    void frameDecoded(const QImage &frame, const QSize &streamSize, float receivedFps,
+                      const MJpegMultipartParser::Part &jpeg);
+    void error(const QString &message);
+
+private slots:
+    void readable();
+    void requestError();
+    void checkActivity();
+
+private:
+    static QThreadStorage<QNetworkAccessManager*> threadNAM;
+    static QSet<MJpegStreamReader*> readers;
+    static QMutex readersLock;
+
+    QNetworkReply *m_reply;
+    MJpegMultipartParser m_parser;
+    ImageDecodeTask *m_decodeTask;
+    quint64 m_currentFrameNo, m_latestFrameNo;
+    quint64 m_fpsRecvTs, m_fpsRecvNo;
+    float m_receivedFps;
+    QTimer m_activityTimer;
+    uint m_lastActivity;
+    QSize m_frameSizeHint;
+    /* Frames passed on recently; decoded into again once nobody else holds them */
+    QList<QImage> m_recentFrames;
+    /* Frames being decoded, by frame number, to pass on along with the result */
+    QList<QPair<quint64, MJpegMultipartParser::Part> > m_decodingParts;
+
+    bool processHeaders();
+    void sendError(const QString &message);
+    void decodeFrame(const MJpegMultipartParser::Part &part);
+    QImage takeSpareFrame();
+    Q_INVOKABLE void decodeFrameResult(ThreadTask *task);
+};
+
+#endif // MJPEG_STREAM_READER_H
@@ -21,6 +21,7 @@
 #include "rtsp-stream/RtspStream.h"
 #include "ui/MainWindow.h"
 #include "ui/CrashReportDialog.h"
+#include "utils/ThreadTaskExecutor.h"
 #include <QApplication>
 #include <QDateTime>
 #include <QGLFormat>
@@ -108,6 +109,8 @@ int main(int argc, char *argv[])
 //                              QMessageBox::Ok);
 //    }
 
+    ThreadTaskExecutor::init();
+
     bcApp = new BluecherryApp;
 	bcApp->setLanguageController(languageController);
 
@@ -117,6 +120,10 @@ int main(int argc, char *argv[])
         qDebug("Using qjpeg-turbo");
     }
 
+    /* Logs how far behind each live stream is; see RtspStreamLatencyMeter */
+    if (a.arguments().contains(QLatin1String("--measure-latency")))
+        LiveStream::setLatencyMeasurementEnabled(true);
+
     RtspStream::init();
 
     MainWindow w(bcApp->serverRepository());
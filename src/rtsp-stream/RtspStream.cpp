@@ -17,18 +17,27 @@
 
 #include "RtspStream.h"
 #include "RtspStreamFrame.h"
+#include "RtspStreamFrameConvertTask.h"
+#include "RtspStreamPacketBuffer.h"
+#include "RtspStreamReconnectScheduler.h"
+#include "RtspStreamRenderScheduler.h"
 #include "RtspStreamThread.h"
 #include "RtspStreamWorker.h"
 #include "core/BluecherryApp.h"
 #include "core/LiveViewManager.h"
 #include "core/LoggableUrl.h"
 #include "audio/AudioPlayer.h"
+#include "server/DVRServer.h"
+#include "server/DVRServerRtspTransport.h"
+#include "utils/ThreadTaskExecutor.h"
 #include <QMutex>
 #include <QMetaObject>
 #include <QTimer>
 #include <QDebug>
 #include <QSettings>
 #include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
 
 extern "C" {
 #   include "libavcodec/avcodec.h"
@@ -56,26 +65,13 @@ static int bc_av_lockmgr(void **mutex, enum AVLockOp op)
     return 1;
 }
 
-class AutoTimer : public QTimer
-{
-protected:
-    virtual void connectNotify(const char *signal)
-    {
-        if (!strcmp(signal, SIGNAL(timeout())))
-            start();
-    }
-
-    virtual void disconnectNotify(const char *signal)
-    {
-        Q_UNUSED(signal);
-        if (!receivers(SIGNAL(timeout())))
-            stop();
-    }
-};
-
-QTimer *RtspStream::m_renderTimer = 0;
-static const int renderTimerFps = 30;
-QTimer *RtspStream::m_stateTimer = 0;
+/* Frame rate is averaged over windows of this length */
+static const int fpsWindowMs = 1500;
+/* Latency measurement mode logs every stream this often */
+static const int latencyReportInterval = 10000;
+/* Tiles smaller than this only get keyframes decoded */
+static const int smallFrameWidth = 160;
+static const int smallFrameHeight = 120;
 
 void RtspStream::init()
 {
@@ -84,32 +80,41 @@ void RtspStream::init()
     //av_log_set_level(AV_LOG_FATAL);
     avformat_network_init();
 
-    m_renderTimer = new AutoTimer;
-    m_renderTimer->setInterval(1000 / renderTimerFps);
-    m_renderTimer->setSingleShot(false);
-
-    m_stateTimer = new AutoTimer;
-    m_stateTimer->setInterval(5000);
-    m_stateTimer->setSingleShot(false);
+    qRegisterMetaType<RtspStreamConnectTimings>("RtspStreamConnectTimings");
+    qRegisterMetaType<enum AVSampleFormat>("AVSampleFormat");
 }
 
 RtspStream::RtspStream(DVRCamera *camera, QObject *parent)
-    : LiveStream(parent), m_camera(camera), m_thread(0), m_currentFrameMutex(QMutex::Recursive),
-      m_frame(0), m_state(NotConnected),
-      m_autoStart(false), m_bandwidthMode(LiveViewManager::FullBandwidth), m_fpsUpdateCnt(0), m_fpsUpdateHits(0),
+    : LiveStream(parent), m_camera(camera), m_thread(0), m_pendingThread(0), m_currentFrameMutex(QMutex::Recursive),
+      m_state(NotConnected),
+      m_autoStart(false), m_bandwidthMode(LiveViewManager::FullBandwidth), m_fpsUpdateHits(0),
       m_fps(0), m_hasAudio(false), m_isAudioEnabled(false), m_isHWAccelEnabled(false),
-      m_refcount(0)
+      m_keyframesOnly(false), m_isSmallFrame(false), m_isHiddenKeyframesOnly(false),
+      m_replayBufferDuration(0), m_isReplaying(false),
+      m_localRecordingSegment(0), m_udpTransportFailed(false), m_lowLatency(false),
+      m_displayedPts(0), m_pendingThreadFailures(0), m_pendingHasAudio(false),
+      m_pendingAudioChannels(0), m_pendingAudioSampleRate(0)
 {
     Q_ASSERT(m_camera);
     //connect(m_camera.data(), SIGNAL(destroyed(QObject*)), this, SLOT(deleteLater()));
 
     bcApp->liveView->addStream(this);
     connect(bcApp, SIGNAL(settingsChanged()), SLOT(updateSettings()));
-    connect(m_stateTimer, SIGNAL(timeout()), SLOT(checkState()));
+
+    DVRServer *server = m_camera.data()->data().server();
+    if (server)
+        connect(&server->configuration(), SIGNAL(rtspTransportChanged(int)), SLOT(rtspTransportChanged()));
+
+    if (LiveStream::isLatencyMeasurementEnabled())
+    {
+        connect(&m_latencyReportTimer, SIGNAL(timeout()), SLOT(logLatencyReport()));
+        m_latencyReportTimer.start(latencyReportInterval);
+    }
 }
 
 RtspStream::~RtspStream()
 {
+    m_localRecordingFile.clear();
     stop();
     bcApp->liveView->removeStream(this);
 }
@@ -181,6 +186,11 @@ void RtspStream::setState(State newState)
 
     if (oldState == Paused || newState == Paused)
         emit pausedChanged(isPaused());
+
+    if (newState == Error)
+        RtspStreamReconnectScheduler::instance()->failed(this);
+    else if (newState >= Streaming && oldState < Streaming)
+        RtspStreamReconnectScheduler::instance()->connected(this);
 }
 
 QUrl RtspStream::url() const
@@ -203,10 +213,7 @@ void RtspStream::setBandwidthMode(int value)
     emit bandwidthModeChanged(value);
 
     if (state() >= Connecting)
-    {
-        stop();
-        start();
-    }
+        restart();
 }
 
 void RtspStream::enableHWAccel(bool hwAccel)
@@ -219,10 +226,31 @@ void RtspStream::enableHWAccel(bool hwAccel)
     emit hwAccelChanged(hwAccel);
 
     if (state() >= Connecting)
-    {
-        stop();
-        start();
-    }
+        restart();
+}
+
+void RtspStream::setKeyframesOnly(bool keyframesOnly)
+{
+    if (m_keyframesOnly == keyframesOnly)
+        return;
+
+    m_keyframesOnly = keyframesOnly;
+    updateKeyframesOnly();
+}
+
+void RtspStream::setHiddenKeyframesOnly(bool keyframesOnly)
+{
+    m_isHiddenKeyframesOnly = keyframesOnly;
+    updateKeyframesOnly();
+}
+
+void RtspStream::updateKeyframesOnly()
+{
+    /* Switched on the live connection, unlike the bandwidth mode */
+    if (m_thread && m_thread->hasWorker())
+        m_thread->setKeyframesOnly(isKeyframesOnly());
+    if (m_pendingThread && m_pendingThread->hasWorker())
+        m_pendingThread->setKeyframesOnly(isKeyframesOnly());
 }
 
 void RtspStream::hwAccelDisabled()
@@ -231,6 +259,45 @@ void RtspStream::hwAccelDisabled()
     emit hwAccelChanged(false);
 }
 
+bool RtspStream::useUdpTransport() const
+{
+    DVRServer *server = m_camera ? m_camera.data()->data().server() : 0;
+    return server && server->configuration().rtspTransport() == DVRServerRtspTransport::UDP && !m_udpTransportFailed;
+}
+
+void RtspStream::udpTransportFailed()
+{
+    /* Usually a firewall or NAT on the way; the following attempts go over TCP until
+     * the stream is stopped */
+    if (!m_udpTransportFailed)
+        qDebug() << "RtspStream: no video over UDP from" << LoggableUrl(url()) << "- falling back to TCP";
+    m_udpTransportFailed = true;
+}
+
+void RtspStream::rtspTransportChanged()
+{
+    /* A transport chosen again deserves another try, even if it failed before */
+    m_udpTransportFailed = false;
+
+    if (state() >= Connecting)
+        restart();
+}
+
+RtspStreamLossMonitor::Statistics RtspStream::transportStatistics() const
+{
+    return m_thread ? m_thread->transportStatistics() : RtspStreamLossMonitor::Statistics();
+}
+
+void RtspStream::setConnectTimings(const RtspStreamConnectTimings &timings)
+{
+    m_connectTimings = timings;
+
+    qDebug() << "RtspStream: connected to" << LoggableUrl(url()) << "in" << timings.firstFrame << "ms"
+             << (timings.probeCached ? "(cached stream info)" : "(probed stream info)")
+             << "- open:" << timings.openInput << "stream info:" << timings.findStreamInfo
+             << "codecs:" << timings.openCodecs << "first packet:" << timings.firstPacket;
+}
+
 void RtspStream::updateHwAccelSettings()
 {
     QSettings settings;
@@ -250,42 +317,184 @@ void RtspStream::start()
         return;
     }
 
-    connect(m_renderTimer, SIGNAL(timeout()), SLOT(updateFrame()), Qt::UniqueConnection);
-
     m_frameInterval.start();
+    m_fpsTimer.start();
+    m_fpsUpdateHits = 0;
+    m_pendingThreadFailures = 0;
 
     if (m_thread)
         m_thread->stop();
 
     updateHwAccelSettings();
+    m_lowLatency = isLowLatencyProfile();
 
     m_thread.reset(new RtspStreamThread());
-    connect(m_thread.data(), SIGNAL(fatalError(QString)), this, SLOT(fatalError(QString)));
-    connect(m_thread.data(), SIGNAL(hwAccelDisabled()), this, SLOT(hwAccelDisabled()));
-    connect(m_thread.data(), SIGNAL(audioFormat(enum AVSampleFormat, int, int)), this, SLOT(setAudioFormat(AVSampleFormat,int,int)), Qt::DirectConnection);
-    m_thread->start(url(), m_isHWAccelEnabled);
+    connectThread(m_thread.data());
+    m_thread->start(url(), m_isHWAccelEnabled, useUdpTransport(), m_lowLatency);
 
     updateSettings();
+    updateFrameSizeHint();
+    updateKeyframesOnly();
     setState(Connecting);
+
+    /* A recording survives reconnecting, in a new file for every connection */
+    if (isRecordingLocally())
+    {
+        ++m_localRecordingSegment;
+        m_thread->setRecordingFile(localRecordingSegmentFile());
+    }
+
+    DVRServer *server = m_camera ? m_camera.data()->data().server() : 0;
+    RtspStreamReconnectScheduler::instance()->connecting(this, server);
+}
+
+void RtspStream::connectThread(RtspStreamThread *thread)
+{
+    connect(thread, SIGNAL(fatalError(QString)), this, SLOT(fatalError(QString)));
+    connect(thread, SIGNAL(hwAccelDisabled()), this, SLOT(hwAccelDisabled()));
+    connect(thread, SIGNAL(udpTransportFailed()), this, SLOT(udpTransportFailed()));
+    connect(thread, SIGNAL(frameAvailable()), this, SLOT(frameAvailable()));
+    connect(thread, SIGNAL(replayStarted()), this, SLOT(replayStarted()));
+    connect(thread, SIGNAL(replayFinished()), this, SLOT(replayFinished()));
+    connect(thread, SIGNAL(recordingFailed(QString)), this, SLOT(localRecordingError(QString)));
+    connect(thread, SIGNAL(connected(RtspStreamConnectTimings)), this, SLOT(setConnectTimings(RtspStreamConnectTimings)));
+    connect(thread, SIGNAL(audioFormat(enum AVSampleFormat, int, int)), this, SLOT(setAudioFormat(AVSampleFormat,int,int)), Qt::DirectConnection);
+}
+
+void RtspStream::restart()
+{
+    /* A failed stream waits for its turn like any other retry, without the delay it
+     * had built up; many of them may be restarted by one settings change */
+    if (state() == Error || state() == NotConnected)
+    {
+        stop();
+        DVRServer *server = m_camera ? m_camera.data()->data().server() : 0;
+        RtspStreamReconnectScheduler::instance()->queueStart(this, server);
+        return;
+    }
+
+    /* Without a picture to keep on screen, reconnecting is all there is to do */
+    if (state() != Streaming)
+    {
+        stop();
+        start();
+        return;
+    }
+
+    /* Make before break: the current connection keeps streaming while the new one
+     * connects; a switch that is still warming up is simply replaced */
+    m_pendingThread.reset(new RtspStreamThread());
+    m_pendingHasAudio = false;
+    connect(m_pendingThread.data(), SIGNAL(fatalError(QString)), this, SLOT(pendingThreadFailed(QString)));
+    connect(m_pendingThread.data(), SIGNAL(connected(RtspStreamConnectTimings)), this, SLOT(pendingThreadConnected(RtspStreamConnectTimings)));
+    connect(m_pendingThread.data(), SIGNAL(udpTransportFailed()), this, SLOT(udpTransportFailed()));
+    connect(m_pendingThread.data(), SIGNAL(hwAccelDisabled()), this, SLOT(hwAccelDisabled()));
+    /* Queued, so the format is recorded before connected() arrives from a decoding thread */
+    connect(m_pendingThread.data(), SIGNAL(audioFormat(enum AVSampleFormat, int, int)), this, SLOT(setPendingAudioFormat(AVSampleFormat,int,int)), Qt::QueuedConnection);
+    m_pendingThread->start(url(), m_isHWAccelEnabled, useUdpTransport(), m_lowLatency);
+
+    configureThread(m_pendingThread.data());
+    updateFrameSizeHint();
+    updateKeyframesOnly();
+}
+
+void RtspStream::pendingThreadConnected(const RtspStreamConnectTimings &timings)
+{
+    if (!m_pendingThread || sender() != m_pendingThread.data())
+        return;
+
+    /* The first frame of the new connection is queued already; from here on it is the
+     * one shown, and the old connection goes away without a gap in between */
+    disconnect(m_pendingThread.data(), 0, this, 0);
+    if (m_isAudioEnabled)
+        bcApp->audioPlayer->stop();
+
+    m_thread.reset(m_pendingThread.take());
+    connectThread(m_thread.data());
+    replayFinished();
+    m_pendingThreadFailures = 0;
+
+    /* The audio format was announced by the new connection while it was pending */
+    if (m_hasAudio != m_pendingHasAudio)
+    {
+        m_hasAudio = m_pendingHasAudio;
+        emit audioChanged();
+    }
+    if (m_pendingHasAudio)
+    {
+        m_audioSampleFmt = m_pendingAudioSampleFmt;
+        m_audioChannels = m_pendingAudioChannels;
+        m_audioSampleRate = m_pendingAudioSampleRate;
+    }
+
+    if (m_isAudioEnabled)
+        enableAudio(true);
+
+    if (isRecordingLocally())
+    {
+        ++m_localRecordingSegment;
+        m_thread->setRecordingFile(localRecordingSegmentFile());
+    }
+
+    setConnectTimings(timings);
+    RtspStreamRenderScheduler::instance()->schedule(this);
+}
+
+void RtspStream::pendingThreadFailed(const QString &message)
+{
+    if (!m_pendingThread || sender() != m_pendingThread.data())
+        return;
+
+    /* The current connection keeps streaming with the old settings; switching is
+     * tried again after a backoff delay */
+    m_pendingThread.reset();
+    ++m_pendingThreadFailures;
+    qDebug() << "RtspStream: switching the connection to" << LoggableUrl(url()) << "failed:" << message;
+
+    QTimer::singleShot(RtspStreamReconnectScheduler::backoffDelay(m_pendingThreadFailures), this, SLOT(retryPendingThread()));
+}
+
+void RtspStream::retryPendingThread()
+{
+    /* Not if the stream reconnected meanwhile, which applied the settings anyway */
+    if (m_pendingThreadFailures > 0 && !m_pendingThread && state() == Streaming)
+        restart();
+}
+
+void RtspStream::setPendingAudioFormat(enum AVSampleFormat fmt, int channelsNum, int sampleRate)
+{
+    if (!m_pendingThread || sender() != m_pendingThread.data())
+        return;
+
+    m_pendingHasAudio = true;
+    m_pendingAudioSampleFmt = fmt;
+    m_pendingAudioChannels = channelsNum;
+    m_pendingAudioSampleRate = sampleRate;
 }
 
 void RtspStream::stop()
 {
-    disconnect(m_renderTimer, SIGNAL(timeout()), this, SLOT(updateFrame()));
+    RtspStreamReconnectScheduler::instance()->remove(this);
+    RtspStreamRenderScheduler::instance()->remove(this);
 
     if (m_isAudioEnabled)
         bcApp->audioPlayer->stop();
 
+    m_pendingThread.reset();
     m_thread.reset();
+    replayFinished();
 
-    delete m_frame;
-    m_frame = 0;
+    QMutexLocker locker(&m_currentFrameMutex);
+    m_frameFanOut.clear();
+    locker.unlock();
 
     if (state() > NotConnected)
     {
         setState(NotConnected);
         m_autoStart = false;
     }
+
+    m_udpTransportFailed = false;
 }
 
 void RtspStream::setOnline(bool online)
@@ -299,8 +508,12 @@ void RtspStream::setOnline(bool online)
     else if (online && state() == StreamOffline)
     {
         setState(NotConnected);
+        /* Cameras of a server come online together; connect them a few at a time */
         if (m_autoStart)
-            start();
+        {
+            DVRServer *server = m_camera ? m_camera.data()->data().server() : 0;
+            RtspStreamReconnectScheduler::instance()->queueStart(this, server);
+        }
     }
 }
 
@@ -318,25 +531,247 @@ void RtspStream::setPaused(bool pause)
     m_frameInterval.restart();
 }
 
+int RtspStream::replayBufferDuration() const
+{
+    return state() >= Streaming ? m_replayBufferDuration : 0;
+}
+
+void RtspStream::replay(int seconds)
+{
+    if (seconds <= 0 || state() != Streaming || !m_thread || !m_thread->hasWorker())
+        return;
+
+    m_thread->replay(qMin(seconds, m_replayBufferDuration));
+}
+
+void RtspStream::startLocalRecording(const QString &fileName)
+{
+    if (fileName.isEmpty() || fileName == m_localRecordingFile || !canRecordLocally())
+        return;
+
+    m_localRecordingFile = fileName;
+    m_localRecordingSegment = 1;
+    if (m_thread)
+        m_thread->setRecordingFile(fileName);
+
+    emit localRecordingChanged(true);
+}
+
+void RtspStream::stopLocalRecording()
+{
+    if (!isRecordingLocally())
+        return;
+
+    m_localRecordingFile.clear();
+    if (m_thread)
+        m_thread->setRecordingFile(QString());
+
+    emit localRecordingChanged(false);
+}
+
+void RtspStream::localRecordingError(const QString &message)
+{
+    stopLocalRecording();
+    emit localRecordingFailed(message);
+}
+
+QString RtspStream::localRecordingSegmentFile() const
+{
+    if (m_localRecordingSegment <= 1)
+        return m_localRecordingFile;
+
+    /* "camera.mkv" continues in "camera-2.mkv" */
+    QFileInfo info(m_localRecordingFile);
+    QString name = QString::fromLatin1("%1-%2").arg(info.completeBaseName()).arg(m_localRecordingSegment);
+    if (!info.suffix().isEmpty())
+        name += QLatin1Char('.') + info.suffix();
+
+    return info.dir().filePath(name);
+}
+
+void RtspStream::replayStarted()
+{
+    if (m_isReplaying)
+        return;
+
+    m_isReplaying = true;
+    emit replayingChanged(true);
+}
+
+void RtspStream::replayFinished()
+{
+    if (!m_isReplaying)
+        return;
+
+    m_isReplaying = false;
+    emit replayingChanged(false);
+}
+
+float RtspStream::receivedFps() const
+{
+    /* Updated only when frames are shown, so a stalled stream would keep its last rate */
+    if (m_frameInterval.isValid() && m_frameInterval.elapsed() >= fpsWindowMs)
+        return 0;
+    return m_fps;
+}
+
+int RtspStream::skippedNonReferenceFrames() const
+{
+    return m_thread ? m_thread->skippedNonReferenceFrames() : 0;
+}
+
+int RtspStream::skippedNonKeyframes() const
+{
+    return m_thread ? m_thread->skippedNonKeyframes() : 0;
+}
+
+int RtspStream::backpressure() const
+{
+    return m_thread ? int(m_thread->backpressure()) : 0;
+}
+
+void RtspStream::framePainted(qint64 paintTime)
+{
+    if (!m_thread)
+        return;
+
+    m_thread->recordTiming(RtspStreamStatistics::Paint, paintTime);
+    if (LiveStream::isLatencyMeasurementEnabled())
+        m_thread->framePainted(m_displayedPts);
+}
+
+QString RtspStream::latencyReport() const
+{
+    return m_thread ? m_thread->latencyReport() : QString();
+}
+
+QVariantMap RtspStream::diagnostics() const
+{
+    QVariantMap result = LiveStream::diagnostics();
+    if (m_camera)
+        result.insert(QLatin1String("camera"), m_camera.data()->data().displayName());
+    result.insert(QLatin1String("transport"), QLatin1String(useUdpTransport() ? "udp" : "tcp"));
+    result.insert(QLatin1String("lowLatency"), m_lowLatency);
+    result.insert(QLatin1String("backpressure"), backpressure());
+
+    if (!m_thread)
+        return result;
+
+    RtspStreamStatistics::Snapshot pipeline = m_thread->pipelineStatistics();
+    QVariantMap timings;
+    for (int i = 0; i < RtspStreamStatistics::TimingCount; ++i)
+    {
+        const RtspStreamStatistics::Percentiles &p = pipeline.timings[i];
+        QVariantMap timing;
+        timing.insert(QLatin1String("samples"), p.samples);
+        timing.insert(QLatin1String("medianUs"), p.median);
+        timing.insert(QLatin1String("p90Us"), p.p90);
+        timing.insert(QLatin1String("p99Us"), p.p99);
+        timing.insert(QLatin1String("maxUs"), p.max);
+        timings.insert(QLatin1String(RtspStreamStatistics::timingName(RtspStreamStatistics::Timing(i))), timing);
+    }
+    result.insert(QLatin1String("timings"), timings);
+
+    QVariantMap frames;
+    frames.insert(QLatin1String("produced"), m_thread->producedFrames());
+    frames.insert(QLatin1String("displayed"), m_thread->displayedFrames());
+    frames.insert(QLatin1String("dropped"), m_thread->droppedFrames());
+    frames.insert(QLatin1String("skippedNonReference"), m_thread->skippedNonReferenceFrames());
+    frames.insert(QLatin1String("skippedNonKeyframes"), m_thread->skippedNonKeyframes());
+    for (int i = 0; i < RtspStreamStatistics::CounterCount; ++i)
+        frames.insert(QLatin1String(RtspStreamStatistics::counterName(RtspStreamStatistics::Counter(i))),
+                      pipeline.counters[i]);
+    result.insert(QLatin1String("frames"), frames);
+
+    RtspStreamLossMonitor::Statistics loss = m_thread->transportStatistics();
+    QVariantMap transport;
+    transport.insert(QLatin1String("received"), loss.receivedFrames);
+    transport.insert(QLatin1String("lost"), loss.lostFrames);
+    transport.insert(QLatin1String("reordered"), loss.reorderedFrames);
+    transport.insert(QLatin1String("corrupt"), loss.corruptFrames);
+    transport.insert(QLatin1String("concealed"), loss.concealedFrames);
+    result.insert(QLatin1String("transportStatistics"), transport);
+
+    return result;
+}
+
+void RtspStream::logLatencyReport()
+{
+    if (state() < Streaming)
+        return;
+
+    qDebug() << "RtspStream: latency of" << LoggableUrl(url()) << (m_lowLatency ? "(low latency)" : "")
+             << qPrintable(latencyReport());
+}
+
+void RtspStream::frameAvailable()
+{
+    if (state() >= Connecting)
+        RtspStreamRenderScheduler::instance()->schedule(this);
+}
+
 void RtspStream::updateFrame()
 {
     if (state() < Connecting || !m_thread || !m_thread->isRunning())
         return;
 
-    if (++m_fpsUpdateCnt == int(1.5*renderTimerFps))
+    if (m_fpsTimer.elapsed() >= fpsWindowMs)
     {
-        m_fps = m_fpsUpdateHits/1.5;
-        m_fpsUpdateCnt = m_fpsUpdateHits = 0;
+        m_fps = m_fpsUpdateHits * 1000.0 / m_fpsTimer.restart();
+        m_fpsUpdateHits = 0;
     }
 
     if (!m_thread || !m_thread->hasWorker())
         return;
 
     RtspStreamFrame *sf = m_thread->frameToDisplay();
+
+    /* One frame is shown per pass; the rest of the queue waits for the next ones,
+     * or until the jitter buffer releases them */
+    int nextFrameDelay = m_thread->msecsToNextFrame();
+    if (nextFrameDelay >= 0)
+        RtspStreamRenderScheduler::instance()->schedule(this, nextFrameDelay);
+
     if (!sf) // no new frame
         return;
 
+    QMutexLocker locker(&m_currentFrameMutex);
+    RtspStreamFrameFanOut::Conversion conversion = m_frameFanOut.prepare(sf->avFrame());
+    locker.unlock();
+
+    /* Converted once for every size the stream is shown at, on the frame decode pool;
+     * the GUI thread only publishes the result in frameConverted() */
+    ThreadTaskExecutor::instance()->start(new RtspStreamFrameConvertTask(this, "frameConverted", sf, conversion),
+                                          ThreadTaskExecutor::FrameDecodePool, ThreadTaskExecutor::HighPriority,
+                                          ThreadTaskExecutor::LatestOnly);
+}
+
+void RtspStream::frameConverted(ThreadTask *task)
+{
+    RtspStreamFrameConvertTask *convertTask = static_cast<RtspStreamFrameConvertTask *>(task);
+    /* Replaced by a newer frame before it was converted */
+    if (convertTask->isCancelled() || state() < Connecting || !m_thread)
+        return;
+
+    m_thread->recordTiming(RtspStreamStatistics::Convert, convertTask->convertTime());
+
+    QMutexLocker locker(&m_currentFrameMutex);
+    /* Converted for a connection that has been stopped since */
+    if (m_frameFanOut.isStale(convertTask->conversion()))
+        return;
+
+    QSize oldStreamSize = m_frameFanOut.streamSize();
+    bool published = m_frameFanOut.publish(convertTask->conversion());
+    bool sizeChanged = m_frameFanOut.streamSize() != oldStreamSize;
+    locker.unlock();
+
+    if (!published)
+    {
+        m_thread->increment(RtspStreamStatistics::ConvertFailures);
+        return;
+    }
 
+    m_displayedPts = convertTask->pts();
 
     m_fpsUpdateHits++;
 
@@ -344,59 +779,71 @@ void RtspStream::updateFrame()
         setState(Streaming);
     m_frameInterval.restart();
 
-    QMutexLocker locker(&m_currentFrameMutex);
-    //bool sizeChanged = (m_currentFrame.width() != sf->avFrame()->width ||
-    //                    m_currentFrame.height() != sf->avFrame()->height);
-    bool sizeChanged = m_frame == 0 || (m_frame->width() != sf->width() || m_frame->height() != sf->height());
-
-    m_currentFrame = QImage(sf->avFrame()->data[0], sf->avFrame()->width, sf->avFrame()->height,
-                            sf->avFrame()->linesize[0], QImage::Format_RGB32).copy();
-
-    delete m_frame;
-    m_frame = sf;
-
     if (sizeChanged)
-        emit streamSizeChanged(m_currentFrame.size());
+        emit streamSizeChanged(streamSize());
     emit updated();
 }
 
-void RtspStream::setFrameSizeHint(int width, int height)
+void RtspStream::setFrameSizeHint(const QObject *consumer, int width, int height)
 {
-    if (m_refcount > 1)
-        return;
-
-    if (state() < Connecting || !m_thread || !m_thread->isRunning())
-        return;
+    QMutexLocker locker(&m_currentFrameMutex);
+    m_frameFanOut.setFrameSizeHint(consumer, QSize(width, height));
+    updateFrameSizeHint();
+}
 
+void RtspStream::updateFrameSizeHint()
+{
     QMutexLocker locker(&m_currentFrameMutex);
 
-    m_thread->setFrameSizeHint(width, height);
+    /* Decoding is prioritized and reduced for the largest tile the stream is shown in */
+    QSize hint = m_frameFanOut.largestFrameSizeHint();
+    if (hint.isEmpty())
+        hint = QSize(-1, -1);
+
+    if (m_thread && m_thread->hasWorker())
+        m_thread->setFrameSizeHint(hint.width(), hint.height());
+    if (m_pendingThread && m_pendingThread->hasWorker())
+        m_pendingThread->setFrameSizeHint(hint.width(), hint.height());
+
+    bool isSmallFrame = hint.width() > 0 && hint.height() > 0 &&
+                        (hint.width() < smallFrameWidth || hint.height() < smallFrameHeight);
+    if (isSmallFrame != m_isSmallFrame)
+    {
+        m_isSmallFrame = isSmallFrame;
+        updateKeyframesOnly();
+    }
 }
 
-void RtspStream::ref()
+void RtspStream::ref(const QObject *consumer)
 {
-    if (m_refcount)
-        setFrameSizeHint(-1, -1);
+    QMutexLocker locker(&m_currentFrameMutex);
+    m_frameFanOut.addConsumer(consumer);
+    updateFrameSizeHint();
+}
 
-    m_refcount++;
+void RtspStream::unref(const QObject *consumer)
+{
+    QMutexLocker locker(&m_currentFrameMutex);
+    m_frameFanOut.removeConsumer(consumer);
+    updateFrameSizeHint();
 }
 
-void RtspStream::unref()
+LiveStreamFrame RtspStream::currentFrame() const
 {
-    m_refcount--;
+    QMutexLocker locker(&m_currentFrameMutex);
+    return m_frameFanOut.largestFrame();
 }
 
-QImage RtspStream::currentFrame() const
+LiveStreamFrame RtspStream::currentFrame(const QObject *consumer) const
 {
     QMutexLocker locker(&m_currentFrameMutex);
-    return m_currentFrame.copy();
+    return m_frameFanOut.frame(consumer);
 }
 
 QSize RtspStream::streamSize() const
 {
     QMutexLocker locker(&m_currentFrameMutex);
-    //return m_currentFrame.size();
-    return m_frame ? QSize(m_frame->width(), m_frame->height()) : QSize(0, 0);
+    return m_frameFanOut.streamSize().isValid() ? m_frameFanOut.streamSize() : QSize(0, 0);
 }
 
 void RtspStream::fatalError(const QString &message)
@@ -407,14 +854,8 @@ void RtspStream::fatalError(const QString &message)
         bcApp->audioPlayer->stop();
 
     m_errorMessage = message;
+    /* RtspStreamReconnectScheduler will handle reconnection */
     setState(Error);
-    /* stateTimer will handle reconnection */
-}
-
-void RtspStream::checkState()
-{
-    if (state() == Error)
-        start();
 }
 
 void RtspStream::updateSettings()
@@ -423,7 +864,41 @@ void RtspStream::updateSettings()
         return;
 
     QSettings settings;
-    m_thread->setAutoDeinterlacing(settings.value(QLatin1String("ui/liveview/autoDeinterlace"), false).toBool());
+    QMutexLocker locker(&m_currentFrameMutex);
+    m_frameFanOut.setAutoDeinterlacing(settings.value(QLatin1String("ui/liveview/autoDeinterlace"), false).toBool());
+    locker.unlock();
+
+    m_replayBufferDuration = qMax(settings.value(QLatin1String("ui/liveview/replayBufferSeconds"), 30).toInt(), 0);
+    RtspStreamPacketBuffer::setMemoryLimit(settings.value(QLatin1String("ui/liveview/replayBufferMemoryMB"), 256).toLongLong() * 1024 * 1024);
+
+    configureThread(m_thread.data());
+    configureThread(m_pendingThread.data());
+
+    /* The low latency profile tunes the connection itself */
+    if (isLowLatencyProfile() != m_lowLatency)
+    {
+        m_lowLatency = !m_lowLatency;
+        restart();
+    }
 
     updateHwAccelSettings();
 }
+
+bool RtspStream::isLowLatencyProfile() const
+{
+    QSettings settings;
+    return settings.value(QLatin1String("ui/liveview/latencyProfile"), RtspStreamFrameQueue::Smooth).toInt() == RtspStreamFrameQueue::LowestLatency;
+}
+
+void RtspStream::configureThread(RtspStreamThread *thread)
+{
+    if (!thread || !thread->hasWorker())
+        return;
+
+    QSettings settings;
+    thread->setReplayBufferDuration(m_replayBufferDuration);
+
+    int profile = settings.value(QLatin1String("ui/liveview/latencyProfile"), RtspStreamFrameQueue::Smooth).toInt();
+    thread->setLatencyProfile(profile == RtspStreamFrameQueue::LowestLatency ? RtspStreamFrameQueue::LowestLatency : RtspStreamFrameQueue::Smooth,
+                              settings.value(QLatin1String("ui/liveview/latencyTarget"), -1).toInt());
+}
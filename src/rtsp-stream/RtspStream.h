@@ -22,18 +22,27 @@
 #include <QObject>
 #include <QThread>
 #include <QImage>
+#include <QSharedPointer>
 #include <QElapsedTimer>
+#include <QTimer>
 #include "camera/DVRCamera.h"
 #include "core/LiveStream.h"
 #include "core/LiveViewManager.h"
 #include "audio/AudioPlayer.h"
+#include "RtspStreamConnectTimings.h"
+#include "RtspStreamFrameFanOut.h"
+#include "RtspStreamLossMonitor.h"
 
+class RtspStreamFrame;
 class RtspStreamThread;
+class ThreadTask;
 
 class RtspStream : public LiveStream
 {
     Q_OBJECT
 
+    friend class RtspStreamRenderScheduler;
+
 public:
 
     static void init();
@@ -48,18 +57,46 @@ public:
     State state() const { return m_state; }
     QString errorMessage() const { return m_errorMessage; }
 
-    QImage currentFrame() const;
+    LiveStreamFrame currentFrame() const;
+    LiveStreamFrame currentFrame(const QObject *consumer) const;
     QSize streamSize() const;
 
-    float receivedFps() const { return m_fps; }
+    float receivedFps() const;
+    /* Frames not decoded since connecting because display could not keep up; a wall
+     * close to saturation skips non-reference frames, a saturated one all but keyframes */
+    int skippedNonReferenceFrames() const;
+    int skippedNonKeyframes() const;
+    /* 0 when every frame is decoded, see RtspStreamFrameQueue::Backpressure */
+    int backpressure() const;
+    /* Lost, reordered and concealed frames of the current connection */
+    RtspStreamLossMonitor::Statistics transportStatistics() const;
+    bool isUdpTransport() const { return useUdpTransport(); }
+    /* Paint time goes into the pipeline statistics; the latency meter is only
+     * updated in latency measurement mode, see RtspStreamLatencyMeter */
+    void framePainted(qint64 paintTime);
+    QString latencyReport() const;
+    /* Adds pipeline timings, frame counts and transport statistics */
+    QVariantMap diagnostics() const;
+    /* Stage timings of the last connection that got to a decoded frame */
+    RtspStreamConnectTimings connectTimings() const { return m_connectTimings; }
 
     bool isPaused() const { return state() == Paused; }
     bool isConnected() const { return state() > Connecting; }
     bool hasAudio() const { return m_hasAudio; }
     bool isAudioEnabled() const { return m_isAudioEnabled; }
-    void setFrameSizeHint(int width, int height);
-    void ref();
-    void unref();
+    void setFrameSizeHint(const QObject *consumer, int width, int height);
+    bool isKeyframesOnly() const { return m_keyframesOnly || m_isSmallFrame || m_isHiddenKeyframesOnly; }
+    void ref(const QObject *consumer);
+    void unref(const QObject *consumer);
+    int replayBufferDuration() const;
+    bool isReplaying() const { return m_isReplaying; }
+    bool canRecordLocally() const { return state() >= Streaming || isRecordingLocally(); }
+    bool isRecordingLocally() const { return !m_localRecordingFile.isEmpty(); }
+
+protected:
+    void setHiddenKeyframesOnly(bool keyframesOnly);
+    /* Pausing would stop the local recording or the replay */
+    bool canPauseWhileHidden() const { return !isRecordingLocally() && !m_isReplaying; }
 
 public slots:
     void start();
@@ -71,44 +108,86 @@ public slots:
     void setBandwidthMode(int bandwidthMode);
     void enableAudio(bool);
     void enableHWAccel(bool hwAccel);
+    void setKeyframesOnly(bool keyframesOnly);
     void setAudioFormat(enum AVSampleFormat, int, int);
+    void replay(int seconds);
+    void startLocalRecording(const QString &fileName);
+    void stopLocalRecording();
 
 private slots:
+    void frameAvailable();
     void updateFrame();
     void fatalError(const QString &message);
     void updateSettings();
-    void checkState();
     void hwAccelDisabled();
     void updateHwAccelSettings();
+    void setConnectTimings(const RtspStreamConnectTimings &timings);
+    void replayStarted();
+    void replayFinished();
+    void localRecordingError(const QString &message);
+    void pendingThreadConnected(const RtspStreamConnectTimings &timings);
+    void pendingThreadFailed(const QString &message);
+    void retryPendingThread();
+    void setPendingAudioFormat(enum AVSampleFormat fmt, int channelsNum, int sampleRate);
+    void udpTransportFailed();
+    void rtspTransportChanged();
+    void logLatencyReport();
 
 private:
-    static QTimer *m_renderTimer, *m_stateTimer;
-
     QWeakPointer<DVRCamera> m_camera;
     QScopedPointer<RtspStreamThread> m_thread;
-    QImage m_currentFrame;
+    /* Connection replacing m_thread once it has decoded a frame, see restart() */
+    QScopedPointer<RtspStreamThread> m_pendingThread;
+    RtspStreamFrameFanOut m_frameFanOut;
     mutable QMutex m_currentFrameMutex;
-    class RtspStreamFrame *m_frame;
     QString m_errorMessage;
     State m_state;
     bool m_autoStart;
     LiveViewManager::BandwidthMode m_bandwidthMode;
 
-    int m_fpsUpdateCnt;
+    QElapsedTimer m_fpsTimer;
     int m_fpsUpdateHits;
     float m_fps;
     bool m_hasAudio;
     bool m_isAudioEnabled;
     bool m_isHWAccelEnabled;
+    bool m_keyframesOnly;
+    bool m_isSmallFrame;
+    bool m_isHiddenKeyframesOnly;
+    int m_replayBufferDuration;
+    bool m_isReplaying;
+    QString m_localRecordingFile;
+    int m_localRecordingSegment;
+    bool m_udpTransportFailed;
+    bool m_lowLatency;
+    qint64 m_displayedPts;
+    QTimer m_latencyReportTimer;
 
     QElapsedTimer m_frameInterval;
+    RtspStreamConnectTimings m_connectTimings;
 
     enum AVSampleFormat m_audioSampleFmt;
     int m_audioChannels;
     int m_audioSampleRate;
-    int m_refcount;
+
+    /* Switches that failed in a row since the stream was started */
+    int m_pendingThreadFailures;
+    /* Audio format of m_pendingThread, applied when it takes over */
+    bool m_pendingHasAudio;
+    enum AVSampleFormat m_pendingAudioSampleFmt;
+    int m_pendingAudioChannels;
+    int m_pendingAudioSampleRate;
 
     void setState(State newState);
+    void connectThread(RtspStreamThread *thread);
+    void configureThread(RtspStreamThread *thread);
+    void restart();
+    bool useUdpTransport() const;
+    bool isLowLatencyProfile() const;
+    void updateKeyframesOnly();
+    void updateFrameSizeHint();
+    QString localRecordingSegmentFile() const;
+    Q_INVOKABLE void frameConverted(ThreadTask *task);
 
 };
 
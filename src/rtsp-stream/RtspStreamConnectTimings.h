@@ -0,0 +1,44 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_CONNECT_TIMINGS_H
+#define RTSP_STREAM_CONNECT_TIMINGS_H
+
+#include <QMetaType>
+
+/* Time to first frame of a connection, split by stage. Every value is in milliseconds
+ * since connecting started, at the end of the stage, or -1 if it was not reached. */
+struct RtspStreamConnectTimings
+{
+    int openInput;
+    int findStreamInfo;
+    int openCodecs;
+    int firstPacket;
+    int firstFrame;
+    /* Stream info was taken from the previous session instead of being probed */
+    bool probeCached;
+
+    RtspStreamConnectTimings()
+        : openInput(-1), findStreamInfo(-1), openCodecs(-1), firstPacket(-1), firstFrame(-1),
+          probeCached(false)
+    {
+    }
+};
+
+Q_DECLARE_METATYPE(RtspStreamConnectTimings)
+
+#endif // RTSP_STREAM_CONNECT_TIMINGS_H
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "RtspStreamDecodeScheduler.h"
+#include <QDebug>
+
+extern "C" {
+#   include "libavcodec/avcodec.h"
+}
+
+RtspStreamDecodeScheduler * RtspStreamDecodeScheduler::instance()
+{
+    static RtspStreamDecodeScheduler *scheduler = 0;
+    static QMutex instanceMutex;
+
+    QMutexLocker locker(&instanceMutex);
+    if (!scheduler)
+        scheduler = new RtspStreamDecodeScheduler;
+
+    return scheduler;
+}
+
+RtspStreamDecodeScheduler::RtspStreamDecodeScheduler()
+    : m_readySequence(0)
+{
+    int threads = qMax(QThread::idealThreadCount(), 1);
+    qDebug() << "RtspStreamDecodeScheduler: using" << threads << "decoding threads";
+
+    for (int i = 0; i < threads; ++i)
+    {
+        DecodeThread *thread = new DecodeThread(this);
+        m_threads.append(thread);
+        thread->start();
+    }
+}
+
+void RtspStreamDecodeScheduler::addStream(Stream *stream)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_streams.contains(stream))
+        return;
+
+    StreamState *state = new StreamState;
+    state->stream = stream;
+    state->priority = 0;
+    state->readySequence = 0;
+    state->ready = false;
+    state->running = false;
+    state->cancelled = false;
+    m_streams.insert(stream, state);
+}
+
+void RtspStreamDecodeScheduler::removeStream(Stream *stream)
+{
+    QMutexLocker locker(&m_mutex);
+
+    StreamState *state = m_streams.value(stream);
+    if (!state)
+        return;
+
+    state->cancelled = true;
+    m_readyStreams.removeOne(state);
+    state->ready = false;
+    freePackets(state);
+    m_streamUpdated.wakeAll();
+
+    while (state->running)
+        m_streamUpdated.wait(&m_mutex);
+
+    m_streams.remove(stream);
+    delete state;
+}
+
+void RtspStreamDecodeScheduler::setPriority(Stream *stream, int priority)
+{
+    QMutexLocker locker(&m_mutex);
+
+    StreamState *state = m_streams.value(stream);
+    if (state)
+        state->priority = priority;
+}
+
+bool RtspStreamDecodeScheduler::submit(Stream *stream, AVPacket *packet)
+{
+    QMutexLocker locker(&m_mutex);
+
+    StreamState *state = m_streams.value(stream);
+    while (state && !state->cancelled && state->packets.size() >= maxPendingPackets)
+    {
+        m_streamUpdated.wait(&m_mutex);
+        state = m_streams.value(stream);
+    }
+
+    if (!state || state->cancelled)
+    {
+        av_packet_free(&packet);
+        return false;
+    }
+
+    state->packets.enqueue(packet);
+    markReady(state);
+    return true;
+}
+
+void RtspStreamDecodeScheduler::cancel(Stream *stream)
+{
+    QMutexLocker locker(&m_mutex);
+
+    StreamState *state = m_streams.value(stream);
+    if (!state)
+        return;
+
+    state->cancelled = true;
+    m_streamUpdated.wakeAll();
+}
+
+// Calling this method should be protected by m_mutex
+void RtspStreamDecodeScheduler::markReady(StreamState *state)
+{
+    /* A running stream is marked ready again by its decoding thread when done */
+    if (state->ready || state->running || state->cancelled || state->packets.isEmpty())
+        return;
+
+    state->ready = true;
+    state->readySequence = ++m_readySequence;
+    m_readyStreams.append(state);
+    m_workAvailable.wakeOne();
+}
+
+// Calling this method should be protected by m_mutex
+RtspStreamDecodeScheduler::StreamState * RtspStreamDecodeScheduler::takeNextStream()
+{
+    if (m_readyStreams.isEmpty())
+        return 0;
+
+    int next = 0;
+    for (int i = 1; i < m_readyStreams.size(); ++i)
+    {
+        StreamState *candidate = m_readyStreams.at(i);
+        StreamState *best = m_readyStreams.at(next);
+
+        if (candidate->priority > best->priority ||
+            (candidate->priority == best->priority && candidate->readySequence < best->readySequence))
+            next = i;
+    }
+
+    StreamState *state = m_readyStreams.takeAt(next);
+    state->ready = false;
+    return state;
+}
+
+// Calling this method should be protected by m_mutex
+void RtspStreamDecodeScheduler::freePackets(StreamState *state)
+{
+    while (!state->packets.isEmpty())
+    {
+        AVPacket *packet = state->packets.dequeue();
+        av_packet_free(&packet);
+    }
+}
+
+void RtspStreamDecodeScheduler::processLoop()
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (;;)
+    {
+        StreamState *state = takeNextStream();
+        if (!state)
+        {
+            m_workAvailable.wait(&m_mutex);
+            continue;
+        }
+
+        /* One packet at a time, so priorities are re-evaluated after every packet */
+        AVPacket *packet = state->packets.dequeue();
+        state->running = true;
+        m_streamUpdated.wakeAll();
+
+        locker.unlock();
+        state->stream->decodePacket(packet);
+        av_packet_free(&packet);
+        locker.relock();
+
+        state->running = false;
+        markReady(state);
+        m_streamUpdated.wakeAll();
+    }
+}
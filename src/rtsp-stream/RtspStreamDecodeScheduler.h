@@ -0,0 +1,109 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTSP_STREAM_DECODE_SCHEDULER_H
+#define RTSP_STREAM_DECODE_SCHEDULER_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+
+struct AVPacket;
+
+/* Decodes video packets of all live streams on a fixed number of threads.
+ *
+ * Each RtspStreamWorker reads packets from the network on its own thread and submits
+ * them here. Packets of one stream are decoded in order and never on two threads at
+ * once; across streams, the one with the highest priority is served first, streams of
+ * equal priority are served in the order they became ready. */
+class RtspStreamDecodeScheduler
+{
+    Q_DISABLE_COPY(RtspStreamDecodeScheduler)
+
+public:
+    class Stream
+    {
+    public:
+        virtual ~Stream() {}
+
+        /* Called on one of the decoding threads */
+        virtual void decodePacket(AVPacket *packet) = 0;
+    };
+
+    static RtspStreamDecodeScheduler * instance();
+
+    int threadCount() const { return m_threads.size(); }
+
+    void addStream(Stream *stream);
+    /* Discards pending packets and waits until a running decode of the stream finishes.
+     * The stream will not be called anymore after this returns. */
+    void removeStream(Stream *stream);
+    void setPriority(Stream *stream, int priority);
+
+    /* Takes ownership of packet. Blocks while too many packets of the stream are
+     * waiting to be decoded, which throttles reading. Returns false if the packet
+     * was discarded because the stream is unknown or cancelled. */
+    bool submit(Stream *stream, AVPacket *packet);
+    /* Wakes up a blocked submit(); all further packets of the stream are discarded */
+    void cancel(Stream *stream);
+
+private:
+    struct StreamState
+    {
+        Stream *stream;
+        QQueue<AVPacket *> packets;
+        int priority;
+        quint64 readySequence;
+        bool ready;
+        bool running;
+        bool cancelled;
+    };
+
+    class DecodeThread : public QThread
+    {
+    public:
+        explicit DecodeThread(RtspStreamDecodeScheduler *scheduler) : m_scheduler(scheduler) {}
+
+    protected:
+        virtual void run() { m_scheduler->processLoop(); }
+
+    private:
+        RtspStreamDecodeScheduler *m_scheduler;
+    };
+
+    static const int maxPendingPackets = 50;
+
+    QMutex m_mutex;
+    QWaitCondition m_workAvailable;
+    QWaitCondition m_streamUpdated;
+    QHash<Stream *, StreamState *> m_streams;
+    QList<StreamState *> m_readyStreams;
+    quint64 m_readySequence;
+    QList<DecodeThread *> m_threads;
+
+    RtspStreamDecodeScheduler();
+
+    void processLoop();
+    StreamState * takeNextStream();
+    void markReady(StreamState *state);
+    void freePackets(StreamState *state);
+
+};
+
+#endif // RTSP_STREAM_DECODE_SCHEDULER_H
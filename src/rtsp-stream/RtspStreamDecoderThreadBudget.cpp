@@ -0,0 +1,143 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamDecoderThreadBudget.h"
+#include <QDebug>
+#include <QThread>
+#include <QtAlgorithms>
+#include <cmath>
+
+/* Decoders are given enough threads to be busy about half of the time, which leaves
+ * room for bitrate peaks */
+static const double targetBusyFraction = 0.5;
+static const int maxThreadsPerStream = 8;
+
+RtspStreamDecoderThreadBudget * RtspStreamDecoderThreadBudget::instance()
+{
+    static RtspStreamDecoderThreadBudget *budget = 0;
+    static QMutex instanceMutex;
+
+    QMutexLocker locker(&instanceMutex);
+    if (!budget)
+        budget = new RtspStreamDecoderThreadBudget(QThread::idealThreadCount());
+
+    return budget;
+}
+
+RtspStreamDecoderThreadBudget::RtspStreamDecoderThreadBudget(int coreCount)
+    : m_coreCount(qMax(coreCount, 1))
+{
+}
+
+int RtspStreamDecoderThreadBudget::estimatedDemand(int width, int height)
+{
+    /* One thread per started 1080p worth of pixels: 2 for 1080p, 5 for 4K */
+    return 1 + qMax(width, 0) * qMax(height, 0) / (1920 * 1080);
+}
+
+int RtspStreamDecoderThreadBudget::addStream(const void *stream, int width, int height)
+{
+    QMutexLocker locker(&m_mutex);
+
+    StreamInfo info;
+    info.width = width;
+    info.height = height;
+    info.measuredDemand = 0;
+    info.threads = 1;
+    m_streams.insert(stream, info);
+
+    rebalance();
+    return m_streams.value(stream).threads;
+}
+
+void RtspStreamDecoderThreadBudget::removeStream(const void *stream)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_streams.remove(stream))
+        rebalance();
+}
+
+void RtspStreamDecoderThreadBudget::setDecodeLoad(const void *stream, double busyFraction)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QHash<const void *, StreamInfo>::iterator it = m_streams.find(stream);
+    if (it == m_streams.end())
+        return;
+
+    /* Busy time shrinks about linearly with the number of threads */
+    int demand = int(std::ceil(busyFraction * it->threads / targetBusyFraction));
+    demand = qBound(1, demand, maxThreadsPerStream);
+    if (demand == it->measuredDemand)
+        return;
+
+    it->measuredDemand = demand;
+    rebalance();
+}
+
+int RtspStreamDecoderThreadBudget::threadCount(const void *stream) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QHash<const void *, StreamInfo>::const_iterator it = m_streams.find(stream);
+    return it == m_streams.end() ? 1 : it->threads;
+}
+
+namespace
+{
+
+struct StreamDemand
+{
+    const void *stream;
+    int demand;
+
+    bool operator<(const StreamDemand &other) const { return demand > other.demand; }
+};
+
+}
+
+void RtspStreamDecoderThreadBudget::rebalance()
+{
+    QList<StreamDemand> demands;
+    for (QHash<const void *, StreamInfo>::const_iterator it = m_streams.constBegin(); it != m_streams.constEnd(); ++it)
+    {
+        StreamDemand demand;
+        demand.stream = it.key();
+        demand.demand = it->measuredDemand ? it->measuredDemand : estimatedDemand(it->width, it->height);
+        demands.append(demand);
+    }
+
+    /* Each stream already keeps one core busy at most; only the rest is spare */
+    int spare = qMax(m_coreCount - demands.size(), 0);
+    int maxThreads = qMin(maxThreadsPerStream, m_coreCount);
+
+    qStableSort(demands);
+    foreach (const StreamDemand &demand, demands)
+    {
+        int extra = qMin(qMin(demand.demand, maxThreads) - 1, spare);
+        spare -= extra;
+
+        StreamInfo &info = m_streams[demand.stream];
+        if (info.threads != 1 + extra)
+        {
+            info.threads = 1 + extra;
+            qDebug() << "RtspStreamDecoderThreadBudget: stream" << demand.stream << "now uses" << info.threads
+                     << "decoder threads";
+        }
+    }
+}
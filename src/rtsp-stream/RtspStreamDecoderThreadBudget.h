@@ -0,0 +1,73 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_DECODER_THREAD_BUDGET_H
+#define RTSP_STREAM_DECODER_THREAD_BUDGET_H
+
+#include <QHash>
+#include <QMutex>
+
+/* Shares decoder threads (FFmpeg slice or frame threads) between all live streams.
+ *
+ * Every stream gets at least one thread. Cores that are not already kept busy by one
+ * stream each are handed out as additional threads to the streams that need them most;
+ * with many small streams everyone is single threaded, while a single 4K stream can use
+ * most of the machine. Demand is estimated from the resolution until the stream reports
+ * how busy its decoder actually is.
+ *
+ * Allocations are recomputed whenever a stream is added, removed or reports its load.
+ * Streams poll threadCount() and reopen their decoder when it changes. */
+class RtspStreamDecoderThreadBudget
+{
+    Q_DISABLE_COPY(RtspStreamDecoderThreadBudget)
+
+public:
+    static RtspStreamDecoderThreadBudget * instance();
+
+    explicit RtspStreamDecoderThreadBudget(int coreCount);
+
+    int coreCount() const { return m_coreCount; }
+
+    /* Returns the number of threads to open the decoder with */
+    int addStream(const void *stream, int width, int height);
+    void removeStream(const void *stream);
+
+    /* Fraction of wall time the decoder of stream was busy, measured with the
+     * thread count it currently uses */
+    void setDecodeLoad(const void *stream, double busyFraction);
+
+    int threadCount(const void *stream) const;
+
+private:
+    struct StreamInfo
+    {
+        int width;
+        int height;
+        int measuredDemand;
+        int threads;
+    };
+
+    mutable QMutex m_mutex;
+    const int m_coreCount;
+    QHash<const void *, StreamInfo> m_streams;
+
+    static int estimatedDemand(int width, int height);
+    void rebalance();
+
+};
+
+#endif // RTSP_STREAM_DECODER_THREAD_BUDGET_H
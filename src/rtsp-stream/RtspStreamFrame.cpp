@@ -22,14 +22,15 @@ extern "C" {
 }
 
 RtspStreamFrame::RtspStreamFrame(AVFrame *avFrame, int width, int height)
-    : m_avFrame(avFrame), m_streamWidth(width), m_streamHeight(height)
+    : m_avFrame(avFrame), m_streamWidth(width), m_streamHeight(height),
+      m_mediaTime(AV_NOPTS_VALUE), m_queueTime(0)
 {
     Q_ASSERT(m_avFrame);
 }
 
 RtspStreamFrame::~RtspStreamFrame()
 {
-    av_free(m_avFrame->data[0]);
+    /* Pixel data is reference counted through avFrame->buf and goes back to its pool */
     av_frame_free(&m_avFrame);
 }
 
@@ -37,3 +38,9 @@ AVFrame * RtspStreamFrame::avFrame() const
 {
     return m_avFrame;
 }
+
+QImage RtspStreamFrame::image() const
+{
+    const uchar *data = m_avFrame->data[0];
+    return QImage(data, m_avFrame->width, m_avFrame->height, m_avFrame->linesize[0], QImage::Format_RGB32);
+}
@@ -18,11 +18,13 @@
 #ifndef RTSP_STREAM_FRAME_H
 #define RTSP_STREAM_FRAME_H
 
+#include "core/LiveStreamFrame.h"
+#include <QImage>
 #include <QtGlobal>
 
 struct AVFrame;
 
-class RtspStreamFrame
+class RtspStreamFrame : public LiveStreamFrameBuffer
 {
     Q_DISABLE_COPY(RtspStreamFrame);
 
@@ -31,13 +33,24 @@ public:
     ~RtspStreamFrame();
 
     AVFrame * avFrame() const;
+    /* Read-only view of the pixels; only valid while this frame exists */
+    QImage image() const;
     int width() { return m_streamWidth; }
     int height() { return m_streamHeight; }
 
+    /* Set by RtspStreamFrameQueue, in microseconds. The media time is the pts in
+     * the stream time base converted to microseconds, AV_NOPTS_VALUE if unknown. */
+    qint64 mediaTime() const { return m_mediaTime; }
+    void setMediaTime(qint64 mediaTime) { m_mediaTime = mediaTime; }
+    qint64 queueTime() const { return m_queueTime; }
+    void setQueueTime(qint64 queueTime) { m_queueTime = queueTime; }
+
 private:
     AVFrame *m_avFrame;
     int m_streamWidth;
     int m_streamHeight;
+    qint64 m_mediaTime;
+    qint64 m_queueTime;
 };
 
 #endif // RTSP_STREAM_FRAME_H
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamFrameConvertTask.h"
+#include "RtspStreamFrame.h"
+#include <QElapsedTimer>
+
+extern "C" {
+#   include "libavutil/frame.h"
+}
+
+RtspStreamFrameConvertTask::RtspStreamFrameConvertTask(QObject *caller, const char *callback, RtspStreamFrame *frame,
+                                                       const RtspStreamFrameFanOut::Conversion &conversion)
+    : ThreadTask(caller, callback), m_frame(frame), m_conversion(conversion), m_pts(frame->avFrame()->pts),
+      m_convertTime(0)
+{
+}
+
+RtspStreamFrameConvertTask::~RtspStreamFrameConvertTask()
+{
+    delete m_frame;
+}
+
+void RtspStreamFrameConvertTask::runTask()
+{
+    if (isCancelled())
+        return;
+
+    QElapsedTimer convertTimer;
+    convertTimer.start();
+    RtspStreamFrameFanOut::convert(m_conversion, m_frame->avFrame());
+    m_convertTime = convertTimer.nsecsElapsed() / 1000;
+
+    /* The decoded frame is not needed anymore; release its decoder buffers right away */
+    delete m_frame;
+    m_frame = 0;
+}
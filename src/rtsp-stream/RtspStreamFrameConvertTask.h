@@ -0,0 +1,53 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_FRAME_CONVERT_TASK_H
+#define RTSP_STREAM_FRAME_CONVERT_TASK_H
+
+#include "RtspStreamFrameFanOut.h"
+#include "utils/ThreadTask.h"
+
+class RtspStreamFrame;
+
+/* Converts a displayed frame for every size it is shown at, off the GUI thread; see
+ * RtspStreamFrameFanOut::convert(). Started LatestOnly on the frame decode pool of
+ * ThreadTaskExecutor, so the formatters of a stream are never used by two tasks at
+ * once, and a frame still waiting for a thread is replaced by a newer one. */
+class RtspStreamFrameConvertTask : public ThreadTask
+{
+public:
+    /* Takes ownership of frame */
+    RtspStreamFrameConvertTask(QObject *caller, const char *callback, RtspStreamFrame *frame,
+                               const RtspStreamFrameFanOut::Conversion &conversion);
+    virtual ~RtspStreamFrameConvertTask();
+
+    const RtspStreamFrameFanOut::Conversion & conversion() const { return m_conversion; }
+    qint64 pts() const { return m_pts; }
+    /* Microseconds */
+    qint64 convertTime() const { return m_convertTime; }
+
+protected:
+    virtual void runTask();
+
+private:
+    RtspStreamFrame *m_frame;
+    RtspStreamFrameFanOut::Conversion m_conversion;
+    qint64 m_pts;
+    qint64 m_convertTime;
+};
+
+#endif // RTSP_STREAM_FRAME_CONVERT_TASK_H
@@ -0,0 +1,342 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamFrameConverter.h"
+#include "RtspStreamFrameConverter_p.h"
+
+extern "C" {
+#   include "libavutil/cpu.h"
+#   include "libavutil/frame.h"
+#   include "libavutil/pixfmt.h"
+}
+
+static inline uint8_t clampPixel(int value)
+{
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+void rtspStreamConvertRowGeneric(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *bgra, int width)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        int luma = (y[x] - 16) * 75 + 32;
+        int cb = u[x / 2] - 128;
+        int cr = v[x / 2] - 128;
+
+        bgra[4 * x] = clampPixel((luma + 129 * cb) >> 6);
+        bgra[4 * x + 1] = clampPixel((luma - 25 * cb - 52 * cr) >> 6);
+        bgra[4 * x + 2] = clampPixel((luma + 102 * cr) >> 6);
+        bgra[4 * x + 3] = 255;
+    }
+}
+
+void rtspStreamReduceRowGeneric(const uint8_t *row0, const uint8_t *row1, uint8_t *dst, int dstWidth)
+{
+    for (int x = 0; x < dstWidth; ++x)
+    {
+        int even = (row0[2 * x] + row1[2 * x] + 1) >> 1;
+        int odd = (row0[2 * x + 1] + row1[2 * x + 1] + 1) >> 1;
+        dst[x] = (even + odd + 1) >> 1;
+    }
+}
+
+static RtspStreamConverterKernels genericKernels()
+{
+    RtspStreamConverterKernels kernels;
+    kernels.name = "generic";
+    kernels.convertRow = rtspStreamConvertRowGeneric;
+    kernels.reduceRow = rtspStreamReduceRowGeneric;
+    return kernels;
+}
+
+int rtspStreamSupportedConverterKernels(RtspStreamConverterKernels *kernels, int maxCount)
+{
+    int flags = av_get_cpu_flags();
+    int count = 0;
+
+    if (count < maxCount)
+        kernels[count++] = genericKernels();
+    if (count < maxCount && (flags & AV_CPU_FLAG_NEON) && rtspStreamConverterKernelsNeon(&kernels[count]))
+        count++;
+    if (count < maxCount && (flags & AV_CPU_FLAG_SSE2) && rtspStreamConverterKernelsSse2(&kernels[count]))
+        count++;
+    if (count < maxCount && (flags & AV_CPU_FLAG_AVX2) && rtspStreamConverterKernelsAvx2(&kernels[count]))
+        count++;
+
+    return count;
+}
+
+static RtspStreamConverterKernels selectKernels()
+{
+    /* The last supported set is the widest one */
+    RtspStreamConverterKernels kernels[4];
+    int count = rtspStreamSupportedConverterKernels(kernels, 4);
+    return kernels[count - 1];
+}
+
+static const RtspStreamConverterKernels selectedKernels = selectKernels();
+
+const RtspStreamConverterKernels & rtspStreamConverterKernels()
+{
+    return selectedKernels;
+}
+
+/* Position of destination sample i in source coordinates, in 1/256 units */
+static void samplePosition(int i, int srcSize, int dstSize, int *index, int *weight)
+{
+    int position = int((qint64(2 * i + 1) * srcSize * 256) / (2 * dstSize)) - 128;
+    if (position < 0)
+        position = 0;
+
+    *index = position >> 8;
+    *weight = position & 255;
+
+    if (*index >= srcSize - 1)
+    {
+        *index = srcSize - 1;
+        *weight = 0;
+    }
+}
+
+static void fillBilinearTable(QVector<int> &table, int srcSize, int dstSize)
+{
+    table.resize(2 * dstSize);
+    for (int i = 0; i < dstSize; ++i)
+        samplePosition(i, srcSize, dstSize, &table[2 * i], &table[2 * i + 1]);
+}
+
+static void bilinearRow(const uint8_t *row0, const uint8_t *row1, int rowWeight, const int *table,
+                        uint8_t *dst, int dstWidth)
+{
+    for (int x = 0; x < dstWidth; ++x)
+    {
+        int index = table[2 * x];
+        int weight = table[2 * x + 1];
+        int next = weight ? index + 1 : index;
+
+        int top = row0[index] * (256 - weight) + row0[next] * weight;
+        int bottom = row1[index] * (256 - weight) + row1[next] * weight;
+        dst[x] = (top * (256 - rowWeight) + bottom * rowWeight + 32768) >> 16;
+    }
+}
+
+RtspStreamFrameConverter::RtspStreamFrameConverter()
+    : m_chromaSlotWidth(0), m_tableSrcWidth(0), m_tableDstWidth(0)
+{
+}
+
+bool RtspStreamFrameConverter::canConvert(int srcFormat, int srcWidth, int srcHeight, int dstWidth, int dstHeight)
+{
+    switch (srcFormat)
+    {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+    case AV_PIX_FMT_NV12:
+        break;
+    default:
+        return false;
+    }
+
+    return dstWidth > 0 && dstHeight > 0 && dstWidth <= srcWidth && dstHeight <= srcHeight;
+}
+
+const char * RtspStreamFrameConverter::kernelName()
+{
+    return rtspStreamConverterKernels().name;
+}
+
+int RtspStreamFrameConverter::reductionFactor(int srcWidth, int srcHeight, int dstWidth, int dstHeight)
+{
+    if (srcWidth == dstWidth && srcHeight == dstHeight)
+        return 1;
+
+    /* Chroma is reduced by the same factor, so it has to divide evenly too */
+    for (int factor = 2; factor <= 4; factor *= 2)
+    {
+        if (dstWidth * factor == srcWidth && dstHeight * factor == srcHeight &&
+            srcWidth % (2 * factor) == 0 && srcHeight % (2 * factor) == 0)
+            return factor;
+    }
+
+    return 0;
+}
+
+bool RtspStreamFrameConverter::convert(const AVFrame *src, uint8_t *dst, int dstStride, int dstWidth, int dstHeight)
+{
+    if (!src || !dst || !canConvert(src->format, src->width, src->height, dstWidth, dstHeight))
+        return false;
+
+    m_yRow.resize(dstWidth);
+    m_uRow.resize((dstWidth + 1) / 2);
+    m_vRow.resize((dstWidth + 1) / 2);
+    m_reduceRows.resize(4 * dstWidth);
+
+    if (src->format == AV_PIX_FMT_NV12)
+    {
+        m_chromaSlotWidth = (src->width + 1) / 2;
+        m_chromaSlots.resize(8 * m_chromaSlotWidth);
+    }
+
+    int factor = reductionFactor(src->width, src->height, dstWidth, dstHeight);
+    if (factor)
+        convertReduced(src, dst, dstStride, dstWidth, dstHeight, factor);
+    else
+        convertBilinear(src, dst, dstStride, dstWidth, dstHeight);
+
+    return true;
+}
+
+void RtspStreamFrameConverter::sourceChromaRows(const AVFrame *src, int row, int slot, const uint8_t **u, const uint8_t **v)
+{
+    if (src->format != AV_PIX_FMT_NV12)
+    {
+        *u = src->data[1] + row * src->linesize[1];
+        *v = src->data[2] + row * src->linesize[2];
+        return;
+    }
+
+    uint8_t *uSlot = m_chromaSlots.data() + 2 * slot * m_chromaSlotWidth;
+    uint8_t *vSlot = uSlot + m_chromaSlotWidth;
+    const uint8_t *uv = src->data[1] + row * src->linesize[1];
+
+    for (int x = 0; x < m_chromaSlotWidth; ++x)
+    {
+        uSlot[x] = uv[2 * x];
+        vSlot[x] = uv[2 * x + 1];
+    }
+
+    *u = uSlot;
+    *v = vSlot;
+}
+
+void RtspStreamFrameConverter::reduceRows(const uint8_t *rows[4], int factor, int dstWidth, uint8_t *dst)
+{
+    const RtspStreamConverterKernels &kernels = rtspStreamConverterKernels();
+
+    if (factor == 2)
+    {
+        kernels.reduceRow(rows[0], rows[1], dst, dstWidth);
+        return;
+    }
+
+    uint8_t *first = m_reduceRows.data();
+    uint8_t *second = first + 2 * dstWidth;
+    kernels.reduceRow(rows[0], rows[1], first, 2 * dstWidth);
+    kernels.reduceRow(rows[2], rows[3], second, 2 * dstWidth);
+    kernels.reduceRow(first, second, dst, dstWidth);
+}
+
+void RtspStreamFrameConverter::convertReduced(const AVFrame *src, uint8_t *dst, int dstStride,
+                                              int dstWidth, int dstHeight, int factor)
+{
+    const RtspStreamConverterKernels &kernels = rtspStreamConverterKernels();
+    const int chromaWidth = (dstWidth + 1) / 2;
+    const uint8_t *u = 0;
+    const uint8_t *v = 0;
+    int chromaRow = -1;
+
+    for (int y = 0; y < dstHeight; ++y)
+    {
+        const uint8_t *luma;
+        if (factor == 1)
+            luma = src->data[0] + y * src->linesize[0];
+        else
+        {
+            const uint8_t *rows[4];
+            for (int i = 0; i < factor; ++i)
+                rows[i] = src->data[0] + (y * factor + i) * src->linesize[0];
+            reduceRows(rows, factor, dstWidth, m_yRow.data());
+            luma = m_yRow.constData();
+        }
+
+        if (y / 2 != chromaRow)
+        {
+            chromaRow = y / 2;
+            if (factor == 1)
+                sourceChromaRows(src, chromaRow, 0, &u, &v);
+            else
+            {
+                const uint8_t *uRows[4];
+                const uint8_t *vRows[4];
+                for (int i = 0; i < factor; ++i)
+                    sourceChromaRows(src, chromaRow * factor + i, i, &uRows[i], &vRows[i]);
+
+                reduceRows(uRows, factor, chromaWidth, m_uRow.data());
+                reduceRows(vRows, factor, chromaWidth, m_vRow.data());
+                u = m_uRow.constData();
+                v = m_vRow.constData();
+            }
+        }
+
+        kernels.convertRow(luma, u, v, dst + y * dstStride, dstWidth);
+    }
+}
+
+void RtspStreamFrameConverter::updateBilinearTables(int srcWidth, int dstWidth)
+{
+    if (srcWidth == m_tableSrcWidth && dstWidth == m_tableDstWidth)
+        return;
+
+    fillBilinearTable(m_lumaX, srcWidth, dstWidth);
+    fillBilinearTable(m_chromaX, (srcWidth + 1) / 2, (dstWidth + 1) / 2);
+    m_tableSrcWidth = srcWidth;
+    m_tableDstWidth = dstWidth;
+}
+
+void RtspStreamFrameConverter::convertBilinear(const AVFrame *src, uint8_t *dst, int dstStride,
+                                               int dstWidth, int dstHeight)
+{
+    const RtspStreamConverterKernels &kernels = rtspStreamConverterKernels();
+    const int chromaSrcHeight = (src->height + 1) / 2;
+    const int chromaDstHeight = (dstHeight + 1) / 2;
+    const int chromaDstWidth = (dstWidth + 1) / 2;
+    int chromaRow = -1;
+
+    updateBilinearTables(src->width, dstWidth);
+
+    for (int y = 0; y < dstHeight; ++y)
+    {
+        int row, weight;
+        samplePosition(y, src->height, dstHeight, &row, &weight);
+
+        const uint8_t *row0 = src->data[0] + row * src->linesize[0];
+        const uint8_t *row1 = weight ? row0 + src->linesize[0] : row0;
+        bilinearRow(row0, row1, weight, m_lumaX.constData(), m_yRow.data(), dstWidth);
+
+        if (y / 2 != chromaRow)
+        {
+            chromaRow = y / 2;
+            samplePosition(chromaRow, chromaSrcHeight, chromaDstHeight, &row, &weight);
+
+            const uint8_t *u0, *v0, *u1, *v1;
+            sourceChromaRows(src, row, 0, &u0, &v0);
+            if (weight)
+                sourceChromaRows(src, row + 1, 1, &u1, &v1);
+            else
+            {
+                u1 = u0;
+                v1 = v0;
+            }
+
+            bilinearRow(u0, u1, weight, m_chromaX.constData(), m_uRow.data(), chromaDstWidth);
+            bilinearRow(v0, v1, weight, m_chromaX.constData(), m_vRow.data(), chromaDstWidth);
+        }
+
+        kernels.convertRow(m_yRow.constData(), m_uRow.constData(), m_vRow.constData(),
+                           dst + y * dstStride, dstWidth);
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_FRAME_CONVERTER_H
+#define RTSP_STREAM_FRAME_CONVERTER_H
+
+#include <QVector>
+#include <stdint.h>
+
+struct AVFrame;
+
+/* Converts YUV 4:2:0 frames (planar or NV12) to BGRA, downscaling them on the way.
+ *
+ * Color conversion and 2:1/4:1 downscaling, which cover the common case of tiles that
+ * are half or a quarter of the stream size, use SSE2, AVX2 or NEON kernels selected
+ * at runtime. Other sizes are resampled bilinearly. Everything else (other pixel
+ * formats, upscaling) is left to swscale; check canConvert() first.
+ *
+ * Keeps scratch rows between frames, so one converter should be used per stream. */
+class RtspStreamFrameConverter
+{
+public:
+    RtspStreamFrameConverter();
+
+    static bool canConvert(int srcFormat, int srcWidth, int srcHeight, int dstWidth, int dstHeight);
+
+    /* Name of the kernels used on this CPU, for debug output */
+    static const char * kernelName();
+
+    bool convert(const AVFrame *src, uint8_t *dst, int dstStride, int dstWidth, int dstHeight);
+
+private:
+    /* Luma row, chroma rows and per-slot deinterleaved NV12 chroma rows */
+    QVector<uint8_t> m_yRow;
+    QVector<uint8_t> m_uRow;
+    QVector<uint8_t> m_vRow;
+    QVector<uint8_t> m_reduceRows;
+    QVector<uint8_t> m_chromaSlots;
+    int m_chromaSlotWidth;
+
+    /* Bilinear horizontal sampling positions for luma and chroma */
+    QVector<int> m_lumaX;
+    QVector<int> m_chromaX;
+    int m_tableSrcWidth;
+    int m_tableDstWidth;
+
+    static int reductionFactor(int srcWidth, int srcHeight, int dstWidth, int dstHeight);
+
+    void sourceChromaRows(const AVFrame *src, int row, int slot, const uint8_t **u, const uint8_t **v);
+    void reduceRows(const uint8_t *rows[4], int factor, int dstWidth, uint8_t *dst);
+
+    void convertReduced(const AVFrame *src, uint8_t *dst, int dstStride, int dstWidth, int dstHeight, int factor);
+    void convertBilinear(const AVFrame *src, uint8_t *dst, int dstStride, int dstWidth, int dstHeight);
+    void updateBilinearTables(int srcWidth, int dstWidth);
+
+};
+
+#endif // RTSP_STREAM_FRAME_CONVERTER_H
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamFrameConverter_p.h"
+
+/* Built with -mavx2 (or /arch:AVX2); only called after checking the CPU */
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+static void convertRowAvx2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *bgra, int width)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alpha = _mm256_set1_epi8(-1);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m256i luma = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(y + x)));
+
+        /* 8 chroma samples, duplicated for 16 pixels */
+        __m128i cb8 = _mm_loadl_epi64((const __m128i *)(u + x / 2));
+        __m128i cr8 = _mm_loadl_epi64((const __m128i *)(v + x / 2));
+        __m256i cb = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(cb8, cb8)), _mm256_set1_epi16(128));
+        __m256i cr = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(cr8, cr8)), _mm256_set1_epi16(128));
+
+        luma = _mm256_mullo_epi16(_mm256_sub_epi16(luma, _mm256_set1_epi16(16)), _mm256_set1_epi16(75));
+        luma = _mm256_add_epi16(luma, _mm256_set1_epi16(32));
+
+        __m256i r = _mm256_adds_epi16(luma, _mm256_mullo_epi16(cr, _mm256_set1_epi16(102)));
+        __m256i g = _mm256_subs_epi16(luma, _mm256_mullo_epi16(cb, _mm256_set1_epi16(25)));
+        g = _mm256_subs_epi16(g, _mm256_mullo_epi16(cr, _mm256_set1_epi16(52)));
+        __m256i b = _mm256_adds_epi16(luma, _mm256_mullo_epi16(cb, _mm256_set1_epi16(129)));
+
+        /* Packing and unpacking work within 128 bit lanes: the low lane holds pixels 0-7,
+         * the high lane pixels 8-15 */
+        r = _mm256_packus_epi16(_mm256_srai_epi16(r, 6), zero);
+        g = _mm256_packus_epi16(_mm256_srai_epi16(g, 6), zero);
+        b = _mm256_packus_epi16(_mm256_srai_epi16(b, 6), zero);
+
+        __m256i bg = _mm256_unpacklo_epi8(b, g);
+        __m256i ra = _mm256_unpacklo_epi8(r, alpha);
+        __m256i low = _mm256_unpacklo_epi16(bg, ra);
+        __m256i high = _mm256_unpackhi_epi16(bg, ra);
+
+        _mm256_storeu_si256((__m256i *)(bgra + 4 * x), _mm256_permute2x128_si256(low, high, 0x20));
+        _mm256_storeu_si256((__m256i *)(bgra + 4 * x + 32), _mm256_permute2x128_si256(low, high, 0x31));
+    }
+
+    if (x < width)
+        rtspStreamConvertRowGeneric(y + x, u + x / 2, v + x / 2, bgra + 4 * x, width - x);
+}
+
+static void reduceRowAvx2(const uint8_t *row0, const uint8_t *row1, uint8_t *dst, int dstWidth)
+{
+    const __m256i lowBytes = _mm256_set1_epi16(0x00FF);
+
+    int x = 0;
+    for (; x + 16 <= dstWidth; x += 16)
+    {
+        __m256i rows = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i *)(row0 + 2 * x)),
+                                       _mm256_loadu_si256((const __m256i *)(row1 + 2 * x)));
+        __m256i even = _mm256_and_si256(rows, lowBytes);
+        __m256i odd = _mm256_srli_epi16(rows, 8);
+        __m256i result = _mm256_avg_epu16(even, odd);
+
+        /* Move the packed quadwords of both lanes next to each other */
+        result = _mm256_permute4x64_epi64(_mm256_packus_epi16(result, result), 0x08);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm256_castsi256_si128(result));
+    }
+
+    if (x < dstWidth)
+        rtspStreamReduceRowGeneric(row0 + 2 * x, row1 + 2 * x, dst + x, dstWidth - x);
+}
+
+bool rtspStreamConverterKernelsAvx2(RtspStreamConverterKernels *kernels)
+{
+    kernels->name = "AVX2";
+    kernels->convertRow = convertRowAvx2;
+    kernels->reduceRow = reduceRowAvx2;
+    return true;
+}
+
+#else
+
+bool rtspStreamConverterKernelsAvx2(RtspStreamConverterKernels *kernels)
+{
+    (void) kernels;
+    return false;
+}
+
+#endif
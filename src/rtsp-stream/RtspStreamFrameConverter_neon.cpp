@@ -0,0 +1,98 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamFrameConverter_p.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+static inline void convertPixels(uint8x8_t y, uint8x8_t u, uint8x8_t v, uint8_t *bgra)
+{
+    int16x8_t luma = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(y)), vdupq_n_s16(16));
+    luma = vaddq_s16(vmulq_n_s16(luma, 75), vdupq_n_s16(32));
+    int16x8_t cb = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u)), vdupq_n_s16(128));
+    int16x8_t cr = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v)), vdupq_n_s16(128));
+
+    int16x8_t r = vqaddq_s16(luma, vmulq_n_s16(cr, 102));
+    int16x8_t g = vqsubq_s16(vqsubq_s16(luma, vmulq_n_s16(cb, 25)), vmulq_n_s16(cr, 52));
+    int16x8_t b = vqaddq_s16(luma, vmulq_n_s16(cb, 129));
+
+    uint8x8x4_t pixels;
+    pixels.val[0] = vqshrun_n_s16(b, 6);
+    pixels.val[1] = vqshrun_n_s16(g, 6);
+    pixels.val[2] = vqshrun_n_s16(r, 6);
+    pixels.val[3] = vdup_n_u8(255);
+    vst4_u8(bgra, pixels);
+}
+
+static void convertRowNeon(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *bgra, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        uint8x16_t luma = vld1q_u8(y + x);
+        uint8x8_t cb = vld1_u8(u + x / 2);
+        uint8x8_t cr = vld1_u8(v + x / 2);
+
+        /* Duplicate chroma samples for both pixels they cover */
+        uint8x8x2_t cb2 = vzip_u8(cb, cb);
+        uint8x8x2_t cr2 = vzip_u8(cr, cr);
+
+        convertPixels(vget_low_u8(luma), cb2.val[0], cr2.val[0], bgra + 4 * x);
+        convertPixels(vget_high_u8(luma), cb2.val[1], cr2.val[1], bgra + 4 * x + 32);
+    }
+
+    if (x < width)
+        rtspStreamConvertRowGeneric(y + x, u + x / 2, v + x / 2, bgra + 4 * x, width - x);
+}
+
+static void reduceRowNeon(const uint8_t *row0, const uint8_t *row1, uint8_t *dst, int dstWidth)
+{
+    int x = 0;
+    for (; x + 16 <= dstWidth; x += 16)
+    {
+        /* Loads deinterleave even and odd pixels */
+        uint8x16x2_t top = vld2q_u8(row0 + 2 * x);
+        uint8x16x2_t bottom = vld2q_u8(row1 + 2 * x);
+
+        uint8x16_t even = vrhaddq_u8(top.val[0], bottom.val[0]);
+        uint8x16_t odd = vrhaddq_u8(top.val[1], bottom.val[1]);
+        vst1q_u8(dst + x, vrhaddq_u8(even, odd));
+    }
+
+    if (x < dstWidth)
+        rtspStreamReduceRowGeneric(row0 + 2 * x, row1 + 2 * x, dst + x, dstWidth - x);
+}
+
+bool rtspStreamConverterKernelsNeon(RtspStreamConverterKernels *kernels)
+{
+    kernels->name = "NEON";
+    kernels->convertRow = convertRowNeon;
+    kernels->reduceRow = reduceRowNeon;
+    return true;
+}
+
+#else
+
+bool rtspStreamConverterKernelsNeon(RtspStreamConverterKernels *kernels)
+{
+    (void) kernels;
+    return false;
+}
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_FRAME_CONVERTER_P_H
+#define RTSP_STREAM_FRAME_CONVERTER_P_H
+
+#include <stdint.h>
+
+/* Row kernels used by RtspStreamFrameConverter. Each instruction set lives in its own
+ * translation unit, compiled with the flags it needs; this header must stay free of
+ * anything (like Qt headers) that could be instantiated with those flags.
+ *
+ * All implementations produce exactly the same output as the generic ones:
+ *
+ *   convertRow: BT.601 limited range YUV to BGRA, 6 bit fixed point. u and v hold one
+ *               sample for every two pixels.
+ *   reduceRow:  2:1 box downscale of two rows, as rounding averages of the two rows
+ *               and then of every pixel pair. */
+
+typedef void (*RtspStreamConvertRowFunction)(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                                             uint8_t *bgra, int width);
+typedef void (*RtspStreamReduceRowFunction)(const uint8_t *row0, const uint8_t *row1,
+                                            uint8_t *dst, int dstWidth);
+
+struct RtspStreamConverterKernels
+{
+    const char *name;
+    RtspStreamConvertRowFunction convertRow;
+    RtspStreamReduceRowFunction reduceRow;
+};
+
+void rtspStreamConvertRowGeneric(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *bgra, int width);
+void rtspStreamReduceRowGeneric(const uint8_t *row0, const uint8_t *row1, uint8_t *dst, int dstWidth);
+
+/* Fill kernels and return true if the instruction set was available at compile time.
+ * Whether the CPU supports it must be checked by the caller. */
+bool rtspStreamConverterKernelsSse2(RtspStreamConverterKernels *kernels);
+bool rtspStreamConverterKernelsAvx2(RtspStreamConverterKernels *kernels);
+bool rtspStreamConverterKernelsNeon(RtspStreamConverterKernels *kernels);
+
+/* Kernels selected for the running CPU */
+const RtspStreamConverterKernels & rtspStreamConverterKernels();
+
+/* Fill up to maxCount kernels usable on the running CPU, generic ones first;
+ * returns how many were filled */
+int rtspStreamSupportedConverterKernels(RtspStreamConverterKernels *kernels, int maxCount);
+
+#endif // RTSP_STREAM_FRAME_CONVERTER_P_H
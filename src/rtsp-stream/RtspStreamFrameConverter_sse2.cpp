@@ -0,0 +1,105 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamFrameConverter_p.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+#include <string.h>
+
+static inline __m128i loadChroma(const uint8_t *chroma)
+{
+    /* 4 chroma samples, duplicated for 8 pixels and centered around zero */
+    int32_t samples;
+    memcpy(&samples, chroma, sizeof(samples));
+
+    __m128i c = _mm_unpacklo_epi8(_mm_cvtsi32_si128(samples), _mm_setzero_si128());
+    c = _mm_unpacklo_epi16(c, c);
+    return _mm_sub_epi16(c, _mm_set1_epi16(128));
+}
+
+static void convertRowSse2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *bgra, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi8(-1);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i luma = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(y + x)), zero);
+        __m128i cb = loadChroma(u + x / 2);
+        __m128i cr = loadChroma(v + x / 2);
+
+        luma = _mm_mullo_epi16(_mm_sub_epi16(luma, _mm_set1_epi16(16)), _mm_set1_epi16(75));
+        luma = _mm_add_epi16(luma, _mm_set1_epi16(32));
+
+        __m128i r = _mm_adds_epi16(luma, _mm_mullo_epi16(cr, _mm_set1_epi16(102)));
+        __m128i g = _mm_subs_epi16(luma, _mm_mullo_epi16(cb, _mm_set1_epi16(25)));
+        g = _mm_subs_epi16(g, _mm_mullo_epi16(cr, _mm_set1_epi16(52)));
+        __m128i b = _mm_adds_epi16(luma, _mm_mullo_epi16(cb, _mm_set1_epi16(129)));
+
+        r = _mm_packus_epi16(_mm_srai_epi16(r, 6), zero);
+        g = _mm_packus_epi16(_mm_srai_epi16(g, 6), zero);
+        b = _mm_packus_epi16(_mm_srai_epi16(b, 6), zero);
+
+        __m128i bg = _mm_unpacklo_epi8(b, g);
+        __m128i ra = _mm_unpacklo_epi8(r, alpha);
+        _mm_storeu_si128((__m128i *)(bgra + 4 * x), _mm_unpacklo_epi16(bg, ra));
+        _mm_storeu_si128((__m128i *)(bgra + 4 * x + 16), _mm_unpackhi_epi16(bg, ra));
+    }
+
+    if (x < width)
+        rtspStreamConvertRowGeneric(y + x, u + x / 2, v + x / 2, bgra + 4 * x, width - x);
+}
+
+static void reduceRowSse2(const uint8_t *row0, const uint8_t *row1, uint8_t *dst, int dstWidth)
+{
+    const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+
+    int x = 0;
+    for (; x + 8 <= dstWidth; x += 8)
+    {
+        __m128i rows = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(row0 + 2 * x)),
+                                    _mm_loadu_si128((const __m128i *)(row1 + 2 * x)));
+        __m128i even = _mm_and_si128(rows, lowBytes);
+        __m128i odd = _mm_srli_epi16(rows, 8);
+        __m128i result = _mm_avg_epu16(even, odd);
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(result, result));
+    }
+
+    if (x < dstWidth)
+        rtspStreamReduceRowGeneric(row0 + 2 * x, row1 + 2 * x, dst + x, dstWidth - x);
+}
+
+bool rtspStreamConverterKernelsSse2(RtspStreamConverterKernels *kernels)
+{
+    kernels->name = "SSE2";
+    kernels->convertRow = convertRowSse2;
+    kernels->reduceRow = reduceRowSse2;
+    return true;
+}
+
+#else
+
+bool rtspStreamConverterKernelsSse2(RtspStreamConverterKernels *kernels)
+{
+    (void) kernels;
+    return false;
+}
+
+#endif
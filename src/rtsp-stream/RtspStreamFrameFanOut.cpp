@@ -0,0 +1,272 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamFrameFanOut.h"
+#include "RtspStreamFrame.h"
+#include "RtspStreamFrameFormatter.h"
+
+extern "C" {
+#   include "libavutil/frame.h"
+}
+
+/* A new size is used right away when it differs by more than 1/8 of the current one,
+ * smaller changes are applied once the hint has not changed for settleTime ms */
+static const int hysteresisDivisor = 8;
+static const int settleTime = 250;
+/* Sizes used while the hint is still changing are rounded up to multiples of this */
+static const int bucketSize = 32;
+
+static bool differsMuch(const QSize &current, const QSize &target)
+{
+    return qAbs(target.width() - current.width()) * hysteresisDivisor > current.width() ||
+           qAbs(target.height() - current.height()) * hysteresisDivisor > current.height();
+}
+
+static int roundUpToBucket(int value)
+{
+    return (value + bucketSize - 1) / bucketSize * bucketSize;
+}
+
+static QSize bucketed(const QSize &size, const QSize &streamSize)
+{
+    return QSize(roundUpToBucket(size.width()), roundUpToBucket(size.height())).boundedTo(streamSize);
+}
+
+/* Formatters of the sizes converted last, kept between frames */
+class RtspStreamFrameFanOut::Formatters
+{
+    Q_DISABLE_COPY(Formatters)
+
+public:
+    Formatters() {}
+
+    ~Formatters()
+    {
+        for (int i = 0; i < m_formatters.size(); ++i)
+            delete m_formatters[i].second;
+    }
+
+    RtspStreamFrameFormatter * formatter(const QSize &size)
+    {
+        for (int i = 0; i < m_formatters.size(); ++i)
+        {
+            if (m_formatters[i].first == size)
+                return m_formatters[i].second;
+        }
+
+        m_formatters.append(qMakePair(size, new RtspStreamFrameFormatter));
+        return m_formatters.last().second;
+    }
+
+    void retain(const QList<QSize> &sizes)
+    {
+        for (int i = m_formatters.size() - 1; i >= 0; --i)
+        {
+            if (!sizes.contains(m_formatters[i].first))
+                delete m_formatters.takeAt(i).second;
+        }
+    }
+
+private:
+    QList<QPair<QSize, RtspStreamFrameFormatter *> > m_formatters;
+};
+
+RtspStreamFrameFanOut::RtspStreamFrameFanOut()
+    : m_autoDeinterlacing(true), m_formatters(new Formatters)
+{
+}
+
+RtspStreamFrameFanOut::~RtspStreamFrameFanOut()
+{
+}
+
+void RtspStreamFrameFanOut::addConsumer(const void *consumer)
+{
+    if (!m_consumers.contains(consumer))
+        m_consumers.insert(consumer, Consumer());
+}
+
+void RtspStreamFrameFanOut::removeConsumer(const void *consumer)
+{
+    m_consumers.remove(consumer);
+}
+
+void RtspStreamFrameFanOut::setFrameSizeHint(const void *consumer, const QSize &size)
+{
+    QHash<const void *, Consumer>::iterator it = m_consumers.find(consumer);
+    if (it == m_consumers.end())
+        it = m_consumers.insert(consumer, Consumer());
+
+    QSize hint = size.isEmpty() ? QSize() : size;
+    if (it->frameSizeHint == hint)
+        return;
+
+    it->frameSizeHint = hint;
+    it->hintTimer.start();
+}
+
+QSize RtspStreamFrameFanOut::largestFrameSizeHint() const
+{
+    QSize result;
+    foreach (const Consumer &consumer, m_consumers)
+    {
+        if (consumer.frameSizeHint.isEmpty())
+            return QSize();
+        result = result.expandedTo(consumer.frameSizeHint);
+    }
+
+    return result;
+}
+
+void RtspStreamFrameFanOut::setAutoDeinterlacing(bool autoDeinterlacing)
+{
+    m_autoDeinterlacing = autoDeinterlacing;
+}
+
+void RtspStreamFrameFanOut::updateOutputSize(Consumer &consumer, const QSize &streamSize)
+{
+    QSize target = consumer.frameSizeHint.isEmpty() ? streamSize : consumer.frameSizeHint.boundedTo(streamSize);
+    if (consumer.outputSize == target)
+        return;
+
+    if (consumer.outputSize.isEmpty() || consumer.hintTimer.hasExpired(settleTime))
+        consumer.outputSize = target;
+    else if (differsMuch(consumer.outputSize, target))
+        consumer.outputSize = bucketed(target, streamSize);
+}
+
+QList<QSize> RtspStreamFrameFanOut::outputSizes(const QSize &streamSize)
+{
+    QList<QSize> sizes;
+    for (QHash<const void *, Consumer>::iterator it = m_consumers.begin(); it != m_consumers.end(); ++it)
+    {
+        updateOutputSize(*it, streamSize);
+        if (!sizes.contains(it->outputSize))
+            sizes.append(it->outputSize);
+    }
+
+    /* Keep a frame around for snapshots even when nothing displays the stream */
+    if (sizes.isEmpty())
+        sizes.append(streamSize);
+
+    return sizes;
+}
+
+LiveStreamFrame RtspStreamFrameFanOut::findFrame(const QSize &size) const
+{
+    for (int i = 0; i < m_outputs.size(); ++i)
+    {
+        if (m_outputs[i].first == size)
+            return m_outputs[i].second;
+    }
+
+    return LiveStreamFrame();
+}
+
+RtspStreamFrameFanOut::Conversion RtspStreamFrameFanOut::prepare(AVFrame *avFrame)
+{
+    Conversion conversion;
+    conversion.streamSize = QSize(avFrame->width, avFrame->height);
+    conversion.sizes = outputSizes(conversion.streamSize);
+    conversion.formatters = m_formatters;
+    conversion.autoDeinterlacing = m_autoDeinterlacing;
+    return conversion;
+}
+
+void RtspStreamFrameFanOut::convert(Conversion &conversion, AVFrame *avFrame)
+{
+    conversion.frames.clear();
+    conversion.formatters->retain(conversion.sizes);
+
+    foreach (const QSize &size, conversion.sizes)
+    {
+        RtspStreamFrameFormatter *formatter = conversion.formatters->formatter(size);
+        formatter->setAutoDeinterlacing(conversion.autoDeinterlacing);
+
+        RtspStreamFrame *frame = formatter->formatFrame(avFrame, size.width(), size.height());
+        if (!frame)
+        {
+            conversion.frames.append(LiveStreamFrame());
+            continue;
+        }
+
+        /* The displayed image refers to the converted buffer directly; readers share
+         * it through LiveStreamFrame and it is released together with the last of them */
+        QSharedPointer<LiveStreamFrameBuffer> buffer(frame);
+        conversion.frames.append(LiveStreamFrame(frame->image(), buffer));
+    }
+}
+
+bool RtspStreamFrameFanOut::publish(const Conversion &conversion)
+{
+    if (isStale(conversion))
+        return false;
+
+    QList<QPair<QSize, LiveStreamFrame> > outputs;
+    for (int i = 0; i < conversion.sizes.size() && i < conversion.frames.size(); ++i)
+    {
+        if (!conversion.frames[i].isNull())
+            outputs.append(qMakePair(conversion.sizes[i], conversion.frames[i]));
+    }
+
+    if (outputs.isEmpty())
+        return false;
+
+    m_outputs = outputs;
+    m_streamSize = conversion.streamSize;
+    return true;
+}
+
+bool RtspStreamFrameFanOut::formatFrame(AVFrame *avFrame)
+{
+    Conversion conversion = prepare(avFrame);
+    convert(conversion, avFrame);
+    return publish(conversion);
+}
+
+void RtspStreamFrameFanOut::clear()
+{
+    m_outputs.clear();
+    m_streamSize = QSize();
+    m_formatters = QSharedPointer<Formatters>(new Formatters);
+}
+
+LiveStreamFrame RtspStreamFrameFanOut::frame(const void *consumer) const
+{
+    QHash<const void *, Consumer>::const_iterator it = m_consumers.find(consumer);
+    if (it != m_consumers.end())
+    {
+        LiveStreamFrame frame = findFrame(it->outputSize);
+        if (!frame.isNull())
+            return frame;
+    }
+
+    return largestFrame();
+}
+
+LiveStreamFrame RtspStreamFrameFanOut::largestFrame() const
+{
+    LiveStreamFrame result;
+    for (int i = 0; i < m_outputs.size(); ++i)
+    {
+        QSize size = m_outputs[i].second.size();
+        if (result.isNull() || size.width() * size.height() > result.size().width() * result.size().height())
+            result = m_outputs[i].second;
+    }
+
+    return result;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_FRAME_FAN_OUT_H
+#define RTSP_STREAM_FRAME_FAN_OUT_H
+
+#include "core/LiveStreamFrame.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QSharedPointer>
+#include <QSize>
+
+struct AVFrame;
+
+/* Converts each displayed frame of a stream once for every size it is shown at.
+ *
+ * Every consumer (usually a LiveStreamItem) reports the size it paints the stream at
+ * and gets a frame of exactly that size, so it can be drawn without scaling. Consumers
+ * with the same size share one conversion. Frames are never upscaled; larger consumers
+ * get the stream size.
+ *
+ * While a consumer is resized its output size only follows the hint when it differs by
+ * more than a fraction of the current size, and then to the hint rounded up to a size
+ * bucket, so tiles resized together share conversions and a frame is never smaller than
+ * its tile. The exact size is used once the hint has been stable for a while. Each size
+ * keeps its own formatter, so this limits how often scaler contexts and buffer pools are
+ * rebuilt.
+ *
+ * Conversion can run off the thread that owns the fan-out: prepare() picks the sizes,
+ * convert() can then run on any thread, and publish() hands the frames to consumers.
+ * Only one conversion of a fan-out may run at a time. */
+class RtspStreamFrameFanOut
+{
+    Q_DISABLE_COPY(RtspStreamFrameFanOut)
+
+public:
+    RtspStreamFrameFanOut();
+    ~RtspStreamFrameFanOut();
+
+    void addConsumer(const void *consumer);
+    void removeConsumer(const void *consumer);
+
+    /* An empty size means the consumer wants frames at stream size */
+    void setFrameSizeHint(const void *consumer, const QSize &size);
+
+    /* Largest size any consumer is shown at, or an empty size if some consumer
+     * wants frames at stream size */
+    QSize largestFrameSizeHint() const;
+
+    void setAutoDeinterlacing(bool autoDeinterlacing);
+
+    class Formatters;
+
+    struct Conversion
+    {
+        QSize streamSize;
+        QList<QSize> sizes;
+        QSharedPointer<Formatters> formatters;
+        bool autoDeinterlacing;
+        QList<LiveStreamFrame> frames;
+
+        Conversion() : autoDeinterlacing(true) {}
+    };
+
+    Conversion prepare(AVFrame *avFrame);
+    /* Fills conversion.frames; sizes that could not be converted are left out */
+    static void convert(Conversion &conversion, AVFrame *avFrame);
+    /* The fan-out was cleared since prepare() */
+    bool isStale(const Conversion &conversion) const { return conversion.formatters != m_formatters; }
+    /* Returns false if nothing was converted, or the conversion is stale */
+    bool publish(const Conversion &conversion);
+
+    /* All of the above at once; returns false if no size could be converted */
+    bool formatFrame(AVFrame *avFrame);
+    void clear();
+
+    QSize streamSize() const { return m_streamSize; }
+
+    /* Frame for consumer, or the largest one if its size is not converted yet */
+    LiveStreamFrame frame(const void *consumer) const;
+    LiveStreamFrame largestFrame() const;
+
+private:
+    struct Consumer
+    {
+        QSize frameSizeHint;
+        QSize outputSize;
+        QElapsedTimer hintTimer;
+
+        Consumer() { hintTimer.start(); }
+    };
+
+    QHash<const void *, Consumer> m_consumers;
+    QList<QPair<QSize, LiveStreamFrame> > m_outputs;
+    QSize m_streamSize;
+    bool m_autoDeinterlacing;
+    /* Replaced by clear(), so that conversions still running are not published */
+    QSharedPointer<Formatters> m_formatters;
+
+    void updateOutputSize(Consumer &consumer, const QSize &streamSize);
+    QList<QSize> outputSizes(const QSize &streamSize);
+    LiveStreamFrame findFrame(const QSize &size) const;
+
+};
+
+#endif // RTSP_STREAM_FRAME_FAN_OUT_H
@@ -27,10 +27,9 @@ extern "C"
 #include "libavutil/imgutils.h"
 }
 
-RtspStreamFrameFormatter::RtspStreamFrameFormatter(AVStream *stream) :
-        m_stream(stream), m_sws_context(0), m_pixelFormat(AV_PIX_FMT_BGRA),
-        m_autoDeinterlacing(true), m_shouldTryDeinterlaceStream(shouldTryDeinterlaceStream()),
-        m_width(0), m_height(0)
+RtspStreamFrameFormatter::RtspStreamFrameFormatter() :
+        m_sws_context(0), m_pixelFormat(AV_PIX_FMT_BGRA),
+        m_autoDeinterlacing(true), m_width(0), m_height(0)
 {
 }
 
@@ -44,18 +43,19 @@ void RtspStreamFrameFormatter::setAutoDeinterlacing(bool autoDeinterlacing)
     m_autoDeinterlacing = autoDeinterlacing;
 }
 
-bool RtspStreamFrameFormatter::shouldTryDeinterlaceStream()
+bool RtspStreamFrameFormatter::shouldTryDeinterlaceStream(AVStream *stream)
 {
     /* Assume that H.264 D1-resolution video is interlaced, to work around a solo(?) bug
-     * that results in interlaced_frame not being set for videos from solo6110. */
+     * that results in interlaced_frame not being set for videos from solo6110.
+     * The decoding side sets interlaced_frame on frames of such streams. */
 
-    if (m_stream->codecpar->codec_id != AV_CODEC_ID_H264)
+    if (stream->codecpar->codec_id != AV_CODEC_ID_H264)
         return false;
 
-    if (m_stream->codecpar->width == 704 && m_stream->codecpar->height == 480)
+    if (stream->codecpar->width == 704 && stream->codecpar->height == 480)
         return true;
 
-    if (m_stream->codecpar->width == 720 && m_stream->codecpar->height == 576)
+    if (stream->codecpar->width == 720 && stream->codecpar->height == 576)
         return true;
 
     return false;
@@ -66,7 +66,11 @@ RtspStreamFrame * RtspStreamFrameFormatter::formatFrame(AVFrame* avFrame, int wi
     if (shouldTryDeinterlaceFrame(avFrame))
         deinterlaceFrame(avFrame);
 
-    return new RtspStreamFrame(scaleFrame(avFrame, width, height), avFrame->width, avFrame->height);
+    AVFrame *scaledFrame = scaleFrame(avFrame, width, height);
+    if (!scaledFrame)
+        return 0;
+
+    return new RtspStreamFrame(scaledFrame, avFrame->width, avFrame->height);
 }
 
 bool RtspStreamFrameFormatter::shouldTryDeinterlaceFrame(AVFrame *avFrame)
@@ -74,16 +78,13 @@ bool RtspStreamFrameFormatter::shouldTryDeinterlaceFrame(AVFrame *avFrame)
     if (!m_autoDeinterlacing)
         return false;
 
-    if (avFrame->interlaced_frame)
-        return true;
-
-    return m_shouldTryDeinterlaceStream;
+    return avFrame->interlaced_frame;
 }
 
 void RtspStreamFrameFormatter::deinterlaceFrame(AVFrame* avFrame)
 {
     //int ret = avpicture_deinterlace((AVPicture*)avFrame, (AVPicture*)avFrame,
-    //                                m_stream->codecpar->format, m_stream->codecpar->width, m_stream->codecpar->height);
+    //                                avFrame->format, avFrame->width, avFrame->height);
     int ret = -1;
     if (ret < 0)
         qDebug("deinterlacing failed");
@@ -102,19 +103,34 @@ AVFrame * RtspStreamFrameFormatter::scaleFrame(AVFrame* avFrame, int width, int
         height = m_height;
     }
 
-    updateSWSContext(width, height);
+    bool useConverter = RtspStreamFrameConverter::canConvert(avFrame->format, m_width, m_height, width, height);
+    if (!useConverter)
+    {
+        updateSWSContext((AVPixelFormat) avFrame->format, width, height);
+        if (!m_sws_context)
+            return NULL;
+    }
 
-    if (!m_sws_context)
+    int bufSize = av_image_get_buffer_size(m_pixelFormat, width, height, 4);
+    AVBufferRef *buf = m_framePool.acquire(bufSize);
+    if (!buf)
         return NULL;
 
-    int bufSize  = av_image_get_buffer_size(m_pixelFormat, width, height, 4);
-    uint8_t *buf = (uint8_t*) av_malloc(bufSize);
-
     AVFrame *result = av_frame_alloc();
+    if (!result)
+    {
+        av_buffer_unref(&buf);
+        return NULL;
+    }
 
-    av_image_fill_arrays(result->data, result->linesize, buf, m_pixelFormat, width, height, 4);
-    sws_scale(m_sws_context, (const uint8_t**)avFrame->data, avFrame->linesize, 0, m_height,
-              result->data, result->linesize);
+    /* The frame owns the pooled buffer; freeing the frame returns it to the pool */
+    result->buf[0] = buf;
+    av_image_fill_arrays(result->data, result->linesize, buf->data, m_pixelFormat, width, height, 4);
+    if (useConverter)
+        m_converter.convert(avFrame, result->data[0], result->linesize[0], width, height);
+    else
+        sws_scale(m_sws_context, (const uint8_t**)avFrame->data, avFrame->linesize, 0, m_height,
+                  result->data, result->linesize);
 
     result->width = width;
     result->height = height;
@@ -123,13 +139,13 @@ AVFrame * RtspStreamFrameFormatter::scaleFrame(AVFrame* avFrame, int width, int
     return result;
 }
 
-void RtspStreamFrameFormatter::updateSWSContext(int dstWidth, int dstHeight)
+void RtspStreamFrameFormatter::updateSWSContext(AVPixelFormat srcFormat, int dstWidth, int dstHeight)
 {
     AVPixelFormat pixFormat;
 
-    //convert deprecated pixel format in incoming stream
+    //convert deprecated pixel format in incoming frames
     //in order to suppress swscaler warning
-    switch (m_stream->codecpar->format)
+    switch (srcFormat)
     {
     case AV_PIX_FMT_YUVJ420P :
         pixFormat = AV_PIX_FMT_YUV420P;
@@ -142,8 +158,9 @@ void RtspStreamFrameFormatter::updateSWSContext(int dstWidth, int dstHeight)
         break;
     case AV_PIX_FMT_YUVJ440P :
         pixFormat = AV_PIX_FMT_YUV440P;
+        break;
     default:
-        pixFormat = (AVPixelFormat) m_stream->codecpar->format;
+        pixFormat = srcFormat;
         break;
     }
 
@@ -18,6 +18,9 @@
 #ifndef RTSP_STREAM_FRAME_FORMATTER_H
 #define RTSP_STREAM_FRAME_FORMATTER_H
 
+#include "RtspStreamFrameConverter.h"
+#include "RtspStreamFramePool.h"
+
 extern "C" {
 #   include "libavutil/pixfmt.h"
 }
@@ -28,29 +31,36 @@ struct AVStream;
 
 struct SwsContext;
  
+/* Converts decoded frames to BGRA at the requested size. Used on the consuming side,
+ * so only frames that are actually displayed get converted. YUV 4:2:0 frames go
+ * through RtspStreamFrameConverter, anything else through swscale. */
 class RtspStreamFrameFormatter
 {
 public:
-    explicit RtspStreamFrameFormatter(AVStream *stream);
+    RtspStreamFrameFormatter();
     ~RtspStreamFrameFormatter();
 
+    /* Assume that frames of this stream are interlaced even if they are not flagged */
+    static bool shouldTryDeinterlaceStream(AVStream *stream);
+
     void setAutoDeinterlacing(bool autoDeinterlacing);
     RtspStreamFrame * formatFrame(AVFrame *avFrame, int width, int height);
 
+    const RtspStreamFramePool & framePool() const { return m_framePool; }
+
 private:
-    AVStream *m_stream;
     SwsContext *m_sws_context;
     AVPixelFormat m_pixelFormat;
     bool m_autoDeinterlacing;
-    bool m_shouldTryDeinterlaceStream;
     int m_width;
     int m_height;
+    RtspStreamFrameConverter m_converter;
+    RtspStreamFramePool m_framePool;
 
-    bool shouldTryDeinterlaceStream();
     bool shouldTryDeinterlaceFrame(AVFrame *avFrame);
     void deinterlaceFrame(AVFrame *avFrame);
     AVFrame * scaleFrame(AVFrame *avFrame, int width, int height);
-    void updateSWSContext(int dstWidth, int dstHeight);
+    void updateSWSContext(AVPixelFormat srcFormat, int dstWidth, int dstHeight);
 
 };
 
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamFramePool.h"
+#include <QDebug>
+#include <climits>
+
+extern "C" {
+#   include "libavutil/buffer.h"
+#   include "libavutil/mem.h"
+}
+
+/* Enough for 48 streams at full D1 resolution with a full frame queue each */
+static const int defaultMemoryLimitKb = 512 * 1024;
+
+QAtomicInt RtspStreamFramePool::m_memoryLimitKb(defaultMemoryLimitKb);
+QAtomicInt RtspStreamFramePool::m_memoryUsageKb(0);
+QAtomicInt RtspStreamFramePool::m_totalHits(0);
+QAtomicInt RtspStreamFramePool::m_totalMisses(0);
+QAtomicInt RtspStreamFramePool::m_overBudget(0);
+
+RtspStreamFramePool::RtspStreamFramePool()
+    : m_pool(0), m_bufferSize(0), m_hits(0), m_misses(0)
+{
+}
+
+RtspStreamFramePool::~RtspStreamFramePool()
+{
+    /* Buffers still referenced by queued or displayed frames stay valid;
+     * the pool is freed together with the last of them */
+    av_buffer_pool_uninit(&m_pool);
+}
+
+void RtspStreamFramePool::setMemoryLimit(qint64 bytes)
+{
+    m_memoryLimitKb = int(qBound(Q_INT64_C(0), bytes / 1024, qint64(INT_MAX)));
+}
+
+qint64 RtspStreamFramePool::memoryLimit()
+{
+    return qint64(int(m_memoryLimitKb)) * 1024;
+}
+
+qint64 RtspStreamFramePool::memoryUsage()
+{
+    return qint64(int(m_memoryUsageKb)) * 1024;
+}
+
+int RtspStreamFramePool::sizeInKb(int size)
+{
+    return (size + 1023) / 1024;
+}
+
+void RtspStreamFramePool::reset(int size)
+{
+    av_buffer_pool_uninit(&m_pool);
+
+    m_bufferSize = size;
+    m_pool = av_buffer_pool_init2(size, this, allocBuffer, NULL);
+}
+
+AVBufferRef * RtspStreamFramePool::acquire(int size)
+{
+    if (size <= 0)
+        return 0;
+
+    if (!m_pool || size != m_bufferSize)
+        reset(size);
+
+    if (!m_pool)
+        return 0;
+
+    int missesBefore = m_misses;
+    AVBufferRef *buffer = av_buffer_pool_get(m_pool);
+
+    if (buffer && m_misses == missesBefore)
+    {
+        m_hits.ref();
+        m_totalHits.ref();
+    }
+
+    return buffer;
+}
+
+AVBufferRef * RtspStreamFramePool::allocBuffer(void *opaque, int size)
+{
+    RtspStreamFramePool *pool = static_cast<RtspStreamFramePool *>(opaque);
+    pool->m_misses.ref();
+    m_totalMisses.ref();
+
+    int kb = sizeInKb(size);
+    if (m_memoryUsageKb.fetchAndAddOrdered(kb) + kb > m_memoryLimitKb)
+    {
+        m_memoryUsageKb.fetchAndAddOrdered(-kb);
+        if (m_overBudget.testAndSetOrdered(0, 1))
+            qDebug() << "RtspStreamFramePool: memory limit of" << memoryLimit() << "bytes reached, dropping frames";
+        return 0;
+    }
+
+    if (m_overBudget.testAndSetOrdered(1, 0))
+        qDebug() << "RtspStreamFramePool: back within the memory limit";
+
+    uint8_t *data = (uint8_t *) av_malloc(size);
+    if (!data)
+    {
+        m_memoryUsageKb.fetchAndAddOrdered(-kb);
+        return 0;
+    }
+
+    AVBufferRef *buffer = av_buffer_create(data, size, freeBuffer, reinterpret_cast<void *>(quintptr(kb)), 0);
+    if (!buffer)
+    {
+        av_free(data);
+        m_memoryUsageKb.fetchAndAddOrdered(-kb);
+        return 0;
+    }
+
+    return buffer;
+}
+
+void RtspStreamFramePool::freeBuffer(void *opaque, uint8_t *data)
+{
+    m_memoryUsageKb.fetchAndAddOrdered(-int(reinterpret_cast<quintptr>(opaque)));
+    av_free(data);
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_FRAME_POOL_H
+#define RTSP_STREAM_FRAME_POOL_H
+
+#include <QAtomicInt>
+#include <QtGlobal>
+#include <stdint.h>
+
+struct AVBufferPool;
+struct AVBufferRef;
+
+/* Per-stream pool of output frame buffers.
+ *
+ * Buffers of the current size are recycled through an AVBufferPool, so once a stream
+ * has reached its steady state no pixel buffers are allocated anymore. When the
+ * requested size changes (resolution or frame size hint change) the old pool is
+ * released; its buffers are freed as soon as the last frame using them is deleted.
+ *
+ * Memory held by all pools together is limited by a global budget. When the budget
+ * is exhausted, acquire() returns 0 and the frame should be dropped. */
+class RtspStreamFramePool
+{
+    Q_DISABLE_COPY(RtspStreamFramePool)
+
+public:
+    RtspStreamFramePool();
+    ~RtspStreamFramePool();
+
+    /* Returns a reference to a buffer of at least size bytes, or 0 if the global
+     * memory budget does not allow allocating a new one. Can be attached to
+     * AVFrame::buf[0]; unreferencing it returns the buffer to the pool. */
+    AVBufferRef * acquire(int size);
+
+    int hits() const { return m_hits; }
+    int misses() const { return m_misses; }
+
+    /* Global budget in bytes, shared by every stream */
+    static void setMemoryLimit(qint64 bytes);
+    static qint64 memoryLimit();
+    static qint64 memoryUsage();
+
+    static int totalHits() { return m_totalHits; }
+    static int totalMisses() { return m_totalMisses; }
+
+private:
+    AVBufferPool *m_pool;
+    int m_bufferSize;
+    QAtomicInt m_hits;
+    QAtomicInt m_misses;
+
+    /* Accounting is done in KiB to stay within the range of QAtomicInt */
+    static QAtomicInt m_memoryLimitKb;
+    static QAtomicInt m_memoryUsageKb;
+    static QAtomicInt m_totalHits;
+    static QAtomicInt m_totalMisses;
+    /* Set while allocations are refused, so that only changes are logged */
+    static QAtomicInt m_overBudget;
+
+    void reset(int size);
+
+    static AVBufferRef * allocBuffer(void *opaque, int size);
+    static void freeBuffer(void *opaque, uint8_t *data);
+    static int sizeInKb(int size);
+
+};
+
+#endif // RTSP_STREAM_FRAME_POOL_H
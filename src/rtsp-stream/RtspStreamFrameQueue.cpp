@@ -24,81 +24,336 @@ extern "C" {
 #   include "libavutil/mathematics.h"
 }
 
-#define RENDER_TIMER_FPS 30
+/* Frames due this soon are released already */
+static const qint64 earlyTolerance = 2000;
+/* The clock mapping follows the earliest arrivals of each window */
+static const qint64 driftWindow = 2 * AV_TIME_BASE;
+/* A pts step exceeding the arrival step by this much is a discontinuity */
+static const qint64 maxPtsJump = AV_TIME_BASE;
+static const int maxLatencyTarget = 2000;
+/* Queue slots not counted for the latency target: a frame arriving early, and one
+ * enqueued while the consumer holds the pending frame */
+static const int latencyHeadroom = 2;
+/* Frame interval assumed until the timestamps tell; 60 fps underestimates the room in
+ * the queue of slower streams rather than overfilling it */
+static const int defaultFrameInterval = AV_TIME_BASE / 60;
+static const int smoothLatencyTarget = 200;
+/* Backpressure goes up a level when this many frames are dropped within a window,
+ * and down a level after a recovery period without drops */
+static const int backpressureDrops = 3;
+static const qint64 backpressureWindow = AV_TIME_BASE;
+static const qint64 backpressureRecovery = 3 * AV_TIME_BASE;
 
 RtspStreamFrameQueue::RtspStreamFrameQueue(quint16 sizeLimit) :
-        m_frameQueueLock(QMutex::NonRecursive), m_sizeLimit(sizeLimit), m_ptsBase(AV_NOPTS_VALUE)
+        m_sizeLimit(qMax<int>(sizeLimit, 1)), m_readPos(0), m_writePos(0),
+        m_consumerNotified(0), m_depthLimit(m_sizeLimit), m_producedFrames(0), m_displayedFrames(0), m_droppedFrames(0),
+        m_discontinuities(0), m_backpressure(NoBackpressure), m_skippedNonReferenceFrames(0),
+        m_skippedNonKeyframes(0), m_frameInterval(0), m_timeBaseNum(0), m_timeBaseDen(0),
+        m_pressureDrops(0), m_pressureWindowDrops(0), m_pressureWindowStart(0), m_lastDropTime(0),
+        m_lastProducedMediaTime(AV_NOPTS_VALUE),
+        m_latencyProfile(LowestLatency), m_latencyTarget(0), m_pendingFrame(0), m_pendingTime(0),
+        m_clockOffset(AV_NOPTS_VALUE), m_windowOffset(0), m_windowStart(0),
+        m_lastMediaTime(AV_NOPTS_VALUE), m_lastQueueTime(0)
 {
+    m_slots = new QAtomicPointer<RtspStreamFrame>[m_sizeLimit];
+    m_clock.start();
 }
 
 RtspStreamFrameQueue::~RtspStreamFrameQueue()
 {
     clear();
+    delete[] m_slots;
 }
 
-RtspStreamFrame * RtspStreamFrameQueue::dequeue()
+qint64 RtspStreamFrameQueue::clock() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+void RtspStreamFrameQueue::setTimeBase(int num, int den)
+{
+    m_timeBaseNum = num;
+    m_timeBaseDen = den;
+}
+
+void RtspStreamFrameQueue::setLatencyProfile(LatencyProfile profile)
+{
+    m_latencyProfile = profile;
+    setLatencyTarget(profile == Smooth ? smoothLatencyTarget : 0);
+}
+
+void RtspStreamFrameQueue::setLatencyTarget(int msecs)
+{
+    m_latencyTarget = qint64(qBound(0, msecs, maxLatencyTarget)) * 1000;
+}
+
+RtspStreamFrameQueue::Backpressure RtspStreamFrameQueue::updateBackpressure()
+{
+    return updateBackpressure(clock());
+}
+
+RtspStreamFrameQueue::Backpressure RtspStreamFrameQueue::updateBackpressure(qint64 now)
+{
+    int level = m_backpressure;
+
+    int drops = m_droppedFrames;
+    if (drops != m_pressureDrops)
+    {
+        m_pressureWindowDrops += drops - m_pressureDrops;
+        m_pressureDrops = drops;
+        m_lastDropTime = now;
+    }
+
+    /* Waiting for the end of a window gives the last change time to show effect */
+    if (now - m_pressureWindowStart >= backpressureWindow)
+    {
+        if (m_pressureWindowDrops >= backpressureDrops && level < SkipNonKeyframes)
+            ++level;
+
+        m_pressureWindowDrops = 0;
+        m_pressureWindowStart = now;
+    }
+
+    if (level > NoBackpressure && now - m_lastDropTime >= backpressureRecovery)
+    {
+        --level;
+        m_lastDropTime = now;
+    }
+
+    m_backpressure = level;
+    return Backpressure(level);
+}
+
+void RtspStreamFrameQueue::frameSkipped(Backpressure level)
+{
+    if (level == SkipNonReferenceFrames)
+        m_skippedNonReferenceFrames.ref();
+    else if (level == SkipNonKeyframes)
+        m_skippedNonKeyframes.ref();
+}
+
+void RtspStreamFrameQueue::setDepthLimit(int frames)
+{
+    m_depthLimit = qBound(1, frames, m_sizeLimit);
+}
+
+int RtspStreamFrameQueue::size() const
 {
-    QMutexLocker locker(&m_frameQueueLock);
-    if (m_frameQueue.isEmpty())
-        return 0;
+    return m_writePos - m_readPos;
+}
 
-    if (m_ptsBase == (int64_t)AV_NOPTS_VALUE)
+// Can be called from both threads; the thread that advances m_readPos owns the frame
+RtspStreamFrame * RtspStreamFrameQueue::takeFirst()
+{
+    for (;;)
     {
-        m_ptsBase = m_frameQueue.head()->avFrame()->pts;
-        m_ptsTimer.start();
+        int readPos = m_readPos;
+        /* Acquire pairs with the release in enqueue(), so the slot is visible */
+        if (readPos == m_writePos.fetchAndAddAcquire(0))
+            return 0;
+
+        RtspStreamFrame *frame = m_slots[(unsigned)readPos % m_sizeLimit];
+        if (m_readPos.testAndSetOrdered(readPos, readPos + 1))
+            return frame;
     }
+}
 
-    //qint64 now = m_ptsTimer.elapsed() * 1000;
+RtspStreamFrame * RtspStreamFrameQueue::dequeue()
+{
+    return dequeue(clock());
+}
+
+RtspStreamFrame * RtspStreamFrameQueue::dequeue(qint64 now)
+{
+    /* Frames enqueued from now on need a new notification */
+    m_consumerNotified.fetchAndStoreOrdered(0);
 
-    // TODO: needs checking
-    // something is wrong with this code as after few minutes all frames are considered outdated - some calculation is off here
-    RtspStreamFrame *frame = m_frameQueue.dequeue();
-    /*while (!m_frameQueue.isEmpty() && frame)
+    RtspStreamFrame *frame = m_pendingFrame;
+    qint64 time = m_pendingTime;
+    m_pendingFrame = 0;
+
+    if (!frame)
     {
-        qint64 scaledFrameDisplayTime = av_rescale_rnd(frame->avFrame()->pts - m_ptsBase, AV_TIME_BASE, 90000, AV_ROUND_NEAR_INF);
-        if (abs(scaledFrameDisplayTime - now) >= AV_TIME_BASE/2)
+        frame = takeFirst();
+        if (!frame)
+            return 0;
+        time = presentationTime(frame);
+    }
+
+    while (time != (int64_t)AV_NOPTS_VALUE)
+    {
+        if (time - now > earlyTolerance)
         {
-            m_ptsBase = frame->avFrame()->pts;
-            m_ptsTimer.start();
-            now = scaledFrameDisplayTime = 0;
+            m_pendingFrame = frame;
+            m_pendingTime = time;
+            return 0;
         }
 
-        if (now >= scaledFrameDisplayTime || (scaledFrameDisplayTime - now) <= AV_TIME_BASE/(RENDER_TIMER_FPS*2))
+        RtspStreamFrame *next = takeFirst();
+        if (!next)
+            break;
+
+        qint64 nextTime = presentationTime(next);
+        if (nextTime != (int64_t)AV_NOPTS_VALUE && nextTime - now > earlyTolerance)
         {
-            delete frame;
-            frame = m_frameQueue.dequeue();
-        }
-        else
+            m_pendingFrame = next;
+            m_pendingTime = nextTime;
             break;
-    }*/
+        }
 
+        /* Late; a newer frame is due already */
+        delete frame;
+        m_droppedFrames.ref();
+        frame = next;
+        time = nextTime;
+    }
+
+    m_displayedFrames.ref();
     return frame;
 }
 
-void RtspStreamFrameQueue::enqueue(RtspStreamFrame *frame)
+int RtspStreamFrameQueue::msecsToNextFrame() const
 {
-    if (!frame)
+    return msecsToNextFrame(clock());
+}
+
+int RtspStreamFrameQueue::msecsToNextFrame(qint64 now) const
+{
+    if (m_pendingFrame)
+        return int(qMax(m_pendingTime - now + 999, Q_INT64_C(0)) / 1000);
+
+    return size() > 0 ? 0 : -1;
+}
+
+// Only called by the consumer, once for every frame taken from the ring
+qint64 RtspStreamFrameQueue::presentationTime(RtspStreamFrame *frame)
+{
+    qint64 mediaTime = frame->mediaTime();
+    if (mediaTime == (int64_t)AV_NOPTS_VALUE)
+        return AV_NOPTS_VALUE;
+
+    qint64 queueTime = frame->queueTime();
+    qint64 offset = queueTime - mediaTime;
+
+    bool discontinuity = false;
+    if (m_lastMediaTime != (int64_t)AV_NOPTS_VALUE)
+    {
+        /* Stalls delay arrivals but not timestamps; a camera restart or timestamp
+         * wrap-around moves timestamps without a matching delay */
+        qint64 ptsStep = mediaTime - m_lastMediaTime;
+        qint64 arrivalStep = queueTime - m_lastQueueTime;
+        discontinuity = ptsStep < 0 || ptsStep > arrivalStep + maxPtsJump;
+    }
+
+    m_lastMediaTime = mediaTime;
+    m_lastQueueTime = queueTime;
+
+    if (m_clockOffset == (int64_t)AV_NOPTS_VALUE || discontinuity)
+    {
+        if (discontinuity)
+            m_discontinuities.ref();
+
+        m_clockOffset = m_windowOffset = offset;
+        m_windowStart = queueTime;
+    }
+    else
+    {
+        /* Jitter only delays frames, so the earliest arrivals give the offset; moving
+         * halfway towards it every window follows drift without reacting to spikes */
+        m_windowOffset = qMin(m_windowOffset, offset);
+        if (queueTime - m_windowStart >= driftWindow)
+        {
+            m_clockOffset += (m_windowOffset - m_clockOffset) / 2;
+            m_windowOffset = offset;
+            m_windowStart = queueTime;
+        }
+    }
+
+    return mediaTime + m_clockOffset + boundedLatencyTarget();
+}
+
+/* Frames held for the latency target have to fit in the queue, or dropOldFrames()
+ * evicts them before they are due */
+qint64 RtspStreamFrameQueue::boundedLatencyTarget() const
+{
+    int interval = m_frameInterval;
+    if (interval <= 0)
+        interval = defaultFrameInterval;
+
+    qint64 capacity = qint64(qMax(int(m_depthLimit) - latencyHeadroom, 0)) * interval;
+    return qMin(m_latencyTarget, capacity);
+}
+
+// Only called by the producer
+void RtspStreamFrameQueue::updateFrameInterval(qint64 mediaTime)
+{
+    qint64 step = mediaTime - m_lastProducedMediaTime;
+    bool valid = m_lastProducedMediaTime != (int64_t)AV_NOPTS_VALUE && step > 0 && step <= AV_TIME_BASE;
+    m_lastProducedMediaTime = mediaTime;
+    if (!valid)
         return;
 
-    QMutexLocker locker(&m_frameQueueLock);
-    m_frameQueue.enqueue(frame);
+    int interval = m_frameInterval;
+    m_frameInterval = interval > 0 ? int((interval * 7 + step) / 8) : int(step);
+}
+
+bool RtspStreamFrameQueue::enqueue(RtspStreamFrame *frame)
+{
+    return enqueue(frame, clock());
+}
+
+bool RtspStreamFrameQueue::enqueue(RtspStreamFrame *frame, qint64 queueTime)
+{
+    if (!frame)
+        return false;
+
+    qint64 pts = frame->avFrame()->pts;
+    if (pts != (int64_t)AV_NOPTS_VALUE && m_timeBaseNum > 0 && m_timeBaseDen > 0)
+    {
+        AVRational timeBase = { m_timeBaseNum, m_timeBaseDen };
+        AVRational microseconds = { 1, AV_TIME_BASE };
+        frame->setMediaTime(av_rescale_q(pts, timeBase, microseconds));
+        updateFrameInterval(frame->mediaTime());
+    }
+    frame->setQueueTime(queueTime);
 
     dropOldFrames();
+
+    int writePos = m_writePos;
+    m_slots[(unsigned)writePos % m_sizeLimit].fetchAndStoreRelease(frame);
+    m_writePos.fetchAndStoreRelease(writePos + 1);
+
+    m_producedFrames.ref();
+
+    return m_consumerNotified.testAndSetOrdered(0, 1);
 }
 
+// Consumer side, or once the producer is gone
 void RtspStreamFrameQueue::clear()
 {
-    QMutexLocker locker(&m_frameQueueLock);
-    qDeleteAll(m_frameQueue);
-    m_frameQueue.clear();
-}
+    if (m_pendingFrame)
+    {
+        delete m_pendingFrame;
+        m_pendingFrame = 0;
+        m_droppedFrames.ref();
+    }
 
-// Calling this method should be proteced by m_frameQueueLock
+    while (RtspStreamFrame *frame = takeFirst())
+    {
+        delete frame;
+        m_droppedFrames.ref();
+    }
+}
+// Only called by the producer; makes room for one more frame
 void RtspStreamFrameQueue::dropOldFrames()
 {
-    while (m_frameQueue.size() >= 6)
+    while (size() >= m_depthLimit)
     {
-        RtspStreamFrame *frame = m_frameQueue.dequeue();
+        RtspStreamFrame *frame = takeFirst();
+        if (!frame)
+            break;
+
         delete frame;
+        m_droppedFrames.ref();
     }
 }
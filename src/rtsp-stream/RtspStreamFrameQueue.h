@@ -18,35 +18,152 @@
 #ifndef RTSP_STREAM_FRAME_QUEUE_H
 #define RTSP_STREAM_FRAME_QUEUE_H
 
-#include "core/ThreadPause.h"
-#include <QDateTime>
+#include <QAtomicInt>
+#include <QAtomicPointer>
 #include <QElapsedTimer>
-#include <QMutex>
-#include <QObject>
-#include <QQueue>
 
 class RtspStreamFrame;
 
+/* Lock-free frame queue between one decoding thread (producer) and the GUI
+ * thread (consumer), with a jitter buffer on the consumer side.
+ *
+ * At most sizeLimit frames are queued. When the queue is full, the producer evicts
+ * the oldest frame, so the consumer always finds the most recent frames. Both sides
+ * advance the read position with a compare-and-swap; whoever wins owns the frame.
+ * Positions are free-running counters, which rules out ABA issues on the ring slots.
+ *
+ * enqueue() tells the producer when to wake up the consumer: once after every dequeue().
+ * The consumer takes one frame per wake-up and asks msecsToNextFrame() for the rest.
+ *
+ * Frames with a timestamp are released at their presentation time: the pts, mapped
+ * to the local clock by the earliest arrivals seen recently, plus the latency target.
+ * Re-estimating that mapping every few seconds follows clock drift between camera and
+ * client; a pts jump that arrival times do not explain starts a new mapping. Late
+ * frames are skipped when a newer frame is due too. Frames without a timestamp, or
+ * queued before setTimeBase(), are returned in order as soon as they are queued.
+ * The latency target is bounded by what the depth limit holds at the frame rate seen
+ * in the timestamps, so frames are not evicted while they wait.
+ *
+ * Dropped frames were decoded for nothing. updateBackpressure() turns them into a
+ * hint for the decoder: skip non-reference frames first, then everything but
+ * keyframes, and step back once no frames were dropped for a while. */
 class RtspStreamFrameQueue
 {
     Q_DISABLE_COPY(RtspStreamFrameQueue)
 
 public:
+    enum LatencyProfile
+    {
+        /* Frames are shown as soon as they arrive; for PTZ control */
+        LowestLatency,
+        /* Frames are buffered to even out network jitter; for monitoring */
+        Smooth
+    };
+
+    enum Backpressure
+    {
+        NoBackpressure,
+        SkipNonReferenceFrames,
+        SkipNonKeyframes
+    };
+
     RtspStreamFrameQueue(quint16 sizeLimit);
     ~RtspStreamFrameQueue();
 
+    /* Consumer side; caller takes ownership of the returned frame. Returns 0 if no
+     * frame is due yet. */
     RtspStreamFrame * dequeue();
-    void enqueue(RtspStreamFrame *frame);
+    RtspStreamFrame * dequeue(qint64 now);
+    /* Consumer side; -1 if no frame is queued */
+    int msecsToNextFrame() const;
+    int msecsToNextFrame(qint64 now) const;
+    /* Producer side; the queue takes ownership of frame. Returns true if the consumer
+     * has to be notified of the new frame. */
+    bool enqueue(RtspStreamFrame *frame);
+    bool enqueue(RtspStreamFrame *frame, qint64 queueTime);
     void clear();
 
+    /* Producer side, before the first frame; time base of the frame pts */
+    void setTimeBase(int num, int den);
+
+    /* Consumer side; setting a profile resets the latency target to its default */
+    void setLatencyProfile(LatencyProfile profile);
+    LatencyProfile latencyProfile() const { return m_latencyProfile; }
+    void setLatencyTarget(int msecs);
+    /* As set; the target in effect can be lower, see boundedLatencyTarget() */
+    int latencyTarget() const { return int(m_latencyTarget / 1000); }
+
+    /* Producer side, for every packet; now is clock() */
+    Backpressure updateBackpressure();
+    Backpressure updateBackpressure(qint64 now);
+    /* Any thread; the level of the last update */
+    Backpressure backpressure() const { return Backpressure(int(m_backpressure)); }
+    /* Producer side; a frame the decoder left out at the given level */
+    void frameSkipped(Backpressure level);
+
+    /* Clock used for the now and queueTime arguments, in microseconds */
+    qint64 clock() const;
+
+    int sizeLimit() const { return m_sizeLimit; }
+    /* Frames kept before the oldest is evicted, up to sizeLimit; fewer frames bound
+     * the latency when the consumer falls behind */
+    void setDepthLimit(int frames);
+    int depthLimit() const { return m_depthLimit; }
+    int size() const;
+
+    int producedFrames() const { return m_producedFrames; }
+    int displayedFrames() const { return m_displayedFrames; }
+    int droppedFrames() const { return m_droppedFrames; }
+    int discontinuities() const { return m_discontinuities; }
+    int skippedNonReferenceFrames() const { return m_skippedNonReferenceFrames; }
+    int skippedNonKeyframes() const { return m_skippedNonKeyframes; }
+
 private:
-    QMutex m_frameQueueLock;
-    QQueue<RtspStreamFrame *> m_frameQueue;
-    quint16 m_sizeLimit;
-    qint64 m_ptsBase;
-    QElapsedTimer m_ptsTimer;
+    const int m_sizeLimit;
+    QAtomicPointer<RtspStreamFrame> *m_slots;
+    QAtomicInt m_readPos;
+    QAtomicInt m_writePos;
+    QAtomicInt m_consumerNotified;
+    QAtomicInt m_depthLimit;
+
+    QAtomicInt m_producedFrames;
+    QAtomicInt m_displayedFrames;
+    QAtomicInt m_droppedFrames;
+    QAtomicInt m_discontinuities;
+    QAtomicInt m_backpressure;
+    QAtomicInt m_skippedNonReferenceFrames;
+    QAtomicInt m_skippedNonKeyframes;
+    /* Average timestamp step of produced frames in microseconds, 0 if not known yet */
+    QAtomicInt m_frameInterval;
+
+    QElapsedTimer m_clock;
+
+    /* Producer state */
+    int m_timeBaseNum;
+    int m_timeBaseDen;
+    int m_pressureDrops;
+    int m_pressureWindowDrops;
+    qint64 m_pressureWindowStart;
+    qint64 m_lastDropTime;
+    qint64 m_lastProducedMediaTime;
+
+    /* Consumer state; times in microseconds */
+    LatencyProfile m_latencyProfile;
+    qint64 m_latencyTarget;
+    RtspStreamFrame *m_pendingFrame;
+    qint64 m_pendingTime;
+    /* Local clock minus media time for the earliest frames */
+    qint64 m_clockOffset;
+    qint64 m_windowOffset;
+    qint64 m_windowStart;
+    qint64 m_lastMediaTime;
+    qint64 m_lastQueueTime;
 
+    RtspStreamFrame * takeFirst();
     void dropOldFrames();
+    qint64 presentationTime(RtspStreamFrame *frame);
+    qint64 boundedLatencyTarget() const;
+    void updateFrameInterval(qint64 mediaTime);
 
 };
 
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamLatencyMeter.h"
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QVector>
+#include <algorithm>
+
+extern "C" {
+#   include "libavutil/avutil.h"
+}
+
+/* Enough for a few seconds of a full queue and every stage in between */
+static const int maxPendingFrames = 256;
+/* About ten seconds at 30 fps */
+static const int maxSamples = 300;
+
+static QElapsedTimer meterClock;
+static QMutex meterClockMutex;
+
+RtspStreamLatencyMeter::RtspStreamLatencyMeter()
+{
+}
+
+qint64 RtspStreamLatencyMeter::clock()
+{
+    QMutexLocker locker(&meterClockMutex);
+    if (!meterClock.isValid())
+        meterClock.start();
+    return meterClock.nsecsElapsed() / 1000;
+}
+
+void RtspStreamLatencyMeter::mark(Stage stage, qint64 pts)
+{
+    mark(stage, pts, clock());
+}
+
+void RtspStreamLatencyMeter::mark(Stage stage, qint64 pts, qint64 time)
+{
+    if (pts == (int64_t)AV_NOPTS_VALUE || stage < 0 || stage >= StageCount)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+
+    QHash<qint64, Entry>::iterator it = m_pending.find(pts);
+    if (it == m_pending.end())
+    {
+        /* A frame is only followed from the first stage on */
+        if (stage != Received)
+            return;
+
+        Entry entry;
+        for (int i = 0; i < StageCount; ++i)
+            entry.times[i] = -1;
+
+        it = m_pending.insert(pts, entry);
+        m_pendingOrder.append(pts);
+
+        while (m_pendingOrder.size() > maxPendingFrames)
+            m_pending.remove(m_pendingOrder.takeFirst());
+    }
+
+    if (it->times[stage] >= 0)
+        return;
+    it->times[stage] = time;
+
+    if (stage == Painted)
+    {
+        m_samples.append(*it);
+        if (m_samples.size() > maxSamples)
+            m_samples.removeFirst();
+
+        m_pending.erase(it);
+        m_pendingOrder.removeOne(pts);
+    }
+}
+
+RtspStreamLatencyMeter::Percentiles RtspStreamLatencyMeter::percentiles(Stage from, Stage to) const
+{
+    Percentiles result;
+    if (from < 0 || to >= StageCount || from >= to)
+        return result;
+
+    QVector<qint64> latencies;
+    {
+        QMutexLocker locker(&m_mutex);
+        latencies.reserve(m_samples.size());
+        foreach (const Entry &entry, m_samples)
+        {
+            if (entry.times[from] >= 0 && entry.times[to] >= 0)
+                latencies.append(entry.times[to] - entry.times[from]);
+        }
+    }
+
+    if (latencies.isEmpty())
+        return result;
+
+    std::sort(latencies.begin(), latencies.end());
+
+    /* Nearest rank */
+    int count = latencies.size();
+    result.samples = count;
+    result.median = latencies[(count - 1) / 2];
+    result.p90 = latencies[(count * 90 + 99) / 100 - 1];
+    result.p99 = latencies[(count * 99 + 99) / 100 - 1];
+    result.max = latencies[count - 1];
+    return result;
+}
+
+QString RtspStreamLatencyMeter::report() const
+{
+    static const char * const names[StageCount] = { "receive", "decode", "paint" };
+
+    QStringList parts;
+    for (int to = Decoded; to < StageCount; ++to)
+    {
+        for (int from = Received; from < to; ++from)
+        {
+            Percentiles p = percentiles(Stage(from), Stage(to));
+            parts.append(QString::fromLatin1("%1-%2 %3/%4/%5/%6 ms").arg(QLatin1String(names[from]))
+                         .arg(QLatin1String(names[to]))
+                         .arg(p.median / 1000.0, 0, 'f', 1).arg(p.p90 / 1000.0, 0, 'f', 1)
+                         .arg(p.p99 / 1000.0, 0, 'f', 1).arg(p.max / 1000.0, 0, 'f', 1));
+        }
+    }
+
+    return QString::fromLatin1("%1 (median/p90/p99/max of %2 frames)").arg(parts.join(QLatin1String(", ")))
+            .arg(percentiles(Received, Painted).samples);
+}
+
+void RtspStreamLatencyMeter::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_pending.clear();
+    m_pendingOrder.clear();
+    m_samples.clear();
+}
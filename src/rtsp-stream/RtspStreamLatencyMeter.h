@@ -0,0 +1,88 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_LATENCY_METER_H
+#define RTSP_STREAM_LATENCY_METER_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+/* Measures how far behind live view is, for the latency measurement mode.
+ *
+ * Every frame is followed through the pipeline by its pts: when its packet was
+ * received, when it was decoded and when it was first painted. Frames that got to
+ * the screen are kept for the last few seconds; percentiles of the time between any
+ * two stages are computed from them. Frames dropped on the way are forgotten.
+ *
+ * All times come from clock(), which is shared by every thread. mark() can be called
+ * from any thread. */
+class RtspStreamLatencyMeter
+{
+    Q_DISABLE_COPY(RtspStreamLatencyMeter)
+
+public:
+    enum Stage
+    {
+        Received,
+        Decoded,
+        Painted,
+        StageCount
+    };
+
+    /* In microseconds; all 0 without samples */
+    struct Percentiles
+    {
+        int samples;
+        qint64 median;
+        qint64 p90;
+        qint64 p99;
+        qint64 max;
+
+        Percentiles() : samples(0), median(0), p90(0), p99(0), max(0) {}
+    };
+
+    RtspStreamLatencyMeter();
+
+    static qint64 clock();
+
+    /* Only the first mark of a stage counts, e.g. the first of several paints */
+    void mark(Stage stage, qint64 pts);
+    void mark(Stage stage, qint64 pts, qint64 time);
+
+    Percentiles percentiles(Stage from, Stage to) const;
+    /* One line for the log, e.g. "receive-decode 4.0/6.2/9.1/12.5 ms, ..." */
+    QString report() const;
+    void clear();
+
+private:
+    struct Entry
+    {
+        qint64 times[StageCount];
+    };
+
+    mutable QMutex m_mutex;
+    /* Frames that did not get to the screen yet, oldest first */
+    QHash<qint64, Entry> m_pending;
+    QList<qint64> m_pendingOrder;
+    /* Frames that were painted */
+    QList<Entry> m_samples;
+
+};
+
+#endif // RTSP_STREAM_LATENCY_METER_H
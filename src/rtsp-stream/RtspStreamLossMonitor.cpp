@@ -0,0 +1,145 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamLossMonitor.h"
+
+extern "C" {
+#   include "libavutil/avutil.h"
+#   include "libavutil/mathematics.h"
+}
+
+/* The frame interval is re-estimated this often */
+static const int intervalWindowFrames = 64;
+/* Longer gaps are stalls or a camera that only sends on motion, not loss */
+static const qint64 maxLossGap = AV_TIME_BASE;
+
+double RtspStreamLossMonitor::Statistics::lossRate() const
+{
+    int sent = receivedFrames + lostFrames;
+    return sent > 0 ? double(lostFrames) / sent : 0;
+}
+
+double RtspStreamLossMonitor::Statistics::reorderRate() const
+{
+    int sent = receivedFrames + lostFrames;
+    return sent > 0 ? double(reorderedFrames) / sent : 0;
+}
+
+RtspStreamLossMonitor::RtspStreamLossMonitor()
+    : m_timeBaseNum(0), m_timeBaseDen(0), m_reorderedTimestamps(false), m_concealmentWindow(0),
+      m_lastTime(AV_NOPTS_VALUE), m_frameInterval(0), m_windowInterval(0), m_windowFrames(0),
+      m_concealing(false), m_concealStart(0), m_lossPending(0), m_receivedFrames(0),
+      m_lostFrames(0), m_reorderedFrames(0), m_corruptFrames(0), m_concealedFrames(0)
+{
+}
+
+void RtspStreamLossMonitor::setTimeBase(int num, int den)
+{
+    m_timeBaseNum = num;
+    m_timeBaseDen = den;
+}
+
+void RtspStreamLossMonitor::setConcealmentWindow(int msecs)
+{
+    m_concealmentWindow = qMax(msecs, 0);
+}
+
+void RtspStreamLossMonitor::packetReceived(qint64 pts)
+{
+    m_receivedFrames.ref();
+
+    if (m_reorderedTimestamps || pts == (int64_t)AV_NOPTS_VALUE || m_timeBaseNum <= 0 || m_timeBaseDen <= 0)
+        return;
+
+    AVRational timeBase = { m_timeBaseNum, m_timeBaseDen };
+    AVRational microseconds = { 1, AV_TIME_BASE };
+    qint64 time = av_rescale_q(pts, timeBase, microseconds);
+
+    if (m_lastTime == (int64_t)AV_NOPTS_VALUE)
+    {
+        m_lastTime = time;
+        return;
+    }
+
+    qint64 step = time - m_lastTime;
+    if (step <= 0)
+    {
+        /* Came after a newer frame; the newest one stays the reference */
+        if (step < 0 && -step <= maxLossGap)
+            m_reorderedFrames.ref();
+        return;
+    }
+
+    m_lastTime = time;
+
+    if (m_windowInterval <= 0 || step < m_windowInterval)
+        m_windowInterval = step;
+    if (m_frameInterval <= 0 || m_windowInterval < m_frameInterval)
+        m_frameInterval = m_windowInterval;
+    if (++m_windowFrames >= intervalWindowFrames)
+    {
+        m_frameInterval = m_windowInterval;
+        m_windowInterval = 0;
+        m_windowFrames = 0;
+    }
+
+    if (step * 2 > m_frameInterval * 3 && step <= maxLossGap)
+    {
+        int lost = int((step + m_frameInterval / 2) / m_frameInterval) - 1;
+        if (lost > 0)
+        {
+            m_lostFrames.fetchAndAddOrdered(lost);
+            m_lossPending = 1;
+        }
+    }
+}
+
+bool RtspStreamLossMonitor::frameDecoded(bool corrupt, bool keyframe, qint64 now)
+{
+    if (corrupt)
+        m_corruptFrames.ref();
+
+    bool lost = m_lossPending.fetchAndStoreOrdered(0);
+    if ((lost || corrupt) && !m_concealing)
+    {
+        m_concealing = true;
+        m_concealStart = now;
+    }
+
+    if (!m_concealing)
+        return true;
+
+    if ((keyframe && !corrupt) || now - m_concealStart >= m_concealmentWindow)
+    {
+        m_concealing = false;
+        return true;
+    }
+
+    m_concealedFrames.ref();
+    return false;
+}
+
+RtspStreamLossMonitor::Statistics RtspStreamLossMonitor::statistics() const
+{
+    Statistics result;
+    result.receivedFrames = m_receivedFrames;
+    result.lostFrames = m_lostFrames;
+    result.reorderedFrames = m_reorderedFrames;
+    result.corruptFrames = m_corruptFrames;
+    result.concealedFrames = m_concealedFrames;
+    return result;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_LOSS_MONITOR_H
+#define RTSP_STREAM_LOSS_MONITOR_H
+
+#include <QAtomicInt>
+#include <QtGlobal>
+
+/* Packet loss and reordering on a video stream, as seen after depacketizing.
+ *
+ * RTP packets are put back in order by the reorder queue of libavformat, which does
+ * not tell what it did; lost and reordered frames are found from the frame timestamps
+ * instead. A step of more than one and a half frame intervals counts the frames in
+ * between as lost, a step back as reordered. The frame interval is the smallest step
+ * of the last window of frames. Streams with B-frames have out of order timestamps by
+ * design, so only corrupt frames are counted for them.
+ *
+ * After a loss or a frame the decoder reports as corrupt, frames are concealed (not
+ * shown, so the last good one stays on screen) until the next intact keyframe, or at
+ * most for the concealment window; after that, showing frames repaired by the decoder
+ * beats a frozen picture.
+ *
+ * packetReceived() is called by the demuxing thread, frameDecoded() by the decoding
+ * thread; statistics() can be called from any thread. */
+class RtspStreamLossMonitor
+{
+    Q_DISABLE_COPY(RtspStreamLossMonitor)
+
+public:
+    struct Statistics
+    {
+        int receivedFrames;
+        int lostFrames;
+        int reorderedFrames;
+        int corruptFrames;
+        int concealedFrames;
+
+        Statistics()
+            : receivedFrames(0), lostFrames(0), reorderedFrames(0), corruptFrames(0),
+              concealedFrames(0)
+        {
+        }
+
+        /* Both relative to the frames sent, 0 to 1 */
+        double lossRate() const;
+        double reorderRate() const;
+    };
+
+    RtspStreamLossMonitor();
+
+    /* Before the first packet */
+    void setTimeBase(int num, int den);
+    void setReorderedTimestamps(bool reordered) { m_reorderedTimestamps = reordered; }
+    /* 0 shows every frame as decoded */
+    void setConcealmentWindow(int msecs);
+
+    void packetReceived(qint64 pts);
+    /* Returns false if the frame should not be shown; now in milliseconds */
+    bool frameDecoded(bool corrupt, bool keyframe, qint64 now);
+
+    Statistics statistics() const;
+
+private:
+    int m_timeBaseNum;
+    int m_timeBaseDen;
+    bool m_reorderedTimestamps;
+    QAtomicInt m_concealmentWindow;
+
+    /* Demuxing thread; times in microseconds */
+    qint64 m_lastTime;
+    qint64 m_frameInterval;
+    qint64 m_windowInterval;
+    int m_windowFrames;
+
+    /* Decoding thread */
+    bool m_concealing;
+    qint64 m_concealStart;
+
+    QAtomicInt m_lossPending;
+    QAtomicInt m_receivedFrames;
+    QAtomicInt m_lostFrames;
+    QAtomicInt m_reorderedFrames;
+    QAtomicInt m_corruptFrames;
+    QAtomicInt m_concealedFrames;
+
+};
+
+#endif // RTSP_STREAM_LOSS_MONITOR_H
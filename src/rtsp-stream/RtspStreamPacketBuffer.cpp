@@ -0,0 +1,244 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamPacketBuffer.h"
+#include <climits>
+
+extern "C" {
+#   include "libavcodec/avcodec.h"
+#   include "libavutil/mathematics.h"
+}
+
+static const int defaultDuration = 30;
+/* About 30 seconds of 32 cameras at 2 Mbit/s */
+static const int defaultMemoryLimit = 256 * 1024 * 1024;
+
+QAtomicInt RtspStreamPacketBuffer::m_memoryLimit(defaultMemoryLimit);
+QAtomicInt RtspStreamPacketBuffer::m_totalMemoryUsage(0);
+QAtomicInt RtspStreamPacketBuffer::m_activeBuffers(0);
+
+RtspStreamPacketBuffer::RtspStreamPacketBuffer()
+    : m_timeBaseNum(0), m_timeBaseDen(0), m_duration(qint64(defaultDuration) * AV_TIME_BASE),
+      m_memoryUsage(0)
+{
+}
+
+RtspStreamPacketBuffer::~RtspStreamPacketBuffer()
+{
+    clearLocked();
+}
+
+void RtspStreamPacketBuffer::setMemoryLimit(qint64 bytes)
+{
+    m_memoryLimit = int(qBound(Q_INT64_C(0), bytes, qint64(INT_MAX)));
+}
+
+qint64 RtspStreamPacketBuffer::memoryLimit()
+{
+    return int(m_memoryLimit);
+}
+
+qint64 RtspStreamPacketBuffer::totalMemoryUsage()
+{
+    return int(m_totalMemoryUsage);
+}
+
+int RtspStreamPacketBuffer::packetSize(const AVPacket *packet)
+{
+    return packet->size + int(sizeof(AVPacket));
+}
+
+void RtspStreamPacketBuffer::setTimeBase(int num, int den)
+{
+    QMutexLocker locker(&m_mutex);
+
+    clearLocked();
+    m_timeBaseNum = num;
+    m_timeBaseDen = den;
+}
+
+void RtspStreamPacketBuffer::setDuration(int seconds)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_duration = qint64(qMax(seconds, 0)) * AV_TIME_BASE;
+    if (!m_duration)
+        clearLocked();
+}
+
+int RtspStreamPacketBuffer::duration() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(m_duration / AV_TIME_BASE);
+}
+
+qint64 RtspStreamPacketBuffer::packetTime(const AVPacket *packet) const
+{
+    qint64 ts = packet->dts != (int64_t)AV_NOPTS_VALUE ? packet->dts : packet->pts;
+    if (ts == (int64_t)AV_NOPTS_VALUE || m_timeBaseNum <= 0 || m_timeBaseDen <= 0)
+        return AV_NOPTS_VALUE;
+
+    AVRational timeBase = { m_timeBaseNum, m_timeBaseDen };
+    AVRational microseconds = { 1, AV_TIME_BASE };
+    return av_rescale_q(ts, timeBase, microseconds);
+}
+
+void RtspStreamPacketBuffer::append(const AVPacket *packet)
+{
+    QMutexLocker locker(&m_mutex);
+
+    bool keyframe = packet->flags & AV_PKT_FLAG_KEY;
+    if (!m_duration || (m_packets.isEmpty() && !keyframe))
+        return;
+
+    AVPacket *copy = av_packet_alloc();
+    if (!copy || av_packet_ref(copy, packet) < 0)
+    {
+        av_packet_free(&copy);
+        return;
+    }
+
+    m_packets.append(copy);
+    if (m_packets.size() == 1)
+        m_activeBuffers.ref();
+    if (keyframe)
+        m_groupSizes.append(1);
+    else
+        m_groupSizes.last()++;
+
+    int size = packetSize(copy);
+    m_memoryUsage += size;
+    m_totalMemoryUsage.fetchAndAddOrdered(size);
+
+    /* The oldest group goes once the newer ones alone cover the duration */
+    qint64 newestTime = packetTime(copy);
+    while (m_groupSizes.size() > 1 && newestTime != (int64_t)AV_NOPTS_VALUE)
+    {
+        qint64 nextGroupTime = packetTime(m_packets.at(m_groupSizes.first()));
+        if (nextGroupTime == (int64_t)AV_NOPTS_VALUE || newestTime - nextGroupTime < m_duration)
+            break;
+        dropFirstGroup();
+    }
+
+    /* Over the global budget, buffers above an equal share of it give up their oldest
+     * groups. The group in progress is kept, so replay can always start with its keyframe. */
+    while (m_groupSizes.size() > 1 && m_totalMemoryUsage > m_memoryLimit && m_memoryUsage > fairShare())
+        dropFirstGroup();
+}
+
+int RtspStreamPacketBuffer::fairShare()
+{
+    return m_memoryLimit / qMax(int(m_activeBuffers), 1);
+}
+
+void RtspStreamPacketBuffer::dropFirstGroup()
+{
+    if (m_groupSizes.isEmpty())
+        return;
+
+    int count = m_groupSizes.takeFirst();
+    for (int i = 0; i < count; ++i)
+    {
+        AVPacket *packet = m_packets.takeFirst();
+        int size = packetSize(packet);
+        m_memoryUsage -= size;
+        m_totalMemoryUsage.fetchAndAddOrdered(-size);
+        av_packet_free(&packet);
+    }
+
+    if (m_packets.isEmpty())
+        m_activeBuffers.deref();
+}
+
+QList<AVPacket *> RtspStreamPacketBuffer::packets(int seconds) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QList<AVPacket *> result;
+    if (m_packets.isEmpty())
+        return result;
+
+    /* Latest keyframe that still covers the requested time */
+    qint64 newestTime = packetTime(m_packets.last());
+    qint64 startTime = newestTime - qint64(seconds) * AV_TIME_BASE;
+    int start = 0;
+    int groupStart = 0;
+    foreach (int groupSize, m_groupSizes)
+    {
+        qint64 time = packetTime(m_packets.at(groupStart));
+        if (newestTime == (int64_t)AV_NOPTS_VALUE || time == (int64_t)AV_NOPTS_VALUE || time > startTime)
+            break;
+        start = groupStart;
+        groupStart += groupSize;
+    }
+
+    for (int i = start; i < m_packets.size(); ++i)
+    {
+        AVPacket *packet = av_packet_alloc();
+        if (!packet || av_packet_ref(packet, m_packets.at(i)) < 0)
+        {
+            av_packet_free(&packet);
+            break;
+        }
+        result.append(packet);
+    }
+
+    return result;
+}
+
+void RtspStreamPacketBuffer::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    clearLocked();
+}
+
+void RtspStreamPacketBuffer::clearLocked()
+{
+    while (!m_groupSizes.isEmpty())
+        dropFirstGroup();
+}
+
+qint64 RtspStreamPacketBuffer::bufferedTime() const
+{
+    if (m_packets.isEmpty())
+        return 0;
+
+    qint64 first = packetTime(m_packets.first());
+    qint64 last = packetTime(m_packets.last());
+    if (first == (int64_t)AV_NOPTS_VALUE || last == (int64_t)AV_NOPTS_VALUE)
+        return 0;
+
+    return last - first;
+}
+
+int RtspStreamPacketBuffer::bufferedMsecs() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(bufferedTime() / 1000);
+}
+
+int RtspStreamPacketBuffer::packetCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_packets.size();
+}
+
+int RtspStreamPacketBuffer::memoryUsage() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_memoryUsage;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_PACKET_BUFFER_H
+#define RTSP_STREAM_PACKET_BUFFER_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QtGlobal>
+
+struct AVPacket;
+
+/* Ring of the most recent compressed video packets of one stream, for instant replay.
+ *
+ * The buffer always starts with a keyframe and is trimmed one group of pictures at a
+ * time, once the newer ones cover the configured duration. Memory held by all buffers
+ * together is limited by a global budget. Once it is exceeded, buffers holding more
+ * than an equal share of it give up their oldest groups of pictures as they append, so
+ * a stream that just started is not emptied by the others. The group in progress is
+ * never dropped. Packets are referenced, not copied. */
+class RtspStreamPacketBuffer
+{
+    Q_DISABLE_COPY(RtspStreamPacketBuffer)
+
+public:
+    RtspStreamPacketBuffer();
+    ~RtspStreamPacketBuffer();
+
+    /* Time base of the packet timestamps; clears the buffer */
+    void setTimeBase(int num, int den);
+    /* Seconds to keep; 0 disables buffering */
+    void setDuration(int seconds);
+    int duration() const;
+
+    /* Packets before the first keyframe are ignored */
+    void append(const AVPacket *packet);
+    /* New references to the packets covering at least the last seconds, or all of them
+     * if fewer are buffered, starting with a keyframe. Free them with av_packet_free(). */
+    QList<AVPacket *> packets(int seconds) const;
+    void clear();
+
+    /* Decoding timestamp in microseconds, AV_NOPTS_VALUE if unknown */
+    qint64 packetTime(const AVPacket *packet) const;
+
+    int bufferedMsecs() const;
+    int packetCount() const;
+    int memoryUsage() const;
+
+    /* Global budget in bytes, shared by every stream */
+    static void setMemoryLimit(qint64 bytes);
+    static qint64 memoryLimit();
+    static qint64 totalMemoryUsage();
+
+private:
+    mutable QMutex m_mutex;
+    QList<AVPacket *> m_packets;
+    /* Number of packets of each group of pictures, oldest first */
+    QList<int> m_groupSizes;
+    int m_timeBaseNum;
+    int m_timeBaseDen;
+    qint64 m_duration;
+    int m_memoryUsage;
+
+    static QAtomicInt m_memoryLimit;
+    static QAtomicInt m_totalMemoryUsage;
+    /* Buffers holding packets, which share the budget */
+    static QAtomicInt m_activeBuffers;
+
+    qint64 bufferedTime() const;
+    void dropFirstGroup();
+    void clearLocked();
+    static int packetSize(const AVPacket *packet);
+    static int fairShare();
+
+};
+
+#endif // RTSP_STREAM_PACKET_BUFFER_H
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamProbeCache.h"
+#include <QDebug>
+#include <QUrl>
+#include <string.h>
+
+extern "C" {
+#   include "libavcodec/avcodec.h"
+#   include "libavformat/avformat.h"
+}
+
+RtspStreamProbeCache * RtspStreamProbeCache::instance()
+{
+    static RtspStreamProbeCache *cache = 0;
+    static QMutex instanceMutex;
+
+    QMutexLocker locker(&instanceMutex);
+    if (!cache)
+        cache = new RtspStreamProbeCache;
+
+    return cache;
+}
+
+RtspStreamProbeCache::RtspStreamProbeCache()
+{
+}
+
+RtspStreamProbeCache::~RtspStreamProbeCache()
+{
+    for (QHash<QString, QList<AVCodecParameters *> >::iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+        freeEntry(*it);
+}
+
+void RtspStreamProbeCache::freeEntry(QList<AVCodecParameters *> &entry)
+{
+    for (int i = 0; i < entry.size(); ++i)
+        avcodec_parameters_free(&entry[i]);
+    entry.clear();
+}
+
+void RtspStreamProbeCache::store(const QUrl &url, AVFormatContext *context)
+{
+    QList<AVCodecParameters *> entry;
+    for (unsigned int i = 0; i < context->nb_streams; ++i)
+    {
+        AVCodecParameters *parameters = avcodec_parameters_alloc();
+        if (!parameters || avcodec_parameters_copy(parameters, context->streams[i]->codecpar) < 0)
+        {
+            avcodec_parameters_free(&parameters);
+            freeEntry(entry);
+            return;
+        }
+
+        entry.append(parameters);
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    QList<AVCodecParameters *> &current = m_entries[url.toString()];
+    freeEntry(current);
+    current = entry;
+}
+
+bool RtspStreamProbeCache::matches(const AVCodecParameters *cached, const AVCodecParameters *described)
+{
+    if (cached->codec_type != described->codec_type || cached->codec_id != described->codec_id)
+        return false;
+
+    /* Only compare what the server described; with RTSP that is usually the codec and,
+     * for H.264, the parameter sets */
+    if (described->width && described->width != cached->width)
+        return false;
+    if (described->height && described->height != cached->height)
+        return false;
+
+    if (described->extradata_size &&
+        (described->extradata_size != cached->extradata_size ||
+         memcmp(described->extradata, cached->extradata, described->extradata_size)))
+        return false;
+
+    return true;
+}
+
+bool RtspStreamProbeCache::apply(const QUrl &url, AVFormatContext *context)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QHash<QString, QList<AVCodecParameters *> >::iterator it = m_entries.find(url.toString());
+    if (it == m_entries.end())
+        return false;
+
+    bool match = it->size() == int(context->nb_streams);
+    for (int i = 0; match && i < it->size(); ++i)
+        match = matches(it->at(i), context->streams[i]->codecpar);
+
+    if (!match)
+    {
+        qDebug() << "RtspStreamProbeCache: stream layout changed, probing again";
+        freeEntry(*it);
+        m_entries.erase(it);
+        return false;
+    }
+
+    for (int i = 0; i < it->size(); ++i)
+    {
+        if (avcodec_parameters_copy(context->streams[i]->codecpar, it->at(i)) < 0)
+            return false;
+    }
+
+    return true;
+}
+
+void RtspStreamProbeCache::remove(const QUrl &url)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QHash<QString, QList<AVCodecParameters *> >::iterator it = m_entries.find(url.toString());
+    if (it == m_entries.end())
+        return;
+
+    freeEntry(*it);
+    m_entries.erase(it);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_PROBE_CACHE_H
+#define RTSP_STREAM_PROBE_CACHE_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+struct AVCodecParameters;
+struct AVFormatContext;
+class QUrl;
+
+/* Remembers the stream layout and codec parameters (including extradata) of the last
+ * successful session of every stream URL.
+ *
+ * avformat_find_stream_info() has to read and decode packets until it knows every
+ * stream, which is most of the time spent connecting. On a reconnect the cached
+ * parameters are used instead, unless what the server describes no longer matches
+ * them; then the entry is dropped and the stream is probed again. */
+class RtspStreamProbeCache
+{
+    Q_DISABLE_COPY(RtspStreamProbeCache)
+
+public:
+    static RtspStreamProbeCache * instance();
+
+    RtspStreamProbeCache();
+    ~RtspStreamProbeCache();
+
+    /* Copies the parameters of every stream of context */
+    void store(const QUrl &url, AVFormatContext *context);
+    /* Fills the streams of an opened context from the cache. Returns false if there is
+     * no entry or it does not match, in which case the stream has to be probed. */
+    bool apply(const QUrl &url, AVFormatContext *context);
+    void remove(const QUrl &url);
+
+private:
+    QMutex m_mutex;
+    QHash<QString, QList<AVCodecParameters *> > m_entries;
+
+    static bool matches(const AVCodecParameters *cached, const AVCodecParameters *described);
+    static void freeEntry(QList<AVCodecParameters *> &entry);
+
+};
+
+#endif // RTSP_STREAM_PROBE_CACHE_H
@@ -0,0 +1,259 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamReconnectScheduler.h"
+#include "core/LiveStream.h"
+#include <QDebug>
+#include <QList>
+#include <QtAlgorithms>
+
+static const int minimumDelay = 1000;
+static const int maximumDelay = 60000;
+static const int maxConnectingPerServer = 4;
+
+RtspStreamReconnectScheduler * RtspStreamReconnectScheduler::instance()
+{
+    static RtspStreamReconnectScheduler *scheduler = 0;
+    if (!scheduler)
+        scheduler = new RtspStreamReconnectScheduler;
+
+    return scheduler;
+}
+
+RtspStreamReconnectScheduler::RtspStreamReconnectScheduler(QObject *parent)
+    : QObject(parent)
+{
+    m_timer.setSingleShot(true);
+    connect(&m_timer, SIGNAL(timeout()), SLOT(startDueStreams()));
+    m_clock.start();
+}
+
+int RtspStreamReconnectScheduler::backoffDelay(int attempt)
+{
+    qint64 delay = minimumDelay;
+    for (int i = 1; i < attempt && delay < maximumDelay; ++i)
+        delay *= 2;
+
+    return int(qMin(delay, qint64(maximumDelay)));
+}
+
+RtspStreamReconnectScheduler::StreamEntry & RtspStreamReconnectScheduler::entry(LiveStream *stream, QObject *server)
+{
+    QHash<LiveStream *, StreamEntry>::iterator it = m_streams.find(stream);
+    if (it == m_streams.end())
+    {
+        StreamEntry entry;
+        entry.server = server;
+        entry.failedAttempts = 0;
+        entry.connecting = false;
+        entry.waiting = false;
+        entry.dueTime = 0;
+        it = m_streams.insert(stream, entry);
+    }
+
+    if (server && !m_connectingCount.contains(server))
+    {
+        m_connectingCount.insert(server, 0);
+        connect(server, SIGNAL(onlineChanged(bool)), SLOT(serverOnlineChanged(bool)));
+        connect(server, SIGNAL(destroyed(QObject*)), SLOT(serverDestroyed(QObject*)));
+    }
+
+    return *it;
+}
+
+void RtspStreamReconnectScheduler::connecting(LiveStream *stream, QObject *server)
+{
+    StreamEntry &streamEntry = entry(stream, server);
+    streamEntry.server = server;
+    streamEntry.waiting = false;
+    if (!streamEntry.connecting)
+    {
+        streamEntry.connecting = true;
+        if (server)
+            m_connectingCount[server]++;
+    }
+}
+
+void RtspStreamReconnectScheduler::queueStart(LiveStream *stream, QObject *server)
+{
+    StreamEntry &streamEntry = entry(stream, server);
+    if (streamEntry.connecting)
+        return;
+
+    streamEntry.server = server;
+    streamEntry.waiting = true;
+    streamEntry.dueTime = m_clock.elapsed();
+    scheduleNext();
+}
+
+void RtspStreamReconnectScheduler::finishAttempt(StreamEntry &entry)
+{
+    if (!entry.connecting)
+        return;
+
+    entry.connecting = false;
+    if (entry.server)
+        m_connectingCount[entry.server]--;
+}
+
+void RtspStreamReconnectScheduler::connected(LiveStream *stream)
+{
+    QHash<LiveStream *, StreamEntry>::iterator it = m_streams.find(stream);
+    if (it == m_streams.end())
+        return;
+
+    it->failedAttempts = 0;
+    finishAttempt(*it);
+
+    /* A free slot may let a waiting stream of the same server start */
+    scheduleNext();
+}
+
+void RtspStreamReconnectScheduler::failed(LiveStream *stream)
+{
+    QHash<LiveStream *, StreamEntry>::iterator it = m_streams.find(stream);
+    if (it == m_streams.end())
+        return;
+
+    it->failedAttempts++;
+
+    /* Random delay between half and all of the backoff delay */
+    int delay = backoffDelay(it->failedAttempts);
+    delay = delay / 2 + qrand() % (delay / 2 + 1);
+
+    it->waiting = true;
+    it->dueTime = m_clock.elapsed() + delay;
+    finishAttempt(*it);
+    scheduleNext();
+}
+
+void RtspStreamReconnectScheduler::remove(LiveStream *stream)
+{
+    QHash<LiveStream *, StreamEntry>::iterator it = m_streams.find(stream);
+    if (it == m_streams.end())
+        return;
+
+    finishAttempt(*it);
+    m_streams.erase(it);
+    scheduleNext();
+}
+
+void RtspStreamReconnectScheduler::serverOnlineChanged(bool online)
+{
+    if (!online)
+        return;
+
+    QObject *server = sender();
+    qint64 now = m_clock.elapsed();
+    for (QHash<LiveStream *, StreamEntry>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+    {
+        if (it->server != server || !it->waiting)
+            continue;
+
+        it->failedAttempts = 0;
+        it->dueTime = now;
+    }
+
+    scheduleNext();
+}
+
+void RtspStreamReconnectScheduler::serverDestroyed(QObject *server)
+{
+    m_connectingCount.remove(server);
+    for (QHash<LiveStream *, StreamEntry>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+    {
+        if (it->server == server)
+            it->server = 0;
+    }
+}
+
+namespace
+{
+
+struct DueStream
+{
+    LiveStream *stream;
+    qint64 dueTime;
+
+    bool operator<(const DueStream &other) const { return dueTime < other.dueTime; }
+};
+
+}
+
+void RtspStreamReconnectScheduler::startDueStreams()
+{
+    qint64 now = m_clock.elapsed();
+
+    QList<DueStream> due;
+    for (QHash<LiveStream *, StreamEntry>::const_iterator it = m_streams.constBegin(); it != m_streams.constEnd(); ++it)
+    {
+        if (it->waiting && it->dueTime <= now)
+        {
+            DueStream stream = { it.key(), it->dueTime };
+            due.append(stream);
+        }
+    }
+
+    qSort(due);
+
+    /* Streams that were due longest go first; the rest waits for a free slot */
+    QHash<QObject *, int> connectingCount = m_connectingCount;
+    QList<LiveStream *> starting;
+    foreach (const DueStream &stream, due)
+    {
+        StreamEntry &entry = m_streams[stream.stream];
+        if (entry.server && connectingCount.value(entry.server) >= maxConnectingPerServer)
+            continue;
+
+        if (entry.server)
+            connectingCount[entry.server]++;
+        entry.waiting = false;
+        starting.append(stream.stream);
+    }
+
+    /* start() reports back through connecting(), which changes m_streams */
+    foreach (LiveStream *stream, starting)
+    {
+        if (!m_streams.contains(stream))
+            continue;
+        if (stream->state() == LiveStream::Error || stream->state() == LiveStream::NotConnected)
+            stream->start();
+    }
+
+    scheduleNext();
+}
+
+void RtspStreamReconnectScheduler::scheduleNext()
+{
+    qint64 now = m_clock.elapsed();
+    qint64 next = -1;
+
+    for (QHash<LiveStream *, StreamEntry>::const_iterator it = m_streams.constBegin(); it != m_streams.constEnd(); ++it)
+    {
+        if (!it->waiting)
+            continue;
+        if (it->server && m_connectingCount.value(it->server) >= maxConnectingPerServer)
+            continue;
+        if (next < 0 || it->dueTime < next)
+            next = it->dueTime;
+    }
+
+    if (next < 0)
+        m_timer.stop();
+    else
+        m_timer.start(int(qMax(next - now, qint64(0))));
+}
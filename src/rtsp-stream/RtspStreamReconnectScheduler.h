@@ -0,0 +1,88 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_RECONNECT_SCHEDULER_H
+#define RTSP_STREAM_RECONNECT_SCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QTimer>
+
+class LiveStream;
+
+/* Decides when failed live streams try to connect again.
+ *
+ * Each stream waits with exponential backoff and random jitter after every failed
+ * attempt, so streams that failed together do not retry together. No more than a few
+ * attempts per server are in progress at any time; streams that are due while the
+ * limit is reached wait for a running attempt to finish. When a server comes back
+ * online, its streams retry right away (still subject to the limit).
+ *
+ * Streams report every attempt with connecting() and its outcome with connected() or
+ * failed(); retries are started by calling LiveStream::start(). Streams that would
+ * start on their own, e.g. because their camera came online, use queueStart() so they
+ * count against the same limit. Lives on the GUI thread. */
+class RtspStreamReconnectScheduler : public QObject
+{
+    Q_OBJECT
+
+    friend class RtspStreamReconnectSchedulerTestCase;
+
+public:
+    static RtspStreamReconnectScheduler * instance();
+
+    explicit RtspStreamReconnectScheduler(QObject *parent = 0);
+
+    void connecting(LiveStream *stream, QObject *server);
+    void connected(LiveStream *stream);
+    void failed(LiveStream *stream);
+    /* Start the stream as soon as the limit of its server allows */
+    void queueStart(LiveStream *stream, QObject *server);
+    /* Forget the stream, e.g. when it is stopped or deleted */
+    void remove(LiveStream *stream);
+
+    /* Delay before retrying after attempt failures in a row, without jitter */
+    static int backoffDelay(int attempt);
+
+private slots:
+    void startDueStreams();
+    void serverOnlineChanged(bool online);
+    void serverDestroyed(QObject *server);
+
+private:
+    struct StreamEntry
+    {
+        QObject *server;
+        int failedAttempts;
+        bool connecting;
+        bool waiting;
+        qint64 dueTime;
+    };
+
+    QHash<LiveStream *, StreamEntry> m_streams;
+    QHash<QObject *, int> m_connectingCount;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+
+    StreamEntry & entry(LiveStream *stream, QObject *server);
+    void finishAttempt(StreamEntry &entry);
+    void scheduleNext();
+
+};
+
+#endif // RTSP_STREAM_RECONNECT_SCHEDULER_H
@@ -0,0 +1,291 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamRecorder.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+
+extern "C" {
+#   include "libavcodec/avcodec.h"
+#   include "libavformat/avformat.h"
+#   include "libavutil/mathematics.h"
+}
+
+static QString errorMessageFromCode(int errorCode)
+{
+    char error[512];
+    av_strerror(errorCode, error, sizeof(error));
+    return QString::fromLatin1(error);
+}
+
+RtspStreamRecorder::RtspStreamRecorder(const QString &fileName, AVFormatContext *input, int videoStreamIndex, int audioStreamIndex)
+    : m_fileName(fileName), m_videoOutputIndex(-1), m_queuedBytes(0), m_stopRequested(false),
+      m_failed(false), m_waitForKeyframe(false), m_droppedPackets(0)
+{
+    int inputIndexes[] = { videoStreamIndex, audioStreamIndex };
+    for (int i = 0; i < 2; ++i)
+    {
+        int inputIndex = inputIndexes[i];
+        if (inputIndex < 0 || inputIndex >= int(input->nb_streams))
+            continue;
+
+        AVStream *inputStream = input->streams[inputIndex];
+        OutputStream stream;
+        stream.inputIndex = inputIndex;
+        stream.parameters = avcodec_parameters_alloc();
+        stream.timeBaseNum = inputStream->time_base.num;
+        stream.timeBaseDen = inputStream->time_base.den;
+        if (!stream.parameters || avcodec_parameters_copy(stream.parameters, inputStream->codecpar) < 0)
+        {
+            avcodec_parameters_free(&stream.parameters);
+            continue;
+        }
+
+        if (inputIndex == videoStreamIndex)
+        {
+            m_videoOutputIndex = m_streams.size();
+            /* Nothing is written before the first keyframe */
+            m_waitForKeyframe = true;
+        }
+        m_streams.append(stream);
+    }
+
+    /* Created on a worker thread without an event loop; deleteLater() needs one */
+    moveToThread(QCoreApplication::instance()->thread());
+    connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));
+}
+
+RtspStreamRecorder::~RtspStreamRecorder()
+{
+    wait();
+    freePackets();
+
+    for (int i = 0; i < m_streams.size(); ++i)
+        avcodec_parameters_free(&m_streams[i].parameters);
+}
+
+int RtspStreamRecorder::outputIndex(int inputIndex) const
+{
+    for (int i = 0; i < m_streams.size(); ++i)
+    {
+        if (m_streams.at(i).inputIndex == inputIndex)
+            return i;
+    }
+
+    return -1;
+}
+
+void RtspStreamRecorder::write(const AVPacket *packet)
+{
+    int index = outputIndex(packet->stream_index);
+    if (index < 0)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+
+    if (m_failed || m_stopRequested)
+        return;
+
+    if (m_waitForKeyframe)
+    {
+        if (index != m_videoOutputIndex || !(packet->flags & AV_PKT_FLAG_KEY))
+            return;
+        m_waitForKeyframe = false;
+    }
+
+    /* The disk does not keep up; skip to the next keyframe rather than block reading */
+    if (m_packets.size() >= maxQueuedPackets || m_queuedBytes + packet->size > maxQueuedBytes)
+    {
+        m_droppedPackets.ref();
+        m_waitForKeyframe = m_videoOutputIndex >= 0;
+        return;
+    }
+
+    AVPacket *copy = av_packet_alloc();
+    if (!copy || av_packet_ref(copy, packet) < 0)
+    {
+        av_packet_free(&copy);
+        return;
+    }
+
+    copy->stream_index = index;
+    m_packets.enqueue(copy);
+    m_queuedBytes += copy->size;
+    m_packetsAvailable.wakeOne();
+}
+
+void RtspStreamRecorder::stop()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_stopRequested = true;
+    m_packetsAvailable.wakeAll();
+}
+
+void RtspStreamRecorder::run()
+{
+    QByteArray fileName = QFile::encodeName(m_fileName);
+    AVFormatContext *output = 0;
+
+    int ret = avformat_alloc_output_context2(&output, NULL, NULL, fileName.constData());
+    if (ret < 0 || !output)
+    {
+        fail(tr("Unsupported file type"));
+    }
+    else
+    {
+        bool streamsAdded = true;
+        QList<int> muxerIndexes;
+        for (int i = 0; i < m_streams.size(); ++i)
+        {
+            const OutputStream &stream = m_streams.at(i);
+            if (i != m_videoOutputIndex &&
+                avformat_query_codec(output->oformat, stream.parameters->codec_id, FF_COMPLIANCE_NORMAL) == 0)
+            {
+                qDebug() << "RtspStreamRecorder: leaving out audio not supported by" << output->oformat->name;
+                muxerIndexes.append(-1);
+                continue;
+            }
+
+            muxerIndexes.append(output->nb_streams);
+            AVStream *outputStream = avformat_new_stream(output, NULL);
+            if (!outputStream || avcodec_parameters_copy(outputStream->codecpar, stream.parameters) < 0)
+            {
+                streamsAdded = false;
+                break;
+            }
+
+            /* Tags of the RTSP demuxer don't necessarily fit the container */
+            outputStream->codecpar->codec_tag = 0;
+            outputStream->time_base.num = stream.timeBaseNum;
+            outputStream->time_base.den = stream.timeBaseDen;
+        }
+
+        bool headerWritten = false;
+        if (!streamsAdded)
+            fail(tr("Streams can't be stored in this file type"));
+        else if ((ret = avio_open(&output->pb, fileName.constData(), AVIO_FLAG_WRITE)) < 0)
+            fail(errorMessageFromCode(ret));
+        else if ((ret = avformat_write_header(output, NULL)) < 0)
+            fail(errorMessageFromCode(ret));
+        else
+            headerWritten = true;
+
+        if (headerWritten)
+        {
+            writePackets(output, muxerIndexes);
+            av_write_trailer(output);
+        }
+
+        avio_closep(&output->pb);
+        avformat_free_context(output);
+    }
+
+    /* The worker may still write until it stops the recorder */
+    QMutexLocker locker(&m_mutex);
+    while (!m_stopRequested)
+        m_packetsAvailable.wait(&m_mutex);
+
+    qDebug() << "RtspStreamRecorder: finished" << m_fileName << "dropped packets:" << int(m_droppedPackets);
+}
+
+bool RtspStreamRecorder::writePackets(AVFormatContext *output, const QList<int> &muxerIndexes)
+{
+    AVRational microseconds = { 1, AV_TIME_BASE };
+    qint64 startTime = AV_NOPTS_VALUE;
+
+    for (;;)
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_packets.isEmpty() && !m_stopRequested)
+            m_packetsAvailable.wait(&m_mutex);
+
+        /* Stopped, and everything queued before is written */
+        if (m_packets.isEmpty())
+            return true;
+
+        AVPacket *packet = m_packets.dequeue();
+        m_queuedBytes -= packet->size;
+        locker.unlock();
+
+        const OutputStream &stream = m_streams.at(packet->stream_index);
+        packet->stream_index = muxerIndexes.at(packet->stream_index);
+        if (packet->stream_index < 0)
+        {
+            av_packet_free(&packet);
+            continue;
+        }
+
+        AVRational timeBase = { stream.timeBaseNum, stream.timeBaseDen };
+
+        /* The file starts at 0 with the first keyframe */
+        qint64 ts = packet->dts != (int64_t)AV_NOPTS_VALUE ? packet->dts : packet->pts;
+        if (startTime == (int64_t)AV_NOPTS_VALUE && ts != (int64_t)AV_NOPTS_VALUE)
+            startTime = av_rescale_q(ts, timeBase, microseconds);
+
+        if (startTime != (int64_t)AV_NOPTS_VALUE)
+        {
+            qint64 offset = av_rescale_q(startTime, microseconds, timeBase);
+            if (packet->pts != (int64_t)AV_NOPTS_VALUE)
+                packet->pts -= offset;
+            if (packet->dts != (int64_t)AV_NOPTS_VALUE)
+                packet->dts -= offset;
+        }
+
+        /* Audio from before the first keyframe */
+        if (packet->dts != (int64_t)AV_NOPTS_VALUE && packet->dts < 0)
+        {
+            av_packet_free(&packet);
+            continue;
+        }
+
+        av_packet_rescale_ts(packet, timeBase, output->streams[packet->stream_index]->time_base);
+        packet->pos = -1;
+
+        int ret = av_interleaved_write_frame(output, packet);
+        av_packet_free(&packet);
+
+        if (ret < 0)
+        {
+            fail(errorMessageFromCode(ret));
+            return false;
+        }
+    }
+}
+
+void RtspStreamRecorder::fail(const QString &message)
+{
+    QMutexLocker locker(&m_mutex);
+    m_failed = true;
+    freePackets();
+    locker.unlock();
+
+    qWarning() << "RtspStreamRecorder: recording to" << m_fileName << "failed:" << message;
+    emit failed(message);
+}
+
+// Called with m_mutex locked, or once the thread is done
+void RtspStreamRecorder::freePackets()
+{
+    while (!m_packets.isEmpty())
+    {
+        AVPacket *packet = m_packets.dequeue();
+        av_packet_free(&packet);
+    }
+    m_queuedBytes = 0;
+}
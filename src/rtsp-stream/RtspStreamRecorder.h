@@ -0,0 +1,99 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_RECORDER_H
+#define RTSP_STREAM_RECORDER_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+
+struct AVCodecParameters;
+struct AVFormatContext;
+struct AVPacket;
+
+/* Writes the compressed packets of a live stream to a local file, without transcoding.
+ *
+ * The container follows the file name extension (.mkv or .mp4). write() only queues
+ * a reference to the packet; muxing and disk I/O happen on the recorder's own thread.
+ * When the bounded queue is full, packets are dropped instead of waiting for the disk,
+ * and video resumes with the next keyframe. Audio the container can't store is left
+ * out.
+ *
+ * The recorder deletes itself once stopped and done writing; don't touch it after
+ * calling stop(). */
+class RtspStreamRecorder : public QThread
+{
+    Q_OBJECT
+
+public:
+    /* Takes the parameters of the video and audio streams (-1 if none) of input */
+    RtspStreamRecorder(const QString &fileName, AVFormatContext *input, int videoStreamIndex, int audioStreamIndex);
+    virtual ~RtspStreamRecorder();
+
+    QString fileName() const { return m_fileName; }
+
+    /* Never blocks; packets of other streams are ignored */
+    void write(const AVPacket *packet);
+    /* Writes what is queued, closes the file and deletes the recorder */
+    void stop();
+
+    int droppedPackets() const { return m_droppedPackets; }
+
+signals:
+    void failed(const QString &message);
+
+protected:
+    virtual void run();
+
+private:
+    struct OutputStream
+    {
+        int inputIndex;
+        AVCodecParameters *parameters;
+        int timeBaseNum;
+        int timeBaseDen;
+    };
+
+    static const int maxQueuedPackets = 2000;
+    static const int maxQueuedBytes = 64 * 1024 * 1024;
+
+    const QString m_fileName;
+    QList<OutputStream> m_streams;
+    int m_videoOutputIndex;
+
+    QMutex m_mutex;
+    QWaitCondition m_packetsAvailable;
+    QQueue<AVPacket *> m_packets;
+    int m_queuedBytes;
+    bool m_stopRequested;
+    bool m_failed;
+    bool m_waitForKeyframe;
+    QAtomicInt m_droppedPackets;
+
+    int outputIndex(int inputIndex) const;
+    bool writePackets(AVFormatContext *output, const QList<int> &muxerIndexes);
+    void fail(const QString &message);
+    void freePackets();
+
+};
+
+#endif // RTSP_STREAM_RECORDER_H
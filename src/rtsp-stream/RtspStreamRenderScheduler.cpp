@@ -0,0 +1,117 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamRenderScheduler.h"
+#include "RtspStream.h"
+#include "core/BluecherryApp.h"
+#include <QSettings>
+
+static const int defaultRefreshRate = 60;
+
+RtspStreamRenderScheduler * RtspStreamRenderScheduler::instance()
+{
+    static RtspStreamRenderScheduler *scheduler = 0;
+    if (!scheduler)
+        scheduler = new RtspStreamRenderScheduler;
+
+    return scheduler;
+}
+
+RtspStreamRenderScheduler::RtspStreamRenderScheduler(QObject *parent)
+    : QObject(parent), m_lastPass(-1), m_refreshRate(defaultRefreshRate)
+{
+    m_clock.start();
+    m_timer.setSingleShot(true);
+    connect(&m_timer, SIGNAL(timeout()), SLOT(updateStreams()));
+
+    updateSettings();
+    connect(bcApp, SIGNAL(settingsChanged()), SLOT(updateSettings()));
+}
+
+void RtspStreamRenderScheduler::updateSettings()
+{
+    QSettings settings;
+    m_refreshRate = qBound(1, settings.value(QLatin1String("ui/liveview/displayRefreshRate"), defaultRefreshRate).toInt(), 240);
+}
+
+void RtspStreamRenderScheduler::schedule(RtspStream *stream, int delayMsecs)
+{
+    qint64 time = m_clock.elapsed() + qMax(delayMsecs, 0);
+
+    QHash<RtspStream *, qint64>::iterator it = m_scheduledStreams.find(stream);
+    if (it == m_scheduledStreams.end())
+        m_scheduledStreams.insert(stream, time);
+    else if (time < it.value())
+        it.value() = time;
+    else
+        return;
+
+    startTimer();
+}
+
+void RtspStreamRenderScheduler::remove(RtspStream *stream)
+{
+    m_scheduledStreams.remove(stream);
+}
+
+void RtspStreamRenderScheduler::startTimer()
+{
+    if (m_scheduledStreams.isEmpty())
+    {
+        m_timer.stop();
+        return;
+    }
+
+    qint64 next = -1;
+    foreach (qint64 time, m_scheduledStreams)
+    {
+        if (next < 0 || time < next)
+            next = time;
+    }
+
+    /* Never more than one pass per refresh */
+    if (m_lastPass >= 0)
+        next = qMax(next, m_lastPass + 1000 / m_refreshRate);
+
+    m_timer.start(int(qMax(next - m_clock.elapsed(), Q_INT64_C(0))));
+}
+
+void RtspStreamRenderScheduler::updateStreams()
+{
+    qint64 now = m_clock.elapsed();
+    m_lastPass = now;
+
+    /* Streams due before the middle of the next refresh interval are updated now, the
+     * others stay scheduled. Streams with more frames to show schedule themselves again. */
+    qint64 limit = now + 1000 / m_refreshRate / 2;
+    QList<RtspStream *> streams;
+    for (QHash<RtspStream *, qint64>::iterator it = m_scheduledStreams.begin(); it != m_scheduledStreams.end();)
+    {
+        if (it.value() <= limit)
+        {
+            streams.append(it.key());
+            it = m_scheduledStreams.erase(it);
+        }
+        else
+            ++it;
+    }
+
+    foreach (RtspStream *stream, streams)
+        stream->updateFrame();
+
+    startTimer();
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_RENDER_SCHEDULER_H
+#define RTSP_STREAM_RENDER_SCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QTimer>
+
+class RtspStream;
+
+/* Coalesces new frame notifications of all live streams into one update pass per
+ * display refresh.
+ *
+ * Streams call schedule() when their decoder has a new frame. The next pass starts
+ * no sooner than one refresh interval after the previous one and only updates the
+ * streams that were scheduled, so streams are shown at up to the display refresh rate
+ * and nothing runs while no frames arrive. Streams holding back a frame for later
+ * schedule themselves with a delay and are updated in the first pass after it.
+ *
+ * Qt does not tell the actual refresh rate; it defaults to 60 Hz and can be changed
+ * with ui/liveview/displayRefreshRate. Lives on the GUI thread. */
+class RtspStreamRenderScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    static RtspStreamRenderScheduler * instance();
+
+    explicit RtspStreamRenderScheduler(QObject *parent = 0);
+
+    int refreshRate() const { return m_refreshRate; }
+
+    void schedule(RtspStream *stream, int delayMsecs = 0);
+    void remove(RtspStream *stream);
+
+private slots:
+    void updateStreams();
+    void updateSettings();
+
+private:
+    /* Earliest update time of each scheduled stream, on m_clock */
+    QHash<RtspStream *, qint64> m_scheduledStreams;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    qint64 m_lastPass;
+    int m_refreshRate;
+
+    void startTimer();
+
+};
+
+#endif // RTSP_STREAM_RENDER_SCHEDULER_H
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RtspStreamStatistics.h"
+#include <climits>
+
+/* Timings older than one to two windows are forgotten */
+static const int defaultWindowLength = 10000;
+
+RtspStreamStatistics::Snapshot::Snapshot()
+{
+    for (int i = 0; i < CounterCount; ++i)
+        counters[i] = 0;
+}
+
+RtspStreamStatistics::RtspStreamStatistics()
+{
+    for (int i = 0; i < WindowCount; ++i)
+        m_windows[i] = -1;
+    m_clock.start();
+}
+
+int RtspStreamStatistics::windowLength()
+{
+    return defaultWindowLength;
+}
+
+int RtspStreamStatistics::bucket(int usecs)
+{
+    int n = 0;
+    while (usecs > 0 && n < BucketCount - 1)
+    {
+        usecs >>= 1;
+        ++n;
+    }
+    return n;
+}
+
+void RtspStreamStatistics::record(Timing timing, qint64 usecs)
+{
+    record(timing, usecs, clock());
+}
+
+void RtspStreamStatistics::record(Timing timing, qint64 usecs, qint64 now)
+{
+    if (timing < 0 || timing >= TimingCount)
+        return;
+
+    /* The first sample of a new window takes over the set of the oldest one. Samples
+     * other threads record into that set meanwhile may be lost, which is fine for
+     * display; so is dropping a sample of a window that is over already. */
+    int window = int(now / windowLength());
+    int index = window % WindowCount;
+    int held = m_windows[index];
+    if (held > window)
+        return;
+    if (held < window && m_windows[index].testAndSetOrdered(held, window))
+        clearWindow(index);
+
+    int value = int(qBound(Q_INT64_C(0), usecs, qint64(INT_MAX)));
+    m_buckets[index][timing][bucket(value)].ref();
+
+    for (;;)
+    {
+        int max = m_max[index][timing];
+        if (value <= max || m_max[index][timing].testAndSetOrdered(max, value))
+            break;
+    }
+}
+
+void RtspStreamStatistics::clearWindow(int index)
+{
+    for (int i = 0; i < TimingCount; ++i)
+    {
+        for (int j = 0; j < BucketCount; ++j)
+            m_buckets[index][i][j] = 0;
+        m_max[index][i] = 0;
+    }
+}
+
+void RtspStreamStatistics::increment(Counter counter)
+{
+    if (counter >= 0 && counter < CounterCount)
+        m_counters[counter].ref();
+}
+
+RtspStreamStatistics::Percentiles RtspStreamStatistics::percentiles(Timing timing) const
+{
+    return percentiles(timing, clock());
+}
+
+RtspStreamStatistics::Percentiles RtspStreamStatistics::percentiles(Timing timing, qint64 now) const
+{
+    Percentiles result;
+    if (timing < 0 || timing >= TimingCount)
+        return result;
+
+    /* Not a consistent snapshot while recording goes on, which is fine for display */
+    int window = int(now / windowLength());
+    int counts[BucketCount] = { 0 };
+    int total = 0;
+    int max = 0;
+    for (int w = 0; w < WindowCount; ++w)
+    {
+        int held = m_windows[w];
+        if (held < 0 || held > window || held <= window - WindowCount)
+            continue;
+
+        for (int i = 0; i < BucketCount; ++i)
+        {
+            int count = m_buckets[w][timing][i];
+            counts[i] += count;
+            total += count;
+        }
+        max = qMax(max, int(m_max[w][timing]));
+    }
+
+    if (!total)
+        return result;
+
+    result.samples = total;
+    result.max = max;
+
+    /* Nearest rank, like RtspStreamLatencyMeter */
+    const int ranks[3] = { (total + 1) / 2, (total * 90 + 99) / 100, (total * 99 + 99) / 100 };
+    qint64 *values[3] = { &result.median, &result.p90, &result.p99 };
+
+    int seen = 0;
+    int next = 0;
+    for (int i = 0; i < BucketCount && next < 3; ++i)
+    {
+        seen += counts[i];
+        while (next < 3 && seen >= ranks[next])
+        {
+            qint64 upperBound = (Q_INT64_C(1) << i) - 1;
+            *values[next++] = qMin(upperBound, result.max);
+        }
+    }
+
+    return result;
+}
+
+int RtspStreamStatistics::counter(Counter counter) const
+{
+    if (counter < 0 || counter >= CounterCount)
+        return 0;
+    return m_counters[counter];
+}
+
+RtspStreamStatistics::Snapshot RtspStreamStatistics::snapshot() const
+{
+    Snapshot result;
+    qint64 now = clock();
+    for (int i = 0; i < TimingCount; ++i)
+        result.timings[i] = percentiles(Timing(i), now);
+    for (int i = 0; i < CounterCount; ++i)
+        result.counters[i] = counter(Counter(i));
+    return result;
+}
+
+void RtspStreamStatistics::clear()
+{
+    for (int i = 0; i < WindowCount; ++i)
+    {
+        clearWindow(i);
+        m_windows[i] = -1;
+    }
+
+    for (int i = 0; i < CounterCount; ++i)
+        m_counters[i] = 0;
+}
+
+const char * RtspStreamStatistics::timingName(Timing timing)
+{
+    static const char * const names[TimingCount] = { "readWait", "decode", "convert", "queueResidency", "paint" };
+
+    if (timing < 0 || timing >= TimingCount)
+        return "";
+    return names[timing];
+}
+
+const char * RtspStreamStatistics::counterName(Counter counter)
+{
+    static const char * const names[CounterCount] = { "decodeErrors", "convertFailures" };
+
+    if (counter < 0 || counter >= CounterCount)
+        return "";
+    return names[counter];
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTSP_STREAM_STATISTICS_H
+#define RTSP_STREAM_STATISTICS_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QtGlobal>
+
+/* Timings and counters of the decoding pipeline of one connection, for the
+ * diagnostics window.
+ *
+ * Every timing goes into a histogram with power of two buckets in microseconds.
+ * Recording is a single atomic increment, cheap enough for every packet and frame,
+ * and can be done from any thread: reading happens on the worker thread, decoding
+ * and conversion on thread pools, painting on the GUI thread. Percentiles are only
+ * as precise as the buckets; they report the upper bound of the bucket, but never
+ * more than the maximum seen.
+ *
+ * Timings cover the last one to two windows of windowLength() ms, so saturation
+ * shows up even late in a long connection. Counters cover the whole connection. */
+class RtspStreamStatistics
+{
+    Q_DISABLE_COPY(RtspStreamStatistics)
+
+public:
+    enum Timing
+    {
+        /* Time spent waiting in av_read_frame() for the next packet */
+        ReadWait,
+        Decode,
+        /* Scaling and conversion of a frame for display */
+        Convert,
+        /* Time a decoded frame spent in the frame queue */
+        QueueResidency,
+        Paint,
+        TimingCount
+    };
+
+    enum Counter
+    {
+        DecodeErrors,
+        ConvertFailures,
+        CounterCount
+    };
+
+    /* In microseconds; all 0 without samples */
+    struct Percentiles
+    {
+        int samples;
+        qint64 median;
+        qint64 p90;
+        qint64 p99;
+        qint64 max;
+
+        Percentiles() : samples(0), median(0), p90(0), p99(0), max(0) {}
+    };
+
+    struct Snapshot
+    {
+        Percentiles timings[TimingCount];
+        int counters[CounterCount];
+
+        Snapshot();
+    };
+
+    RtspStreamStatistics();
+
+    void record(Timing timing, qint64 usecs);
+    void record(Timing timing, qint64 usecs, qint64 now);
+    void increment(Counter counter);
+
+    Percentiles percentiles(Timing timing) const;
+    Percentiles percentiles(Timing timing, qint64 now) const;
+    int counter(Counter counter) const;
+    Snapshot snapshot() const;
+    void clear();
+
+    /* Clock used for the now arguments, in milliseconds */
+    qint64 clock() const { return m_clock.elapsed(); }
+    static int windowLength();
+
+    /* Stable names for machine-readable output, e.g. "readWait" */
+    static const char * timingName(Timing timing);
+    static const char * counterName(Counter counter);
+
+private:
+    /* Bucket n holds values below 2^n, down to 2^(n-1) */
+    enum { BucketCount = 32 };
+    /* The window being recorded and the one before */
+    enum { WindowCount = 2 };
+
+    QAtomicInt m_buckets[WindowCount][TimingCount][BucketCount];
+    QAtomicInt m_max[WindowCount][TimingCount];
+    /* Number of the window each set of histograms holds, -1 if none */
+    QAtomicInt m_windows[WindowCount];
+    QAtomicInt m_counters[CounterCount];
+    QElapsedTimer m_clock;
+
+    static int bucket(int usecs);
+    void clearWindow(int index);
+
+};
+
+#endif // RTSP_STREAM_STATISTICS_H
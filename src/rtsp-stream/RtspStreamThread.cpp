@@ -17,6 +17,7 @@
 
 #include "RtspStreamThread.h"
 #include "RtspStreamWorker.h"
+#include "RtspStreamFrame.h"
 #include "RtspStreamFrameQueue.h"
 #include "core/BluecherryApp.h"
 #include "core/LoggableUrl.h"
@@ -41,7 +42,7 @@ void RtspStreamThread::clearWorker()
     m_worker.clear();
 }
 
-void RtspStreamThread::start(const QUrl &url, bool hwaccelerated)
+void RtspStreamThread::start(const QUrl &url, bool hwaccelerated, bool udpTransport, bool lowLatency)
 {
     QMutexLocker locker(&m_workerMutex);
 
@@ -58,11 +59,22 @@ void RtspStreamThread::start(const QUrl &url, bool hwaccelerated)
         worker->moveToThread(m_thread.data());
 
         m_worker.data()->setUrl(url);
+        m_worker.data()->setUdpTransport(udpTransport);
+        m_worker.data()->setLowLatency(lowLatency);
+        m_lossMonitor = worker->lossMonitor();
+        m_latencyMeter = worker->latencyMeter();
+        m_statistics = worker->statistics();
 
         connect(m_thread.data(), SIGNAL(started()), m_worker.data(), SLOT(run()));
         connect(m_thread.data(), SIGNAL(finished()), m_thread.data(), SLOT(deleteLater()));
         connect(m_worker.data(), SIGNAL(fatalError(QString)), this, SIGNAL(fatalError(QString)));
         connect(m_worker.data(), SIGNAL(hwAccelDisabled()), this, SIGNAL(hwAccelDisabled()));
+        connect(m_worker.data(), SIGNAL(udpTransportFailed()), this, SIGNAL(udpTransportFailed()));
+        connect(m_worker.data(), SIGNAL(frameAvailable()), this, SIGNAL(frameAvailable()));
+        connect(m_worker.data(), SIGNAL(replayStarted()), this, SIGNAL(replayStarted()));
+        connect(m_worker.data(), SIGNAL(replayFinished()), this, SIGNAL(replayFinished()));
+        connect(m_worker.data(), SIGNAL(recordingFailed(QString)), this, SIGNAL(recordingFailed(QString)));
+        connect(m_worker.data(), SIGNAL(connected(RtspStreamConnectTimings)), this, SIGNAL(connected(RtspStreamConnectTimings)));
         connect(m_worker.data(), SIGNAL(destroyed()), this, SLOT(clearWorker()), Qt::DirectConnection);
         connect(m_worker.data(), SIGNAL(destroyed()), m_thread.data(), SLOT(quit()));
         connect(m_worker.data(), SIGNAL(audioFormat(enum AVSampleFormat, int, int)), this, SIGNAL(audioFormat(enum AVSampleFormat,int,int)), Qt::DirectConnection);
@@ -94,6 +106,38 @@ void RtspStreamThread::setFrameSizeHint(int width, int height)
         m_worker.data()->setFrameSizeHint(width, height);
 }
 
+void RtspStreamThread::setKeyframesOnly(bool keyframesOnly)
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (hasWorker())
+        m_worker.data()->setKeyframesOnly(keyframesOnly);
+}
+
+void RtspStreamThread::setReplayBufferDuration(int seconds)
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (hasWorker())
+        m_worker.data()->setReplayBufferDuration(seconds);
+}
+
+void RtspStreamThread::replay(int seconds)
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (hasWorker())
+        m_worker.data()->replay(seconds);
+}
+
+void RtspStreamThread::setRecordingFile(const QString &fileName)
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (hasWorker())
+        m_worker.data()->setRecordingFile(fileName);
+}
+
 void RtspStreamThread::stop()
 {
     QMutexLocker locker(&m_workerMutex);
@@ -106,6 +150,9 @@ void RtspStreamThread::stop()
         m_worker.data()->stop();
         m_worker.clear();
         m_frameQueue.clear();
+        m_lossMonitor.clear();
+        m_latencyMeter.clear();
+        m_statistics.clear();
         m_thread.clear();
     }
 
@@ -132,20 +179,152 @@ bool RtspStreamThread::isRunning() const
     return m_isRunning;
 }
 
-void RtspStreamThread::setAutoDeinterlacing(bool autoDeinterlacing)
+RtspStreamFrame * RtspStreamThread::frameToDisplay()
 {
     QMutexLocker locker(&m_workerMutex);
 
-    if (hasWorker())
-        m_worker.data()->setAutoDeinterlacing(autoDeinterlacing);
+    if (!m_frameQueue)
+        return 0;
+
+    RtspStreamFrame *frame = m_frameQueue->dequeue();
+    if (frame && m_statistics)
+        m_statistics->record(RtspStreamStatistics::QueueResidency, m_frameQueue->clock() - frame->queueTime());
+
+    return frame;
 }
 
-RtspStreamFrame * RtspStreamThread::frameToDisplay()
+int RtspStreamThread::msecsToNextFrame()
 {
     QMutexLocker locker(&m_workerMutex);
 
-    if (m_frameQueue)
-        return m_frameQueue->dequeue();
-    else
+    if (!m_frameQueue)
+        return -1;
+
+    return m_frameQueue->msecsToNextFrame();
+}
+
+int RtspStreamThread::skippedNonReferenceFrames()
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (!m_frameQueue)
+        return 0;
+
+    return m_frameQueue->skippedNonReferenceFrames();
+}
+
+int RtspStreamThread::skippedNonKeyframes()
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (!m_frameQueue)
         return 0;
+
+    return m_frameQueue->skippedNonKeyframes();
+}
+
+RtspStreamFrameQueue::Backpressure RtspStreamThread::backpressure()
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (!m_frameQueue)
+        return RtspStreamFrameQueue::NoBackpressure;
+
+    return m_frameQueue->backpressure();
+}
+
+int RtspStreamThread::producedFrames()
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (!m_frameQueue)
+        return 0;
+
+    return m_frameQueue->producedFrames();
+}
+
+int RtspStreamThread::displayedFrames()
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (!m_frameQueue)
+        return 0;
+
+    return m_frameQueue->displayedFrames();
+}
+
+int RtspStreamThread::droppedFrames()
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (!m_frameQueue)
+        return 0;
+
+    return m_frameQueue->droppedFrames();
+}
+
+RtspStreamLossMonitor::Statistics RtspStreamThread::transportStatistics()
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (!m_lossMonitor)
+        return RtspStreamLossMonitor::Statistics();
+
+    return m_lossMonitor->statistics();
+}
+
+void RtspStreamThread::framePainted(qint64 pts)
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (m_latencyMeter)
+        m_latencyMeter->mark(RtspStreamLatencyMeter::Painted, pts);
+}
+
+QString RtspStreamThread::latencyReport()
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (!m_latencyMeter)
+        return QString();
+
+    return m_latencyMeter->report();
+}
+
+void RtspStreamThread::recordTiming(RtspStreamStatistics::Timing timing, qint64 usecs)
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (m_statistics)
+        m_statistics->record(timing, usecs);
+}
+
+void RtspStreamThread::increment(RtspStreamStatistics::Counter counter)
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (m_statistics)
+        m_statistics->increment(counter);
+}
+
+RtspStreamStatistics::Snapshot RtspStreamThread::pipelineStatistics()
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (!m_statistics)
+        return RtspStreamStatistics::Snapshot();
+
+    return m_statistics->snapshot();
+}
+
+void RtspStreamThread::setLatencyProfile(RtspStreamFrameQueue::LatencyProfile profile, int latencyTarget)
+{
+    QMutexLocker locker(&m_workerMutex);
+
+    if (!m_frameQueue)
+        return;
+
+    m_frameQueue->setLatencyProfile(profile);
+    if (latencyTarget >= 0)
+        m_frameQueue->setLatencyTarget(latencyTarget);
 }
@@ -21,12 +21,17 @@
 #include <QMutex>
 #include <QObject>
 #include <QWeakPointer>
+#include <QScopedPointer>
 #include <QSharedPointer>
 #include "audio/AudioPlayer.h"
+#include "RtspStreamConnectTimings.h"
+#include "RtspStreamFrameQueue.h"
+#include "RtspStreamLatencyMeter.h"
+#include "RtspStreamLossMonitor.h"
+#include "RtspStreamStatistics.h"
 
 class RtspStreamFrame;
 class RtspStreamWorker;
-class RtspStreamFrameQueue;
 class QThread;
 class QUrl;
 
@@ -38,7 +43,7 @@ public:
     explicit RtspStreamThread(QObject *parent = 0);
     virtual ~RtspStreamThread();
 
-    void start(const QUrl &url, bool hwaccelerated);
+    void start(const QUrl &url, bool hwaccelerated, bool udpTransport = false, bool lowLatency = false);
     void stop();
     void setPaused(bool paused);
 
@@ -46,9 +51,32 @@ public:
     bool hasWorker();
     void enableAudio(bool enabled);
 
-    void setAutoDeinterlacing(bool autoDeinterlacing);
+    /* Decoded frame to show next; conversion is left to the caller */
     RtspStreamFrame * frameToDisplay();
+    /* -1 if no frame is waiting to be shown */
+    int msecsToNextFrame();
+    void setLatencyProfile(RtspStreamFrameQueue::LatencyProfile profile, int latencyTarget = -1);
+    /* Frames the decoder left out since connecting, because the consumer fell behind */
+    int skippedNonReferenceFrames();
+    int skippedNonKeyframes();
+    RtspStreamFrameQueue::Backpressure backpressure();
+    int producedFrames();
+    int displayedFrames();
+    int droppedFrames();
+    RtspStreamLossMonitor::Statistics transportStatistics();
+    /* Latency measurement mode only, see RtspStreamLatencyMeter */
+    void framePainted(qint64 pts);
+    QString latencyReport();
+    /* Pipeline timings of the current connection; reading, decoding and queue
+     * residency are recorded here, the rest by the caller */
+    void recordTiming(RtspStreamStatistics::Timing timing, qint64 usecs);
+    void increment(RtspStreamStatistics::Counter counter);
+    RtspStreamStatistics::Snapshot pipelineStatistics();
     void setFrameSizeHint(int width, int height);
+    void setKeyframesOnly(bool keyframesOnly);
+    void setReplayBufferDuration(int seconds);
+    void replay(int seconds);
+    void setRecordingFile(const QString &fileName);
 
 signals:
     void fatalError(const QString &error);
@@ -56,11 +84,20 @@ signals:
     void audioFormat(enum AVSampleFormat fmt, int channelsNum, int sampleRate);
     void audioSamplesAvailable(void *data, int samplesNum, int bytesNum);
     void hwAccelDisabled();
+    void udpTransportFailed();
+    void frameAvailable();
+    void replayStarted();
+    void replayFinished();
+    void recordingFailed(const QString &message);
+    void connected(const RtspStreamConnectTimings &timings);
 
 private:
     QWeakPointer<QThread> m_thread;
     QWeakPointer<RtspStreamWorker> m_worker;
     QSharedPointer<RtspStreamFrameQueue> m_frameQueue;
+    QSharedPointer<RtspStreamLossMonitor> m_lossMonitor;
+    QSharedPointer<RtspStreamLatencyMeter> m_latencyMeter;
+    QSharedPointer<RtspStreamStatistics> m_statistics;
     QMutex m_workerMutex;
     bool m_isRunning;
 
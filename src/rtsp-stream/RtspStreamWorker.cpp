@@ -16,13 +16,22 @@
  */
 
 #include "RtspStreamWorker.h"
+#include "RtspStreamDecoderThreadBudget.h"
 #include "RtspStreamFrame.h"
 #include "RtspStreamFrameFormatter.h"
 #include "RtspStreamFrameQueue.h"
+#include "RtspStreamLatencyMeter.h"
+#include "RtspStreamLossMonitor.h"
+#include "RtspStreamPacketBuffer.h"
+#include "RtspStreamProbeCache.h"
+#include "RtspStreamRecorder.h"
+#include "RtspStreamStatistics.h"
 #include "core/BluecherryApp.h"
+#include "core/LiveStream.h"
 #include <QDebug>
 #include <QCoreApplication>
 #include <QThread>
+#include <climits>
 #include "core/VaapiHWAccel.h"
 extern "C"
 {
@@ -35,6 +44,23 @@ extern "C"
 #define ASSERT_WORKER_THREAD() Q_ASSERT(QThread::currentThread() == thread())
 
 static const int maxDecodeErrors = 3;
+/* Enough to hold the smooth latency target at 60 fps; longer targets are bounded by
+ * what fits, see RtspStreamFrameQueue */
+static const quint16 frameQueueDepth = 16;
+/* The frame being shown and the next one */
+static const int lowLatencyFrameQueueDepth = 2;
+/* Decoder load is reported this often; the decoder is reopened with a new thread
+ * count at most this often */
+static const int decodeLoadInterval = 2000;
+static const int decoderThreadsInterval = 10000;
+/* UDP that is blocked on the way shows as a stream without packets; give up on it
+ * sooner than on a silent TCP connection */
+static const int udpFirstPacketTimeout = 5;
+/* RTP packets wait this long for missing ones before those are given up */
+static const int udpReorderDelayMs = 100;
+static const int udpReorderQueueSize = 64;
+static const int udpReceiveBufferSize = 2 * 1024 * 1024;
+static const int udpConcealmentWindow = 500;
 
 int rtspStreamInterruptCallback(void *opaque)
 {
@@ -45,23 +71,42 @@ int rtspStreamInterruptCallback(void *opaque)
 RtspStreamWorker::RtspStreamWorker(QSharedPointer<RtspStreamFrameQueue> &shared_queue, bool hwaccelerated, QObject *parent)
     : QObject(parent), m_ctx(0),
       m_videoCodecCtx(0), m_audioCodecCtx(0),
-      m_frame(0), m_decodeErrorsCnt(0),
+      m_frame(0), m_videoFrame(0), m_decodeErrorsCnt(0), m_decodeFailed(false),
       m_videoStreamIndex(-1), m_audioStreamIndex(-1),
       m_audioEnabled(false),
-      m_hwaccelEnabled(hwaccelerated),
-      m_frameWidthHint(-1), m_frameHeightHint(-1),
-      m_cancelFlag(false), m_autoDeinterlacing(true),
-      m_frameQueue(new RtspStreamFrameQueue(6))
+      m_hwaccelEnabled(hwaccelerated), m_udpTransport(false), m_lowLatency(false),
+      m_keyframesOnly(false), m_skipUntilKeyframe(false),
+      m_frameWidthHint(-1), m_frameHeightHint(-1), m_decodePriority(INT_MAX),
+      m_decoderThreads(1), m_decodeNsecs(0), m_firstFrameDecoded(0),
+      m_cancelFlag(false), m_shouldTryDeinterlace(false),
+      m_frameQueue(new RtspStreamFrameQueue(frameQueueDepth)),
+      m_packetBuffer(new RtspStreamPacketBuffer), m_lossMonitor(new RtspStreamLossMonitor),
+      m_latencyMeter(LiveStream::isLatencyMeasurementEnabled() ? new RtspStreamLatencyMeter : 0),
+      m_statistics(new RtspStreamStatistics),
+      m_replayRequest(0), m_replayStartTime(0),
+      m_recorder(0), m_recordingFileChanged(0)
 {
     shared_queue = m_frameQueue;
 }
 
 RtspStreamWorker::~RtspStreamWorker()
 {
+    /* Decoding threads must be done with the codec before it is closed */
+    RtspStreamDecodeScheduler::instance()->removeStream(this);
+    RtspStreamDecoderThreadBudget::instance()->removeStream(this);
+
+    foreach (AVPacket *packet, m_replayPackets)
+        av_packet_free(&packet);
+
+    /* Finishes the file on its own thread */
+    if (m_recorder)
+        m_recorder->stop();
+
     if (!m_ctx)
         return;
 
     av_frame_free(&m_frame);
+    av_frame_free(&m_videoFrame);
 
     avcodec_close(m_videoCodecCtx);
     avcodec_close(m_audioCodecCtx);
@@ -78,13 +123,6 @@ void RtspStreamWorker::setUrl(const QUrl &url)
     m_url = url;
 }
 
-void RtspStreamWorker::setAutoDeinterlacing(bool autoDeinterlacing)
-{
-    m_autoDeinterlacing = autoDeinterlacing;
-    if (m_frameFormatter)
-        m_frameFormatter->setAutoDeinterlacing(autoDeinterlacing);
-}
-
 bool RtspStreamWorker::shouldInterrupt() const
 {
     if (m_cancelFlag)
@@ -107,6 +145,9 @@ void RtspStreamWorker::run()
     if (setup())
         processStreamLoop();
 
+    if (m_udpTransport && !m_cancelFlag && !m_firstFrameDecoded)
+        emit udpTransportFailed();
+
     deleteLater();
 }
 
@@ -139,8 +180,11 @@ AVPacket RtspStreamWorker::readPacket(bool *ok)
         *ok = true;
 
     AVPacket packet;
-    startInterruptableOperation(30);
+    startInterruptableOperation(m_udpTransport && m_connectTimings.firstPacket < 0 ? udpFirstPacketTimeout : 30);
+    QElapsedTimer readTimer;
+    readTimer.start();
     int re = av_read_frame(m_ctx, &packet);
+    m_statistics->record(RtspStreamStatistics::ReadWait, readTimer.nsecsElapsed() / 1000);
     if (0 == re)
         return packet;
 
@@ -156,6 +200,11 @@ bool RtspStreamWorker::processPacket(struct AVPacket packet)
 {
     emit bytesDownloaded(packet.size);
 
+    if (m_recordingFileChanged.fetchAndStoreOrdered(0))
+        updateRecorder();
+    if (m_recorder)
+        m_recorder->write(&packet);
+
     while (packet.size > 0)
     {
         if (packet.stream_index == m_audioStreamIndex)
@@ -179,13 +228,50 @@ bool RtspStreamWorker::processPacket(struct AVPacket packet)
 
         if (packet.stream_index == m_videoStreamIndex)
         {
-            AVFrame *frame = extractVideoFrame(packet);
+            if (m_decodeFailed)
+                return false;
 
-            if (frame)
-                processVideoFrame(frame);
+            m_packetBuffer->append(&packet);
+            m_lossMonitor->packetReceived(packet.pts);
+            if (m_latencyMeter)
+                m_latencyMeter->mark(RtspStreamLatencyMeter::Received, packet.pts);
+
+            int replaySeconds = m_replayRequest.fetchAndStoreOrdered(0);
+            if (replaySeconds > 0)
+                startReplay(replaySeconds);
+
+            /* Live video is only buffered while a replay is shown */
+            if (processReplay())
+                break;
+
+            /* In keyframes only mode, other frames are never decoded. After leaving it,
+             * frames are skipped until the next keyframe, as they would reference
+             * frames that were not decoded. When the consumer can't keep up, the frame
+             * queue asks for the same until it caught up again. */
+            RtspStreamFrameQueue::Backpressure backpressure = m_frameQueue->updateBackpressure();
+            bool keyframe = packet.flags & AV_PKT_FLAG_KEY;
+            if (m_keyframesOnly || backpressure == RtspStreamFrameQueue::SkipNonKeyframes)
+                m_skipUntilKeyframe = true;
+            else if (keyframe)
+                m_skipUntilKeyframe = false;
+
+            if (m_skipUntilKeyframe && !keyframe)
+            {
+                if (!m_keyframesOnly && backpressure == RtspStreamFrameQueue::SkipNonKeyframes)
+                    m_frameQueue->frameSkipped(backpressure);
+                break;
+            }
 
-            if (m_decodeErrorsCnt >= maxDecodeErrors)
-                return false;
+            if (m_connectTimings.firstPacket < 0)
+                m_connectTimings.firstPacket = m_connectTimer.elapsed();
+
+            /* Decoding happens on the shared decoding threads; the reference keeps
+             * the packet data alive without copying it */
+            AVPacket *videoPacket = av_packet_alloc();
+            if (videoPacket && av_packet_ref(videoPacket, &packet) == 0)
+                RtspStreamDecodeScheduler::instance()->submit(this, videoPacket);
+            else
+                av_packet_free(&videoPacket);
 
             break; //always expect single frame in video packets
         }
@@ -217,10 +303,103 @@ AVFrame * RtspStreamWorker::extractAudioFrame(AVPacket &packet)
     return m_frame;
 }
 
-AVFrame * RtspStreamWorker::extractVideoFrame(AVPacket &packet)
+void RtspStreamWorker::decodePacket(AVPacket *packet)
 {
-    startInterruptableOperation(5);
+    if (m_cancelFlag || m_decodeFailed)
+        return;
+
+    /* Let the decoder itself drop anything but keyframes too, in case a packet
+     * carries more than a single frame. Frames no other frame refers to can only
+     * be told apart by the decoder; it drops them under the lightest backpressure. */
+    AVDiscard skipFrame = AVDISCARD_DEFAULT;
+    if (m_keyframesOnly || m_frameQueue->backpressure() == RtspStreamFrameQueue::SkipNonKeyframes)
+        skipFrame = AVDISCARD_NONKEY;
+    else if (m_frameQueue->backpressure() == RtspStreamFrameQueue::SkipNonReferenceFrames)
+        skipFrame = AVDISCARD_NONREF;
+    /* The decoder can only be replaced where decoding restarts anyway */
+    if (packet->flags & AV_PKT_FLAG_KEY)
+        updateDecoderThreads();
+
+    if (m_videoCodecCtx->skip_frame != skipFrame)
+        m_videoCodecCtx->skip_frame = skipFrame;
+
+    QElapsedTimer decodeTimer;
+    decodeTimer.start();
+    int decodeErrors = m_decodeErrorsCnt;
+    AVFrame *frame = extractVideoFrame(*packet);
+    qint64 decodeNsecs = decodeTimer.nsecsElapsed();
+    updateDecodeLoad(decodeNsecs);
+    m_statistics->record(RtspStreamStatistics::Decode, decodeNsecs / 1000);
+
+    if (frame)
+        processVideoFrame(frame);
+    else if (skipFrame == AVDISCARD_NONREF && m_decodeErrorsCnt == decodeErrors)
+        /* Approximate with frame threading, which delays output by a few packets */
+        m_frameQueue->frameSkipped(RtspStreamFrameQueue::SkipNonReferenceFrames);
+
+    if (m_decodeErrorsCnt >= maxDecodeErrors)
+    {
+        m_decodeFailed = true;
+
+        /* Cached parameters may be what breaks decoding; probe on the next attempt */
+        if (m_connectTimings.probeCached && !m_firstFrameDecoded)
+            RtspStreamProbeCache::instance()->remove(m_url);
+    }
+}
+
+void RtspStreamWorker::updateDecodeLoad(qint64 decodeNsecs)
+{
+    m_decodeNsecs += decodeNsecs;
+
+    qint64 elapsed = m_decodeLoadTimer.elapsed();
+    if (elapsed < decodeLoadInterval)
+        return;
+
+    RtspStreamDecoderThreadBudget::instance()->setDecodeLoad(this, m_decodeNsecs / (elapsed * 1000000.0));
+    m_decodeNsecs = 0;
+    m_decodeLoadTimer.restart();
+}
+
+void RtspStreamWorker::updateDecoderThreads()
+{
+    if (m_hwaccelEnabled || !m_decoderThreadsTimer.hasExpired(decoderThreadsInterval))
+        return;
 
+    int threads = RtspStreamDecoderThreadBudget::instance()->threadCount(this);
+    if (threads == m_decoderThreads)
+        return;
+
+    AVCodecContext *avctx = avcodec_alloc_context3(NULL);
+    if (!avctx)
+        return;
+
+    int oldThreads = m_decoderThreads;
+    m_decoderThreads = threads;
+
+    AVDictionary *options = createOptions();
+    bool opened = openCodec(m_ctx->streams[m_videoStreamIndex], avctx, options);
+    av_dict_free(&options);
+
+    if (!opened)
+    {
+        m_decoderThreads = oldThreads;
+        avcodec_free_context(&avctx);
+        return;
+    }
+
+    /* Queued frames keep references to the buffers of the old decoder */
+    avcodec_free_context(&m_videoCodecCtx);
+    m_videoCodecCtx = avctx;
+    m_decoderThreadsTimer.restart();
+    m_decodeNsecs = 0;
+    m_decodeLoadTimer.restart();
+
+    qDebug() << "RtspStreamWorker: reopened video decoder with" << threads << "threads";
+}
+
+// Runs on a decoding thread, see RtspStreamDecodeScheduler
+AVFrame * RtspStreamWorker::extractVideoFrame(AVPacket &packet)
+{
     int ret = avcodec_send_packet(m_videoCodecCtx, &packet);
 
     if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
@@ -229,7 +408,7 @@ AVFrame * RtspStreamWorker::extractVideoFrame(AVPacket &packet)
     if (ret == 0)
         packet.size = 0;
 
-    ret = avcodec_receive_frame(m_videoCodecCtx, m_frame);
+    ret = avcodec_receive_frame(m_videoCodecCtx, m_videoFrame);
 
     if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
         goto fail;
@@ -242,7 +421,7 @@ AVFrame * RtspStreamWorker::extractVideoFrame(AVPacket &packet)
 #if defined(Q_OS_LINUX)
         if (m_videoCodecCtx->opaque)
         {
-            ret = VaapiHWAccel::retrieveData(m_videoCodecCtx, m_frame);
+            ret = VaapiHWAccel::retrieveData(m_videoCodecCtx, m_videoFrame);
 
             if (ret < 0)
             {
@@ -258,11 +437,12 @@ AVFrame * RtspStreamWorker::extractVideoFrame(AVPacket &packet)
     }
     m_decodeErrorsCnt = 0; //reset error counter if extracting frame was successful
 
-    return m_frame;
+    return m_videoFrame;
 
 fail:
 
     m_decodeErrorsCnt++;
+    m_statistics->increment(RtspStreamStatistics::DecodeErrors);
 
     if (m_decodeErrorsCnt >= maxDecodeErrors)
         emit fatalError(QString::fromLatin1("Decoding error: %1").arg(errorMessageFromCode(ret)));
@@ -272,9 +452,125 @@ fail:
 
 void RtspStreamWorker::processVideoFrame(struct AVFrame *rawFrame)
 {
-    Q_ASSERT(m_frameFormatter);
-    startInterruptableOperation(5);
-    m_frameQueue->enqueue(m_frameFormatter->formatFrame(rawFrame, m_frameWidthHint, m_frameHeightHint));
+    /* Queue the decoded frame as it is; conversion is left to the consumer, which only
+     * converts frames that are actually displayed. The clone references the decoder's
+     * buffers instead of copying them. */
+    AVFrame *frame = av_frame_clone(rawFrame);
+    if (!frame)
+        return;
+
+    if (m_shouldTryDeinterlace)
+        frame->interlaced_frame = 1;
+
+    /* Packet pts are missing or out of order with some cameras */
+    frame->pts = rawFrame->best_effort_timestamp;
+
+    /* Keep the last good frame on screen rather than one smeared by lost packets */
+    bool corrupt = (rawFrame->flags & AV_FRAME_FLAG_CORRUPT) || rawFrame->decode_error_flags;
+    if (!m_lossMonitor->frameDecoded(corrupt, rawFrame->key_frame, m_connectTimer.elapsed()))
+    {
+        av_frame_free(&frame);
+        return;
+    }
+
+    if (m_latencyMeter)
+        m_latencyMeter->mark(RtspStreamLatencyMeter::Decoded, frame->pts);
+
+    if (m_frameQueue->enqueue(new RtspStreamFrame(frame, frame->width, frame->height)))
+        emit frameAvailable();
+
+    if (m_firstFrameDecoded.testAndSetOrdered(0, 1))
+    {
+        m_connectTimings.firstFrame = m_connectTimer.elapsed();
+        emit connected(m_connectTimings);
+    }
+}
+
+void RtspStreamWorker::setReplayBufferDuration(int seconds)
+{
+    m_packetBuffer->setDuration(seconds);
+}
+
+void RtspStreamWorker::setRecordingFile(const QString &fileName)
+{
+    QMutexLocker locker(&m_recordingMutex);
+    m_recordingFile = fileName;
+    m_recordingFileChanged.fetchAndStoreOrdered(1);
+}
+
+void RtspStreamWorker::updateRecorder()
+{
+    QMutexLocker locker(&m_recordingMutex);
+    QString fileName = m_recordingFile;
+    locker.unlock();
+
+    if (m_recorder)
+    {
+        if (m_recorder->fileName() == fileName)
+            return;
+
+        m_recorder->stop();
+        m_recorder = 0;
+    }
+
+    if (fileName.isEmpty())
+        return;
+
+    m_recorder = new RtspStreamRecorder(fileName, m_ctx, m_videoStreamIndex, m_audioStreamIndex);
+    connect(m_recorder, SIGNAL(failed(QString)), this, SIGNAL(recordingFailed(QString)));
+
+    /* Start with the group of pictures in progress instead of waiting for the next keyframe */
+    QList<AVPacket *> packets = m_packetBuffer->packets(0);
+    foreach (AVPacket *packet, packets)
+    {
+        m_recorder->write(packet);
+        av_packet_free(&packet);
+    }
+
+    m_recorder->start();
+}
+
+void RtspStreamWorker::startReplay(int seconds)
+{
+    foreach (AVPacket *packet, m_replayPackets)
+        av_packet_free(&packet);
+
+    m_replayPackets = m_packetBuffer->packets(seconds);
+    if (m_replayPackets.isEmpty())
+        return;
+
+    m_replayStartTime = m_packetBuffer->packetTime(m_replayPackets.first());
+    m_replayTimer.start();
+
+    qDebug() << "RtspStreamWorker: replaying" << m_replayPackets.size() << "packets";
+    emit replayStarted();
+}
+
+// Returns true while a replay is running
+bool RtspStreamWorker::processReplay()
+{
+    if (m_replayPackets.isEmpty())
+        return false;
+
+    /* Packets are decoded at their original pace; a stream without timestamps
+     * is replayed as fast as it decodes */
+    qint64 elapsed = m_replayTimer.nsecsElapsed() / 1000;
+    while (!m_replayPackets.isEmpty())
+    {
+        AVPacket *packet = m_replayPackets.first();
+        qint64 time = m_packetBuffer->packetTime(packet);
+        if (time != (int64_t)AV_NOPTS_VALUE && m_replayStartTime != (int64_t)AV_NOPTS_VALUE &&
+            time - m_replayStartTime > elapsed)
+            return true;
+
+        m_replayPackets.removeFirst();
+        RtspStreamDecodeScheduler::instance()->submit(this, packet);
+    }
+
+    /* The decoder state belongs to the replay now; live video resumes at a keyframe */
+    m_skipUntilKeyframe = true;
+    emit replayFinished();
+    return false;
 }
 
 QString RtspStreamWorker::errorMessageFromCode(int errorCode)
@@ -288,6 +584,7 @@ bool RtspStreamWorker::setup()
 {
     ASSERT_WORKER_THREAD();
 
+    m_connectTimer.start();
     m_ctx = avformat_alloc_context();
     m_ctx->interrupt_callback.callback = rtspStreamInterruptCallback;
     m_ctx->interrupt_callback.opaque = this;
@@ -298,9 +595,23 @@ bool RtspStreamWorker::setup()
 
     if (prepared)
     {
-        m_frameFormatter.reset(new RtspStreamFrameFormatter(m_ctx->streams[m_videoStreamIndex]));
-        m_frameFormatter->setAutoDeinterlacing(m_autoDeinterlacing);
+        AVStream *videoStream = m_ctx->streams[m_videoStreamIndex];
+        m_shouldTryDeinterlace = RtspStreamFrameFormatter::shouldTryDeinterlaceStream(videoStream);
+        m_frameQueue->setTimeBase(videoStream->time_base.num, videoStream->time_base.den);
+        m_packetBuffer->setTimeBase(videoStream->time_base.num, videoStream->time_base.den);
+        m_lossMonitor->setTimeBase(videoStream->time_base.num, videoStream->time_base.den);
+        m_lossMonitor->setReorderedTimestamps(videoStream->codecpar->video_delay > 0);
+        m_lossMonitor->setConcealmentWindow(m_udpTransport ? udpConcealmentWindow : 0);
+        if (m_lowLatency)
+            m_frameQueue->setDepthLimit(lowLatencyFrameQueueDepth);
         m_frame = av_frame_alloc();
+        m_videoFrame = av_frame_alloc();
+
+        RtspStreamDecodeScheduler::instance()->addStream(this);
+        RtspStreamDecodeScheduler::instance()->setPriority(this, m_decodePriority);
+
+        m_decoderThreadsTimer.start();
+        m_decodeLoadTimer.start();
     }
     else if (m_ctx)
     {
@@ -315,12 +626,25 @@ bool RtspStreamWorker::prepareStream(AVFormatContext **context, AVDictionary *op
 {
     if (!openInput(context, options))
         return false;
+    m_connectTimings.openInput = m_connectTimer.elapsed();
 
-    if (!findStreamInfo(*context, options))
+    /* Reconnects reuse what was probed last time, as long as the server describes
+     * the same streams */
+    m_connectTimings.probeCached = RtspStreamProbeCache::instance()->apply(m_url, *context);
+    if (!m_connectTimings.probeCached && !findStreamInfo(*context, options))
         return false;
+    m_connectTimings.findStreamInfo = m_connectTimer.elapsed();
 
     if (!openCodecs(*context, options))
+    {
+        if (m_connectTimings.probeCached)
+            RtspStreamProbeCache::instance()->remove(m_url);
         return false;
+    }
+    m_connectTimings.openCodecs = m_connectTimer.elapsed();
+
+    if (!m_connectTimings.probeCached)
+        RtspStreamProbeCache::instance()->store(m_url, *context);
 
     return true;
 }
@@ -331,12 +655,29 @@ AVDictionary * RtspStreamWorker::createOptions() const
 
     av_dict_set(&options, "threads", "1", 0);
     //av_dict_set(&options, "allowed_media_types", "-audio-data", 0);
-    av_dict_set(&options, "max_delay", QByteArray::number(qint64(0.3*AV_TIME_BASE)).constData(), 0);
     /* Because the server always starts streams on a keyframe, we don't need any time here.
      * If the first frame is not a keyframe, this could result in failures or corruption. */
     av_dict_set(&options, "analyzeduration", "0", 0);
-    /* Only TCP is supported currently; speed up connection by trying that first */
-    av_dict_set(&options, "rtsp_transport", "tcp", 0);
+
+    if (m_udpTransport)
+    {
+        /* No head-of-line blocking; the reorder queue of the RTP demuxer is kept small
+         * so that a lost packet costs a glitch instead of latency */
+        av_dict_set(&options, "rtsp_transport", "udp", 0);
+        av_dict_set(&options, "max_delay", QByteArray::number(qint64(udpReorderDelayMs) * 1000 / (m_lowLatency ? 2 : 1)).constData(), 0);
+        av_dict_set(&options, "reorder_queue_size", QByteArray::number(udpReorderQueueSize).constData(), 0);
+        av_dict_set(&options, "buffer_size", QByteArray::number(udpReceiveBufferSize).constData(), 0);
+    }
+    else
+    {
+        /* TCP delivers in order; waiting for reordering only adds latency */
+        av_dict_set(&options, "max_delay", m_lowLatency ? "0" : QByteArray::number(qint64(0.3*AV_TIME_BASE)).constData(), 0);
+        av_dict_set(&options, "rtsp_transport", "tcp", 0);
+    }
+
+    /* Packets are passed on as they are read instead of being buffered by the demuxer */
+    if (m_lowLatency)
+        av_dict_set(&options, "fflags", "nobuffer", 0);
 
     return options;
 }
@@ -361,7 +702,7 @@ bool RtspStreamWorker::openInput(AVFormatContext **context, AVDictionary *option
 bool RtspStreamWorker::findStreamInfo(AVFormatContext* context, AVDictionary* options)
 {
     AVDictionary **streamOptions = createStreamsOptions(context, options);
-    startInterruptableOperation(20);
+    startInterruptableOperation(m_udpTransport ? udpFirstPacketTimeout : 20);
     int errorCode = avformat_find_stream_info(context, streamOptions);
     destroyStreamOptions(context, streamOptions);
 
@@ -399,6 +740,8 @@ void RtspStreamWorker::destroyStreamOptions(AVFormatContext *context, AVDictiona
 
 bool RtspStreamWorker::openCodecs(AVFormatContext *context, AVDictionary *options)
 {
+    startInterruptableOperation(5);
+
     for (unsigned int i = 0; i < context->nb_streams; i++)
     {
         qDebug() << "processing stream id " << i;
@@ -429,6 +772,10 @@ bool RtspStreamWorker::openCodecs(AVFormatContext *context, AVDictionary *option
 #endif
         }
 
+        if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && !m_hwaccelEnabled)
+            m_decoderThreads = RtspStreamDecoderThreadBudget::instance()->addStream(this,
+                    stream->codecpar->width, stream->codecpar->height);
+
         bool codecOpened = openCodec(stream, avctx, options);
         if (!codecOpened)
         {
@@ -488,7 +835,6 @@ bool RtspStreamWorker::openCodec(AVStream *stream, AVCodecContext *avctx, AVDict
     if (avcodec_parameters_to_context(avctx, stream->codecpar) < 0)
         return false;
 
-    startInterruptableOperation(5);
     AVCodec *codec = avcodec_find_decoder(stream->codecpar->codec_id);
 
     if (codec == NULL)
@@ -496,7 +842,19 @@ bool RtspStreamWorker::openCodec(AVStream *stream, AVCodecContext *avctx, AVDict
 
     AVDictionary *optionsCopy = 0;
     av_dict_copy(&optionsCopy, options, 0);
-    startInterruptableOperation(5);
+
+    /* Software video decoders get their share of the decoder thread budget;
+     * FFmpeg uses frame or slice threads depending on what the codec supports */
+    if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && !m_hwaccelEnabled)
+        av_dict_set(&optionsCopy, "threads", QByteArray::number(m_decoderThreads).constData(), 0);
+
+    /* Frame threads delay every frame by one frame per thread; slices don't */
+    if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && m_lowLatency)
+    {
+        av_dict_set(&optionsCopy, "thread_type", "slice", 0);
+        avctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    }
+
     int errorCode = avcodec_open2(avctx, codec, &optionsCopy);
     av_dict_free(&optionsCopy);
 
@@ -508,24 +866,32 @@ void RtspStreamWorker::startInterruptableOperation(int timeoutInSeconds)
     m_timeout = QDateTime::currentDateTime().addSecs(timeoutInSeconds);
 }
 
-RtspStreamFrame * RtspStreamWorker::frameToDisplay()
+void RtspStreamWorker::setFrameSizeHint(int width, int height)
 {
-    if (m_cancelFlag || !m_frameQueue)
-        return 0;
+    m_frameWidthHint = width;
+    m_frameHeightHint = height;
 
-    return m_frameQueue.data()->dequeue();
+    /* Hints come with every paint; the scheduler lock is only taken when the priority changes */
+    int priority = decodePriority();
+    if (m_decodePriority.fetchAndStoreOrdered(priority) != priority)
+        RtspStreamDecodeScheduler::instance()->setPriority(this, priority);
 }
 
-void RtspStreamWorker::setFrameSizeHint(int width, int height)
+int RtspStreamWorker::decodePriority() const
 {
-    m_frameWidthHint = width;
-    m_frameHeightHint = height;
+    /* Bigger tiles are decoded first under load; a stream shown at its native size
+     * (fullscreen or in several windows at once) gets the highest priority */
+    if (m_frameWidthHint <= 0 || m_frameHeightHint <= 0)
+        return INT_MAX;
+
+    return m_frameWidthHint * m_frameHeightHint;
 }
 
 void RtspStreamWorker::stop()
 {
     m_cancelFlag = true;
     m_threadPause.setPaused(false);
+    RtspStreamDecodeScheduler::instance()->cancel(this);
 }
 
 void RtspStreamWorker::setPaused(bool paused)
@@ -18,10 +18,17 @@
 #ifndef RTSPSTREAMWORKER_H
 #define RTSPSTREAMWORKER_H
 
+#include "RtspStreamConnectTimings.h"
+#include "RtspStreamDecodeScheduler.h"
 #include "core/ThreadPause.h"
+#include <QAtomicInt>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
 #include <QObject>
 #include <QUrl>
+#include <QScopedPointer>
 #include <QSharedPointer>
 #include "audio/AudioPlayer.h"
 
@@ -30,10 +37,14 @@ struct AVFrame;
 struct AVStream;
 
 class RtspStreamFrame;
-class RtspStreamFrameFormatter;
 class RtspStreamFrameQueue;
+class RtspStreamLatencyMeter;
+class RtspStreamLossMonitor;
+class RtspStreamPacketBuffer;
+class RtspStreamRecorder;
+class RtspStreamStatistics;
 
-class RtspStreamWorker : public QObject
+class RtspStreamWorker : public QObject, public RtspStreamDecodeScheduler::Stream
 {
     Q_OBJECT
 
@@ -42,16 +53,36 @@ public:
     virtual ~RtspStreamWorker();
 
     void setUrl(const QUrl &url);
+    /* RTP over UDP instead of interleaved in the RTSP connection; before run(). If no
+     * frame arrives over UDP, udpTransportFailed() is emitted with the fatal error. */
+    void setUdpTransport(bool udpTransport) { m_udpTransport = udpTransport; }
+    QSharedPointer<RtspStreamLossMonitor> lossMonitor() const { return m_lossMonitor; }
+    /* Trades robustness for latency: no demuxer buffering, no frame threading and a
+     * short frame queue; before run() */
+    void setLowLatency(bool lowLatency) { m_lowLatency = lowLatency; }
+    /* Null unless latency measurement is enabled, see LiveStream */
+    QSharedPointer<RtspStreamLatencyMeter> latencyMeter() const { return m_latencyMeter; }
+    QSharedPointer<RtspStreamStatistics> statistics() const { return m_statistics; }
 
     void stop();
     void setPaused(bool paused);
-    void setAutoDeinterlacing(bool autoDeinterlacing);
 
     bool shouldInterrupt() const;
-    RtspStreamFrame * frameToDisplay();
 
     void enableAudio(bool enabled) { m_audioEnabled = enabled; }
     void setFrameSizeHint(int width, int height);
+    /* Decode only keyframes, without reconnecting; takes effect with the next packet */
+    void setKeyframesOnly(bool keyframesOnly) { m_keyframesOnly = keyframesOnly; }
+    /* Seconds of compressed video kept for replay() */
+    void setReplayBufferDuration(int seconds);
+    /* Shows the last seconds again from the replay buffer, then goes back to live
+     * video at the next keyframe; takes effect with the next packet */
+    void replay(int seconds) { m_replayRequest.fetchAndStoreOrdered(qMax(seconds, 0)); }
+    /* Copies the received packets to a local file, see RtspStreamRecorder; an empty
+     * file name stops recording. Takes effect with the next packet. */
+    void setRecordingFile(const QString &fileName);
+
+    virtual void decodePacket(struct AVPacket *packet);
 
 public slots:
     void run();
@@ -63,30 +94,64 @@ signals:
     void audioFormat(enum AVSampleFormat fmt, int channelsNum, int sampleRate);
     void audioSamplesAvailable(void *data, int samplesNum, int bytesNum);
     void hwAccelDisabled();
+    void udpTransportFailed();
+    /* Emitted from a decoding thread when frames are waiting to be displayed */
+    void frameAvailable();
+    void replayStarted();
+    void replayFinished();
+    void recordingFailed(const QString &message);
+    /* Emitted from a decoding thread once the first frame is decoded */
+    void connected(const RtspStreamConnectTimings &timings);
 
 private:
     struct AVFormatContext *m_ctx;
     struct AVCodecContext *m_videoCodecCtx;
     struct AVCodecContext *m_audioCodecCtx;
     struct AVFrame *m_frame;
+    struct AVFrame *m_videoFrame;
     QDateTime m_timeout;
     QUrl m_url;
     bool m_cancelFlag;
-    bool m_autoDeinterlacing;
+    bool m_shouldTryDeinterlace;
     mutable bool m_lastCancel;
     mutable int m_lastSeconds;
     int m_decodeErrorsCnt;
+    volatile bool m_decodeFailed;
     int m_videoStreamIndex;
     int m_audioStreamIndex;
     bool m_audioEnabled;
     bool m_hwaccelEnabled;
+    bool m_udpTransport;
+    bool m_lowLatency;
+    volatile bool m_keyframesOnly;
+    bool m_skipUntilKeyframe;
     int m_frameWidthHint;
     int m_frameHeightHint;
+    /* Last priority given to the decode scheduler */
+    QAtomicInt m_decodePriority;
+    int m_decoderThreads;
+    QElapsedTimer m_decoderThreadsTimer;
+    QElapsedTimer m_decodeLoadTimer;
+    qint64 m_decodeNsecs;
+    QElapsedTimer m_connectTimer;
+    RtspStreamConnectTimings m_connectTimings;
+    /* Set on a decoding thread, read on the worker thread */
+    QAtomicInt m_firstFrameDecoded;
 
     ThreadPause m_threadPause;
-    QScopedPointer<RtspStreamFrameFormatter> m_frameFormatter;
     QSharedPointer<RtspStreamFrameQueue> m_frameQueue;
-
+    QScopedPointer<RtspStreamPacketBuffer> m_packetBuffer;
+    QSharedPointer<RtspStreamLossMonitor> m_lossMonitor;
+    QSharedPointer<RtspStreamLatencyMeter> m_latencyMeter;
+    QSharedPointer<RtspStreamStatistics> m_statistics;
+    QAtomicInt m_replayRequest;
+    QList<struct AVPacket *> m_replayPackets;
+    QElapsedTimer m_replayTimer;
+    qint64 m_replayStartTime;
+    RtspStreamRecorder *m_recorder;
+    QMutex m_recordingMutex;
+    QString m_recordingFile;
+    QAtomicInt m_recordingFileChanged;
 
     bool setup();
     bool prepareStream(AVFormatContext **context, AVDictionary *options);
@@ -97,8 +162,11 @@ private:
     void destroyStreamOptions(AVFormatContext *context, AVDictionary **streamOptions);
     bool openCodecs(AVFormatContext *context, AVDictionary *options);
     bool openCodec(AVStream *stream, AVCodecContext *avctx, AVDictionary *options);
+    void updateDecoderThreads();
+    void updateDecodeLoad(qint64 decodeNsecs);
 
     void pause();
+    int decodePriority() const;
 
     void processStreamLoop();
     bool processStream();
@@ -107,8 +175,13 @@ private:
     AVFrame * extractVideoFrame(struct AVPacket &packet);
     AVFrame * extractAudioFrame(struct AVPacket &packet);
     void processVideoFrame(struct AVFrame *frame);
+    void startReplay(int seconds);
+    bool processReplay();
+    void updateRecorder();
 
     QString errorMessageFromCode(int errorCode);
+    /* Only on the worker thread, where shouldInterrupt() reads the deadline; codecs
+     * reopened by updateDecoderThreads() on a decoding thread don't touch it */
     void startInterruptableOperation(int timeoutInSeconds);
 
 };
@@ -18,7 +18,7 @@
 #include "DVRServerConfiguration.h"
 
 DVRServerConfiguration::DVRServerConfiguration(int id, QObject *parent)
-    : QObject(parent), m_id(id), m_port(0), m_autoConnect(false), m_connectionType(0)
+    : QObject(parent), m_id(id), m_port(0), m_autoConnect(false), m_connectionType(0), m_rtspTransport(0)
 {
 }
 
@@ -98,6 +98,16 @@ void DVRServerConfiguration::setConnectionType(int type)
     emit changed();
 }
 
+void DVRServerConfiguration::setRtspTransport(int transport)
+{
+    if (m_rtspTransport == transport)
+        return;
+
+    m_rtspTransport = transport;
+    emit rtspTransportChanged(transport);
+    emit changed();
+}
+
 int DVRServerConfiguration::id() const
 {
     return m_id;
@@ -142,3 +152,8 @@ int DVRServerConfiguration::connectionType() const
 {
     return m_connectionType;
 }
+
+int DVRServerConfiguration::rtspTransport() const
+{
+    return m_rtspTransport;
+}
@@ -55,8 +55,12 @@ public:
     int connectionType() const;
     void setConnectionType(int type);
 
+    int rtspTransport() const;
+    void setRtspTransport(int transport);
+
 signals:
     void changed();
+    void rtspTransportChanged(int transport);
 
 private:
     const int m_id;
@@ -68,6 +72,7 @@ private:
     bool m_autoConnect;
     QByteArray m_sslDigest;
     int m_connectionType;
+    int m_rtspTransport;
 
 };
 
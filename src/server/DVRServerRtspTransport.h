@@ -0,0 +1,14 @@
+#ifndef DVRSERVERRTSPTRANSPORT_H
+#define DVRSERVERRTSPTRANSPORT_H
+
+namespace DVRServerRtspTransport
+{
+    enum Type
+    {
+        TCP = 0,
+        /* Falls back to TCP when nothing arrives over UDP */
+        UDP = 1
+    };
+}
+
+#endif // DVRSERVERRTSPTRANSPORT_H
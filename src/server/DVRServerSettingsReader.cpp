@@ -18,6 +18,7 @@
 #include "DVRServer.h"
 #include "DVRServerConfiguration.h"
 #include "DVRServerConnectionType.h"
+#include "DVRServerRtspTransport.h"
 #include "DVRServerSettingsReader.h"
 #include <QSettings>
 
@@ -34,6 +35,7 @@ DVRServer * DVRServerSettingsReader::readServer(int serverId) const
     server->configuration().setAutoConnect(readSetting(serverId, QLatin1String("autoConnect"), true).toBool());
     server->configuration().setSslDigest(readSetting(serverId, QLatin1String("sslDigest")).toByteArray());
     server->configuration().setConnectionType(readSetting(serverId, QLatin1String("connectionType"), DVRServerConnectionType::RTSP).toInt());
+    server->configuration().setRtspTransport(readSetting(serverId, QLatin1String("rtspTransport"), DVRServerRtspTransport::TCP).toInt());
 
     return server;
 }
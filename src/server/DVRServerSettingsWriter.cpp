@@ -35,6 +35,7 @@ void DVRServerSettingsWriter::writeServer(DVRServer *server) const
     writeSetting(serverId, QLatin1String("autoConnect"), server->configuration().autoConnect());
     writeSetting(serverId, QLatin1String("sslDigest"), server->configuration().sslDigest());
     writeSetting(serverId, QLatin1String("connectionType"), server->configuration().connectionType());
+    writeSetting(serverId, QLatin1String("rtspTransport"), server->configuration().rtspTransport());
 }
 
 void DVRServerSettingsWriter::writeSetting(int serverId, const QString &key, const QVariant &value) const
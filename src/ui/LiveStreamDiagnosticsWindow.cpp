@@ -0,0 +1,251 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LiveStreamDiagnosticsWindow.h"
+#include "core/BluecherryApp.h"
+#include "core/LiveStream.h"
+#include "core/LiveViewManager.h"
+#include "utils/FileUtils.h"
+#include "utils/ThreadTaskExecutor.h"
+#include <QApplication>
+#include <QBoxLayout>
+#include <QClipboard>
+#include <QDesktopServices>
+#include <QEvent>
+#include <QFile>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QSettings>
+#include <QTreeWidget>
+
+static void writeJson(const QVariant &value, QByteArray &out)
+{
+    switch (value.type())
+    {
+    case QVariant::Map:
+    {
+        QVariantMap map = value.toMap();
+        out.append('{');
+        for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it)
+        {
+            if (it != map.constBegin())
+                out.append(',');
+            writeJson(it.key(), out);
+            out.append(':');
+            writeJson(it.value(), out);
+        }
+        out.append('}');
+        break;
+    }
+    case QVariant::List:
+    {
+        QVariantList list = value.toList();
+        out.append('[');
+        for (int i = 0; i < list.size(); ++i)
+        {
+            if (i)
+                out.append(',');
+            writeJson(list.at(i), out);
+        }
+        out.append(']');
+        break;
+    }
+    case QVariant::Bool:
+        out.append(value.toBool() ? "true" : "false");
+        break;
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+        out.append(QByteArray::number(value.toLongLong()));
+        break;
+    case QVariant::Double:
+        out.append(QByteArray::number(value.toDouble(), 'f', 2));
+        break;
+    case QVariant::Invalid:
+        out.append("null");
+        break;
+    default:
+    {
+        QString string = value.toString();
+        out.append('"');
+        for (int i = 0; i < string.size(); ++i)
+        {
+            ushort c = string.at(i).unicode();
+            if (c == '"' || c == '\\')
+                out.append('\\').append(char(c));
+            else if (c < 0x20 || c > 0x7e)
+                out.append(QString::fromLatin1("\\u%1").arg(c, 4, 16, QLatin1Char('0')).toLatin1());
+            else
+                out.append(char(c));
+        }
+        out.append('"');
+        break;
+    }
+    }
+}
+
+static QString timingText(const QVariantMap &diagnostics, const char *timing)
+{
+    QVariantMap values = diagnostics.value(QLatin1String("timings")).toMap().value(QLatin1String(timing)).toMap();
+    if (values.value(QLatin1String("samples")).toInt() == 0)
+        return QString();
+
+    return QString::fromLatin1("%1 / %2").arg(values.value(QLatin1String("medianUs")).toLongLong() / 1000.0, 0, 'f', 1)
+            .arg(values.value(QLatin1String("p99Us")).toLongLong() / 1000.0, 0, 'f', 1);
+}
+
+LiveStreamDiagnosticsWindow::LiveStreamDiagnosticsWindow(QWidget *parent)
+    : QFrame(parent)
+{
+    setAttribute(Qt::WA_DeleteOnClose, true);
+    setMinimumSize(750, 300);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+
+    m_streamsView = new QTreeWidget;
+    m_streamsView->setRootIsDecorated(false);
+    m_streamsView->setColumnCount(11);
+    m_streamsView->header()->setResizeMode(QHeaderView::ResizeToContents);
+    layout->addWidget(m_streamsView);
+
+    QHBoxLayout *buttonsLayout = new QHBoxLayout;
+    buttonsLayout->addStretch();
+    layout->addLayout(buttonsLayout);
+
+    m_copyButton = new QPushButton;
+    connect(m_copyButton, SIGNAL(clicked()), SLOT(copyJson()));
+    buttonsLayout->addWidget(m_copyButton);
+
+    m_saveButton = new QPushButton;
+    connect(m_saveButton, SIGNAL(clicked()), SLOT(saveJson()));
+    buttonsLayout->addWidget(m_saveButton);
+
+    retranslateUI();
+
+    QSettings settings;
+    restoreGeometry(settings.value(QLatin1String("ui/streamDiagnosticsWindow/geometry")).toByteArray());
+
+    connect(qApp, SIGNAL(aboutToQuit()), this, SLOT(saveSettings()));
+
+    connect(&m_refreshTimer, SIGNAL(timeout()), SLOT(refresh()));
+    m_refreshTimer.start(1000);
+    refresh();
+}
+
+LiveStreamDiagnosticsWindow::~LiveStreamDiagnosticsWindow()
+{
+    saveSettings();
+}
+
+void LiveStreamDiagnosticsWindow::saveSettings()
+{
+    QSettings settings;
+    settings.setValue(QLatin1String("ui/streamDiagnosticsWindow/geometry"), saveGeometry());
+}
+
+void LiveStreamDiagnosticsWindow::changeEvent(QEvent *event)
+{
+    if (event && event->type() == QEvent::LanguageChange)
+        retranslateUI();
+
+    QFrame::changeEvent(event);
+}
+
+void LiveStreamDiagnosticsWindow::retranslateUI()
+{
+    setWindowTitle(tr("Bluecherry - Stream Diagnostics"));
+
+    m_streamsView->setHeaderLabels(QStringList() << tr("Camera") << tr("State") << tr("FPS")
+                                   << tr("Read wait (ms)") << tr("Decode (ms)") << tr("Convert (ms)")
+                                   << tr("Queued (ms)") << tr("Paint (ms)") << tr("Dropped")
+                                   << tr("Skipped") << tr("Lost"));
+    m_streamsView->headerItem()->setToolTip(3, tr("Median / 99th percentile"));
+
+    m_copyButton->setText(tr("Copy as JSON"));
+    m_saveButton->setText(tr("Save as JSON..."));
+}
+
+void LiveStreamDiagnosticsWindow::refresh()
+{
+    QList<LiveStream *> streams = bcApp->liveView->streams();
+
+    while (m_streamsView->topLevelItemCount() > streams.size())
+        delete m_streamsView->takeTopLevelItem(m_streamsView->topLevelItemCount() - 1);
+    while (m_streamsView->topLevelItemCount() < streams.size())
+        m_streamsView->addTopLevelItem(new QTreeWidgetItem);
+
+    for (int i = 0; i < streams.size(); ++i)
+    {
+        QVariantMap diagnostics = streams.at(i)->diagnostics();
+        QVariantMap frames = diagnostics.value(QLatin1String("frames")).toMap();
+        QVariantMap transport = diagnostics.value(QLatin1String("transportStatistics")).toMap();
+        int skipped = frames.value(QLatin1String("skippedNonReference")).toInt()
+                + frames.value(QLatin1String("skippedNonKeyframes")).toInt();
+
+        QTreeWidgetItem *item = m_streamsView->topLevelItem(i);
+        item->setText(0, diagnostics.value(QLatin1String("camera")).toString());
+        item->setText(1, diagnostics.value(QLatin1String("state")).toString());
+        item->setText(2, QString::number(diagnostics.value(QLatin1String("receivedFps")).toDouble(), 'f', 1));
+        item->setText(3, timingText(diagnostics, "readWait"));
+        item->setText(4, timingText(diagnostics, "decode"));
+        item->setText(5, timingText(diagnostics, "convert"));
+        item->setText(6, timingText(diagnostics, "queueResidency"));
+        item->setText(7, timingText(diagnostics, "paint"));
+        item->setText(8, frames.value(QLatin1String("dropped")).toString());
+        item->setText(9, skipped ? QString::number(skipped) : QString());
+        item->setText(10, transport.value(QLatin1String("lost")).toString());
+    }
+}
+
+QByteArray LiveStreamDiagnosticsWindow::diagnosticsJson()
+{
+    QVariantList streams;
+    foreach (LiveStream *stream, bcApp->liveView->streams())
+        streams.append(stream->diagnostics());
+
+    QVariantMap document;
+    document.insert(QLatin1String("version"), QApplication::applicationVersion());
+    document.insert(QLatin1String("streams"), streams);
+    document.insert(QLatin1String("threadPools"), ThreadTaskExecutor::instance()->diagnostics());
+
+    QByteArray result;
+    writeJson(document, result);
+    result.append('\n');
+    return result;
+}
+
+void LiveStreamDiagnosticsWindow::copyJson()
+{
+    QApplication::clipboard()->setText(QString::fromUtf8(diagnosticsJson()));
+}
+
+void LiveStreamDiagnosticsWindow::saveJson()
+{
+    QString path = getSaveFileNameExt(this, tr("Save stream diagnostics"),
+                                      QDesktopServices::storageLocation(QDesktopServices::DocumentsLocation),
+                                      QLatin1String("ui/streamDiagnosticsSaveLocation"),
+                                      QLatin1String("stream-diagnostics.json"), tr("JSON (*.json)"));
+    if (path.isEmpty())
+        return;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(diagnosticsJson()) < 0)
+        QMessageBox::critical(this, tr("Error"), tr("An error occurred while saving the stream diagnostics:\n\n%1")
+                              .arg(file.errorString()));
+}
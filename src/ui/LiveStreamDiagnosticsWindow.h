@@ -0,0 +1,59 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIVESTREAMDIAGNOSTICSWINDOW_H
+#define LIVESTREAMDIAGNOSTICSWINDOW_H
+
+#include <QFrame>
+#include <QTimer>
+#include <QVariant>
+
+class QPushButton;
+class QTreeWidget;
+
+/* Pipeline timings and frame counts of every live stream, refreshed every second.
+ * The same values can be copied or saved as JSON for bug reports and scripts. */
+class LiveStreamDiagnosticsWindow : public QFrame
+{
+    Q_OBJECT
+
+public:
+    explicit LiveStreamDiagnosticsWindow(QWidget *parent = 0);
+    virtual ~LiveStreamDiagnosticsWindow();
+
+    /* Diagnostics of all streams as one JSON document */
+    static QByteArray diagnosticsJson();
+
+protected:
+    virtual void changeEvent(QEvent *event);
+
+private slots:
+    void refresh();
+    void copyJson();
+    void saveJson();
+    void saveSettings();
+
+private:
+    QTreeWidget *m_streamsView;
+    QPushButton *m_copyButton;
+    QPushButton *m_saveButton;
+    QTimer m_refreshTimer;
+
+    void retranslateUI();
+};
+
+#endif // LIVESTREAMDIAGNOSTICSWINDOW_H
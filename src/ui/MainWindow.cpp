@@ -324,6 +324,15 @@ void MainWindow::showDownloadsWindow()
     m_eventVideoDownloadsWindow.data()->raise();
 }
 
+void MainWindow::showStreamDiagnosticsWindow()
+{
+    if (!m_streamDiagnosticsWindow)
+        m_streamDiagnosticsWindow = new LiveStreamDiagnosticsWindow();
+
+    m_streamDiagnosticsWindow.data()->show();
+    m_streamDiagnosticsWindow.data()->raise();
+}
+
 void MainWindow::createMenu()
 {
 	m_appMenu = menuBar()->addMenu(tr("&Bluecherry"));
@@ -369,6 +378,9 @@ void MainWindow::updateLiveMenu()
 		a->setParent(m_liveMenu);
 
 	m_liveMenu->addActions(fpsActions);
+
+	m_liveMenu->addSeparator();
+	m_streamDiagnosticsAction = m_liveMenu->addAction(tr("Stream diagnostics"), this, SLOT(showStreamDiagnosticsWindow()));
 }
 
 QMenu *MainWindow::serverMenu(DVRServer *server)
@@ -497,6 +509,7 @@ void MainWindow::retranslateUI()
 
 	m_liveMenu->setTitle(tr("&Live"));
 	m_newWindowAction->setText(tr("New window"));
+	m_streamDiagnosticsAction->setText(tr("Stream diagnostics"));
 
 	m_helpMenu->setTitle(tr("&Help"));
 	m_documentationAction->setText(tr("&Documentation"));
@@ -21,6 +21,7 @@
 #include <QMainWindow>
 #include <QSystemTrayIcon>
 #include "ui/EventVideoDownloadsWindow.h"
+#include "ui/LiveStreamDiagnosticsWindow.h"
 
 class DVRServersView;
 class LiveViewWindow;
@@ -66,6 +67,7 @@ public slots:
 
     void showFront();
     void showDownloadsWindow();
+    void showStreamDiagnosticsWindow();
 
     void saveTopWindow(QWidget *w);
 
@@ -102,6 +104,7 @@ private:
     QWidget *serverAlertWidget;
     QLabel *serverAlertText;
     QWeakPointer<EventVideoDownloadsWindow> m_eventVideoDownloadsWindow;
+    QWeakPointer<LiveStreamDiagnosticsWindow> m_streamDiagnosticsWindow;
     QWeakPointer<EventsWindow> m_eventsWindow;
 
 	QAction *m_expandAllServersAction;
@@ -116,6 +119,7 @@ private:
 
 	QMenu *m_liveMenu;
 	QAction *m_newWindowAction;
+	QAction *m_streamDiagnosticsAction;
 
 	QMenu *m_helpMenu;
 	QAction *m_documentationAction;
@@ -57,6 +57,16 @@ OptionsGeneralPage::OptionsGeneralPage(QWidget *parent)
 
     layout->addLayout(mpvvoLayout);
 
+    /* Values of RtspStreamFrameQueue::LatencyProfile */
+    QFormLayout *latencyLayout = new QFormLayout();
+    m_latencyProfile = new QComboBox();
+    m_latencyProfile->addItem(tr("Lowest latency (PTZ control)"), 0);
+    m_latencyProfile->addItem(tr("Smooth playback (monitoring)"), 1);
+    m_latencyProfile->setCurrentIndex(m_latencyProfile->findData(
+                                          settings.value(QLatin1String("ui/liveview/latencyProfile"), 1).toInt()));
+    latencyLayout->addRow(new QLabel(tr("Live view playback:")), m_latencyProfile);
+
+    layout->addLayout(latencyLayout);
 
     m_closeToTray = new QCheckBox(tr("Close to tray"));
     m_closeToTray->setChecked(settings.value(QLatin1String("ui/main/closeToTray"), false).toBool());
@@ -177,6 +187,7 @@ void OptionsGeneralPage::saveChanges()
     settings.setValue(QLatin1String("ui/main/closeToTray"), m_closeToTray->isChecked());
     bcApp->mainWindow->updateTrayIcon();
     settings.setValue(QLatin1String("ui/liveview/autoDeinterlace"), m_deinterlace->isChecked());
+    settings.setValue(QLatin1String("ui/liveview/latencyProfile"), m_latencyProfile->itemData(m_latencyProfile->currentIndex()));
     settings.setValue(QLatin1String("ui/disableUpdateNotifications"), m_updateNotifications->isChecked());
     settings.setValue(QLatin1String("ui/enableThumbnails"), m_thumbnails->isChecked());
     settings.setValue(QLatin1String("ui/saveSession"), m_session->isChecked());
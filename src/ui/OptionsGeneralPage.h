@@ -46,6 +46,7 @@ private:
 
 	QComboBox *m_languages;
     QComboBox *m_mpvvo;
+    QComboBox *m_latencyProfile;
 
     void fillLanguageComboBox();
     void fillMpvVOComboBox();
@@ -22,6 +22,7 @@
 #include "server/DVRServer.h"
 #include "server/DVRServerConfiguration.h"
 #include "server/DVRServerConnectionType.h"
+#include "server/DVRServerRtspTransport.h"
 #include "server/DVRServerRepository.h"
 #include "ui/WebRtpPortCheckerWidget.h"
 #include <QBoxLayout>
@@ -106,6 +107,14 @@ OptionsServerPage::OptionsServerPage(DVRServerRepository *serverRepository, QWid
     m_connectionType->addItem(tr("MJPEG"));
     editsLayout->addWidget(m_connectionType, 2, 1);
 
+    label = new QLabel(tr("RTSP Transport:"));
+    editsLayout->addWidget(label, 2, 2, Qt::AlignRight);
+
+    m_rtspTransport = new QComboBox;
+    m_rtspTransport->addItem(tr("TCP"));
+    m_rtspTransport->addItem(tr("UDP (lower latency, falls back to TCP)"));
+    editsLayout->addWidget(m_rtspTransport, 2, 3);
+
     label = new QLabel(tr("Username:"));
     editsLayout->addWidget(label, 0, 2, Qt::AlignRight);
 
@@ -190,6 +199,7 @@ void OptionsServerPage::currentServerChanged(const QModelIndex &newIndex, const
         m_usernameEdit->clear();
         m_passwordEdit->clear();
         m_connectionType->setCurrentIndex(DVRServerConnectionType::RTSP);
+        m_rtspTransport->setCurrentIndex(DVRServerRtspTransport::TCP);
         return;
     }
 
@@ -200,6 +210,7 @@ void OptionsServerPage::currentServerChanged(const QModelIndex &newIndex, const
     m_passwordEdit->setText(server->configuration().password());
     m_autoConnect->setChecked(server->configuration().autoConnect());
     m_connectionType->setCurrentIndex(server->configuration().connectionType());
+    m_rtspTransport->setCurrentIndex(server->configuration().rtspTransport());
 
     connect(server, SIGNAL(loginSuccessful(DVRServer*)), SLOT(setLoginSuccessful()));
     connect(server, SIGNAL(loginError(QString)), SLOT(setLoginError(QString)));
@@ -309,6 +320,7 @@ void OptionsServerPage::saveChanges(DVRServer *server)
 
     server->configuration().setAutoConnect(m_autoConnect->isChecked());
     server->configuration().setConnectionType(m_connectionType->currentIndex());
+    server->configuration().setRtspTransport(m_rtspTransport->currentIndex());
 
     if (connectionModified || (m_autoConnect->isChecked() && !server->isOnline()))
         server->login();
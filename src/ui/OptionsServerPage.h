@@ -70,6 +70,7 @@ private:
     WebRtpPortCheckerWidget *m_portChecker;
     QCheckBox *m_autoConnect;
     QComboBox *m_connectionType;
+    QComboBox *m_rtspTransport;
 };
 
 #endif // OPTIONSSERVERPAGE_H
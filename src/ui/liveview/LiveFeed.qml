@@ -214,6 +214,16 @@ LiveFeedBase {
                             text: "Paused"
                         }
                     },
+                    State {
+                        name: "replaying"
+                        when: stream && stream.replaying
+
+                        PropertyChanges {
+                            target: fpsText
+                            color: "#6ec6ff"
+                            text: "Replay"
+                        }
+                    },
                     State {
                         name: "active"
                         when: stream && !stream.paused
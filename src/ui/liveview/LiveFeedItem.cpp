@@ -209,7 +209,7 @@ void LiveFeedItem::saveSnapshot(const QString &ifile)
         return;
 
     /* Grab the current frame, so the user gets what they expect regardless of the time taken by the dialog */
-    QImage frame = m_camera.data()->liveStream()->currentFrame();
+    QImage frame = m_camera.data()->liveStream()->snapshot();
     if (frame.isNull())
         return;
 
@@ -241,6 +241,37 @@ void LiveFeedItem::saveSnapshot(const QString &ifile)
     }
 }
 
+void LiveFeedItem::startLocalRecording()
+{
+    if (!m_camera || !stream())
+        return;
+
+    QWidget *window = scene()->views().value(0);
+
+    QString file = getSaveFileNameExt(window, tr("%1 - Record Locally").arg(m_camera.data()->data().displayName()),
+                       QDesktopServices::storageLocation(QDesktopServices::MoviesLocation),
+                       QLatin1String("ui/localRecordingSaveLocation"),
+                       QString::fromLatin1("%1 - %2.mkv").arg(m_camera.data()->data().displayName(),
+                                                              QDateTime::currentDateTime().toString(
+                                                              QLatin1String("yyyy-MM-dd hh-mm-ss"))),
+                       tr("Matroska Video (*.mkv);;MP4 Video (*.mp4)"));
+
+    if (file.isEmpty() || !stream())
+        return;
+    if (!file.endsWith(QLatin1String(".mkv"), Qt::CaseInsensitive) && !file.endsWith(QLatin1String(".mp4"), Qt::CaseInsensitive))
+        file.append(QLatin1String(".mkv"));
+
+    connect(stream(), SIGNAL(localRecordingFailed(QString)), SLOT(localRecordingFailed(QString)), Qt::UniqueConnection);
+    stream()->startLocalRecording(file);
+}
+
+void LiveFeedItem::localRecordingFailed(const QString &message)
+{
+    QWidget *window = scene() ? scene()->views().value(0) : 0;
+    QMessageBox::critical(window, tr("Recording Error"), tr("Local recording stopped: %1").arg(message),
+                          QMessageBox::Ok);
+}
+
 /* contextMenuEvent will arrive after right clicks that were captured within QML.
  * To avoid this, we need a bit of a hack to tell when a context menu event was
  * caused by a right click, and only allow it if we saw the click (i.e. it wasn't
@@ -291,6 +322,26 @@ void LiveFeedItem::contextMenuEvent(QGraphicsSceneContextMenuEvent *event)
     menu.addActions(bw);
 
     menu.addSeparator();
+
+    int replaySeconds = stream() ? stream()->replayBufferDuration() : 0;
+    if (replaySeconds > 0)
+    {
+        QAction *a = menu.addAction(tr("Replay last %n seconds", 0, qMin(replaySeconds, 10)), this, SLOT(replayFromAction()));
+        a->setData(qMin(replaySeconds, 10));
+        if (replaySeconds > 10)
+        {
+            a = menu.addAction(tr("Replay last %n seconds", 0, replaySeconds), this, SLOT(replayFromAction()));
+            a->setData(replaySeconds);
+        }
+        menu.addSeparator();
+    }
+
+    if (stream() && stream()->isRecordingLocally())
+        menu.addAction(tr("Stop local recording"), stream(), SLOT(stopLocalRecording()));
+    else if (stream() && stream()->canRecordLocally())
+        menu.addAction(tr("Record locally..."), this, SLOT(startLocalRecording()));
+    menu.addSeparator();
+
     menu.addAction(tr("Open in window"), this, SLOT(openNewWindow()));
     menu.addAction(tr("Open as fullscreen"), this, SLOT(openFullScreen()));
     menu.addSeparator();
@@ -322,6 +373,15 @@ void LiveFeedItem::setBandwidthModeFromAction()
     stream()->setPaused(false);
 }
 
+void LiveFeedItem::replayFromAction()
+{
+    QAction *a = qobject_cast<QAction*>(sender());
+    if (!a || a->data().isNull() || !stream())
+        return;
+
+    stream()->replay(a->data().toInt());
+}
+
 void LiveFeedItem::serverRemoved(DVRServer *server)
 {
     if (!server || !m_camera)
@@ -105,6 +105,7 @@ public slots:
     void openNewWindow();
     void openFullScreen();
     void saveSnapshot(const QString &file = QString());
+    void startLocalRecording();
 
     void setCustomCursor(CustomCursor cursor);
     void setPtzEnabled(bool ptzEnabled);
@@ -135,6 +136,8 @@ protected:
 private slots:
     void cameraDataUpdated();
     void setBandwidthModeFromAction();
+    void replayFromAction();
+    void localRecordingFailed(const QString &message);
     void serverRemoved(DVRServer *server);
     void updateAudioState(enum AudioState state = Load);
 
@@ -17,9 +17,11 @@
 
 #include "LiveStreamItem.h"
 #include "core/BluecherryApp.h"
+#include <QElapsedTimer>
 #include <QPainter>
 #include <QStyleOptionGraphicsItem>
 #include <QSettings>
+#include <QTime>
 //#include <QGLContext>
 
 #ifndef Q_UNLIKELY
@@ -37,7 +39,7 @@
 */
 
 LiveStreamItem::LiveStreamItem(QDeclarativeItem *parent)
-    : QDeclarativeItem(parent)/*, m_useAdvancedGL(true), m_texId(0), m_texLastContext(0), m_texInvalidate(false),
+    : QDeclarativeItem(parent), m_viewVisible(true)/*, m_useAdvancedGL(true), m_texId(0), m_texLastContext(0), m_texInvalidate(false),
       m_texDataPtr(0)*/
 {
     this->setFlag(QGraphicsItem::ItemHasNoContents, false);
@@ -48,7 +50,11 @@ LiveStreamItem::LiveStreamItem(QDeclarativeItem *parent)
 LiveStreamItem::~LiveStreamItem()
 {
     //clearTexture();
-    m_stream.data()->unref();
+    if (m_stream)
+    {
+        m_stream.data()->removeConsumerVisibility(this);
+        m_stream.data()->unref(this);
+    }
 }
 
 /* This is odd and hackish logic to manage deletion of textures. The problem here is
@@ -99,7 +105,8 @@ void LiveStreamItem::setStream(QSharedPointer<LiveStream> stream)
     if (m_stream)
     {
         m_stream.data()->disconnect(this);
-        m_stream.data()->unref();
+        m_stream.data()->removeConsumerVisibility(this);
+        m_stream.data()->unref(this);
     }
 
     m_stream = stream;
@@ -109,7 +116,8 @@ void LiveStreamItem::setStream(QSharedPointer<LiveStream> stream)
         connect(m_stream.data(), SIGNAL(updated()), SLOT(updateFrame()));
         connect(m_stream.data(), SIGNAL(streamSizeChanged(QSize)), SLOT(updateFrameSize()));
         m_stream.data()->start();
-        m_stream.data()->ref();
+        m_stream.data()->ref(this);
+        m_stream.data()->setConsumerVisible(this, m_viewVisible);
     }
 
     updateFrameSize();
@@ -122,6 +130,16 @@ void LiveStreamItem::clear()
     //clearTexture();
 }
 
+void LiveStreamItem::setViewVisible(bool visible)
+{
+    if (m_viewVisible == visible)
+        return;
+
+    m_viewVisible = visible;
+    if (m_stream)
+        m_stream.data()->setConsumerVisible(this, m_viewVisible);
+}
+
 void LiveStreamItem::updateFrameSize()
 {
     //clearTexture();
@@ -134,7 +152,8 @@ void LiveStreamItem::paint(QPainter *p, const QStyleOptionGraphicsItem *opt, QWi
     if (!m_stream)
         return;
 
-    QImage frame = m_stream.data()->currentFrame();
+    /* Holding the frame keeps its pixels alive while painting */
+    LiveStreamFrame frame = m_stream.data()->currentFrame(this);
 
     if (frame.isNull())
     {
@@ -219,15 +238,25 @@ void LiveStreamItem::paint(QPainter *p, const QStyleOptionGraphicsItem *opt, QWi
         //m_texInvalidate = 0;
         //m_texLastContext = 0;
 
+        QElapsedTimer paintTimer;
+        paintTimer.start();
+
         p->save();
         //p->setRenderHint(QPainter::SmoothPixmapTransform);
         p->setCompositionMode(QPainter::CompositionMode_Source);
-        p->drawImage(opt->rect, frame);
+        p->drawImage(opt->rect, frame.image());
         p->restore();
 
+        m_stream.data()->framePainted(paintTimer.nsecsElapsed() / 1000);
+
+        /* Photographing this next to a test source with a burned-in clock shows the
+         * latency from camera to screen */
+        if (LiveStream::isLatencyMeasurementEnabled())
+            paintClock(p, opt->rect);
+
         /* In some cases opt rect width and height may be negative */
         if (opt->rect.width() > 0 && opt->rect.height() > 0)
-            m_stream.data()->setFrameSizeHint(opt->rect.width(), opt->rect.height());
+            m_stream.data()->setFrameSizeHint(this, opt->rect.width(), opt->rect.height());
     }
 
 }
@@ -239,3 +268,20 @@ void LiveStreamItem::updateSettings()
     if (!m_useAdvancedGL && m_texId)
         clearTexture();
 }*/
+
+void LiveStreamItem::paintClock(QPainter *p, const QRect &rect)
+{
+    QString text = QTime::currentTime().toString(QLatin1String("hh:mm:ss.zzz"));
+
+    p->save();
+    QFont font = p->font();
+    font.setPixelSize(qMax(12, rect.height() / 20));
+    p->setFont(font);
+
+    QRect textRect = p->fontMetrics().boundingRect(text).adjusted(-4, -2, 4, 2);
+    textRect.moveTopRight(rect.topRight());
+    p->fillRect(textRect, Qt::black);
+    p->setPen(Qt::white);
+    p->drawText(textRect, Qt::AlignCenter, text);
+    p->restore();
+}
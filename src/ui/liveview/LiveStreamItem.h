@@ -41,6 +41,10 @@ public:
     void setStream(QSharedPointer<LiveStream> stream);
     void clear();
 
+    /* Set by LiveViewArea; see LiveStream::setConsumerVisible() */
+    bool isViewVisible() const { return m_viewVisible; }
+    void setViewVisible(bool visible);
+
     QSizeF frameSize() const { return m_stream ? m_stream.data()->streamSize() : QSize(0, 0); }
 
 signals:
@@ -58,6 +62,7 @@ private slots:
 
 private:
     QSharedPointer<LiveStream> m_stream;
+    bool m_viewVisible;
     /*bool m_useAdvancedGL;
     unsigned m_texId;
     const QGLContext *m_texLastContext;
@@ -65,6 +70,8 @@ private:
     const uchar *m_texDataPtr;
 
     void clearTexture();*/
+
+    void paintClock(QPainter *p, const QRect &rect);
 };
 
 #endif // LIVESTREAMITEM_H
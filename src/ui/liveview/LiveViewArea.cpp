@@ -27,13 +27,17 @@
 #include <QGLWidget>
 #include <QDeclarativeContext>
 #include <QDeclarativeEngine>
+#include <QDesktopWidget>
 #include <QSettings>
 #include <QShowEvent>
 #include <QApplication>
 #include <QTimer>
 
+/* Polling interval for visibility changes that come without an event */
+static const int visibilityPollInterval = 1000;
+
 LiveViewArea::LiveViewArea(DVRServerRepository *serverRepository, QWidget *parent)
-    : QDeclarativeView(parent)
+    : QDeclarativeView(parent), m_isUnmapped(false)
 {
     //connect(bcApp, SIGNAL(settingsChanged()), SLOT(settingsChanged()));
 
@@ -58,6 +62,9 @@ LiveViewArea::LiveViewArea(DVRServerRepository *serverRepository, QWidget *paren
 
     m_layout = rootObject()->findChild<LiveViewLayout*>(QLatin1String("viewLayout"));
     Q_ASSERT(m_layout);
+
+    connect(&m_visibilityTimer, SIGNAL(timeout()), SLOT(updateStreamVisibility()));
+    m_visibilityTimer.start(visibilityPollInterval);
 }
 
 LiveViewArea::~LiveViewArea()
@@ -93,7 +100,9 @@ void LiveViewArea::showEvent(QShowEvent *event)
 //        }
 //    }
 
+    m_isUnmapped = false;
     QDeclarativeView::showEvent(event);
+    updateStreamVisibility();
 }
 
 void LiveViewArea::hideEvent(QHideEvent *event)
@@ -114,7 +123,11 @@ void LiveViewArea::hideEvent(QHideEvent *event)
 //        }
 //    }
 
+    /* Spontaneous hide events come from the window system, e.g. when minimizing */
+    if (event->spontaneous())
+        m_isUnmapped = true;
     QDeclarativeView::hideEvent(event);
+    updateStreamVisibility();
 }
 
 /*
@@ -123,6 +136,43 @@ void LiveViewArea::setViewportHack()
     setViewport(new QGLWidget);
 }*/
 
+void LiveViewArea::updateStreamVisibility()
+{
+    bool viewVisible = isVisible() && !m_isUnmapped && !window()->isMinimized() && !isCoveredByFullScreenWindow();
+    QRectF visibleRect = mapToScene(viewport()->rect()).boundingRect();
+
+    foreach (QGraphicsItem *item, scene()->items())
+    {
+        LiveStreamItem *streamItem = qobject_cast<LiveStreamItem*>(item->toGraphicsObject());
+        if (!streamItem)
+            continue;
+
+        streamItem->setViewVisible(viewVisible && streamItem->isVisible()
+                                   && streamItem->sceneBoundingRect().intersects(visibleRect));
+    }
+}
+
+bool LiveViewArea::isCoveredByFullScreenWindow() const
+{
+    /* Stacking order is unknown; a full screen window is assumed to be above any
+     * normal window on its screen, and two full screen windows to be both visible */
+    QWidget *ownWindow = window();
+    if (ownWindow->isFullScreen())
+        return false;
+
+    QDesktopWidget *desktop = QApplication::desktop();
+    int screen = desktop->screenNumber(ownWindow);
+
+    foreach (QWidget *widget, QApplication::topLevelWidgets())
+    {
+        if (widget != ownWindow && widget->isVisible() && widget->isFullScreen() && !widget->isMinimized()
+            && desktop->screenNumber(widget) == screen)
+            return true;
+    }
+
+    return false;
+}
+
 void LiveViewArea::addCamera(DVRCamera *camera)
 {
     QDeclarativeItem *item = m_layout->addItemAuto();
@@ -19,6 +19,7 @@
 #define LIVEVIEWAREA_H
 
 #include <QDeclarativeView>
+#include <QTimer>
 
 class LiveViewLayout;
 class DVRCamera;
@@ -54,10 +55,18 @@ protected:
 
 private slots:
     //void setViewportHack();
+    /* Tells every LiveStreamItem whether it can be seen; see LiveStream::setConsumerVisible() */
+    void updateStreamVisibility();
 
 private:
     LiveViewLayout *m_layout;
     mutable QSize m_sizeHint;
+    /* Layout changes and windows covering this one have no event, so visibility is also polled */
+    QTimer m_visibilityTimer;
+    /* Minimized or on another virtual desktop */
+    bool m_isUnmapped;
+
+    bool isCoveredByFullScreenWindow() const;
 };
 
 #endif // LIVEVIEWAREA_H
@@ -28,11 +28,29 @@ ImageDecodeTask::ImageDecodeTask(QObject *caller, const char *callback, quint64
 {
 }
 
+int ImageDecodeTask::scaleDivisor(const QSize &imageSize, const QSize &hint)
+{
+    if (!imageSize.isValid() || !hint.isValid() || hint.isEmpty())
+        return 1;
+
+    for (int divisor = 8; divisor > 1; divisor /= 2)
+    {
+        /* Scaled JPEG dimensions are rounded up */
+        if ((imageSize.width() + divisor - 1) / divisor >= hint.width() &&
+            (imageSize.height() + divisor - 1) / divisor >= hint.height())
+            return divisor;
+    }
+
+    return 1;
+}
+
 void ImageDecodeTask::runTask()
 {
     if (isCancelled() || m_data.isNull())
     {
         m_data.clear();
+        m_dataBuffer.clear();
+        m_outputImage = QImage();
         return;
     }
 
@@ -41,6 +59,8 @@ void ImageDecodeTask::runTask()
     {
         qDebug() << "Image decoding buffer error:" << buffer.errorString();
         m_data.clear();
+        m_dataBuffer.clear();
+        m_outputImage = QImage();
         return;
     }
 
@@ -49,10 +69,23 @@ void ImageDecodeTask::runTask()
      * Qt 4.6.2 on Ubuntu 10.04. Disabled for now as a result. Issue #473 */
     //reader.setAutoDetectImageFormat(false);
 
+    /* The size comes from the image header, without decoding */
+    m_imageSize = reader.size();
+    int divisor = scaleDivisor(m_imageSize, m_scaleHint);
+    if (divisor > 1 && reader.supportsOption(QImageIOHandler::ScaledSize))
+        reader.setScaledSize(QSize((m_imageSize.width() + divisor - 1) / divisor,
+                                   (m_imageSize.height() + divisor - 1) / divisor));
+
+    /* Without a header, the output image would be returned unchanged */
+    if (m_imageSize.isValid())
+        m_result = m_outputImage;
+    m_outputImage = QImage();
+
     bool ok = reader.read(&m_result);
 
     buffer.close();
     m_data.clear();
+    m_dataBuffer.clear();
 
     if (!ok)
     {
@@ -20,6 +20,7 @@
 
 #include "ThreadTask.h"
 #include <QImage>
+#include <QSharedPointer>
 #include <QVector>
 
 class ImageDecodeTask : public ThreadTask
@@ -30,15 +31,39 @@ public:
     ImageDecodeTask(QObject *caller, const char *callback, quint64 imageId = 0);
 
     void setData(const QByteArray &data) { m_data = data; }
+    /* For data that does not own its bytes, e.g. from QByteArray::fromRawData();
+     * buffer holds them and is kept until decoding is done */
+    void setData(const QByteArray &data, const QSharedPointer<QByteArray> &buffer)
+    {
+        m_data = data;
+        m_dataBuffer = buffer;
+    }
+
+    /* Decodes at 1/2, 1/4 or 1/8 of the full size, as long as the image still covers
+     * size; JPEG does this while decoding, which costs a fraction of a full decode.
+     * An invalid size decodes at full size. */
+    void setScaleHint(const QSize &size) { m_scaleHint = size; }
+    /* Decodes into image instead of allocating a new one, if it is not shared and
+     * already has the size and format of the result */
+    void setOutputImage(const QImage &image) { m_outputImage = image; }
 
     QImage result() const { return m_result; }
+    /* Full size of the image, which result() may be a fraction of */
+    QSize imageSize() const { return m_imageSize; }
+
+    /* 1, 2, 4 or 8; the largest divisor that keeps imageSize at least as large as hint */
+    static int scaleDivisor(const QSize &imageSize, const QSize &hint);
 
 protected:
     virtual void runTask();
 
 private:
     QByteArray m_data;
+    QSharedPointer<QByteArray> m_dataBuffer;
     QImage m_result;
+    QImage m_outputImage;
+    QSize m_scaleHint;
+    QSize m_imageSize;
 };
 
 #endif // IMAGEDECODETASK_H
@@ -17,16 +17,16 @@
 
 #include "ThreadTask.h"
 #include "ThreadTaskCourier.h"
-#include <QApplication>
+#include <QThread>
 
 ThreadTask::ThreadTask(QObject *caller, const char *callback)
-	: taskCaller(caller), taskCallback(callback), cancelFlag(false)
+	: taskCaller(caller), taskCallback(callback), taskCourier(0), cancelFlag(false)
 {
-	/* This restriction could be removed by making the courier thread-local */
-	Q_ASSERT(caller->thread() == qApp->thread());
+	/* Results are delivered by the courier of the caller's thread */
+	Q_ASSERT(caller->thread() == QThread::currentThread());
 
 	setAutoDelete(false);
-	ThreadTaskCourier::addTask(caller);
+	taskCourier = ThreadTaskCourier::addTask(caller);
 }
 
 void ThreadTask::run()
@@ -35,3 +35,9 @@ void ThreadTask::run()
 	runTask();
 	ThreadTaskCourier::notify(this);
 }
+
+void ThreadTask::discard()
+{
+	cancelFlag = true;
+	ThreadTaskCourier::notify(this);
+}
@@ -34,11 +34,16 @@ class ThreadTaskCourier;
  * The ThreadTask instance is passed to the caller as the result (via a meta-method
  * invocation of the callback function), who is expected to know how to cast the object
  * and retrieve the result from the subclass. The caller may be destroyed at any time,
- * and this object will be freed by the courier. */
+ * and this object will be freed by the courier.
+ *
+ * Tasks must be created on the thread of their caller, which must run an event loop;
+ * the callback is invoked on that thread. They are started on a QThreadPool, or on one
+ * of the pools of ThreadTaskExecutor. */
 
 class ThreadTask : public QRunnable
 {
 	friend class ThreadTaskCourier;
+	friend class ThreadTaskExecutor;
 
 public:
 	ThreadTask(QObject *caller, const char *callback);
@@ -53,7 +58,11 @@ protected:
 private:
 	QObject *taskCaller;
 	const char *taskCallback;
+	ThreadTaskCourier *taskCourier;
 	volatile bool cancelFlag;
+
+	/* Cancels the task and delivers it to the caller without running it */
+	void discard();
 };
 
 #endif
@@ -22,40 +22,67 @@
 #include <QMetaObject>
 #include <QMetaType>
 
-ThreadTaskCourier *ThreadTaskCourier::instance = NULL;
+QHash<QThread*,ThreadTaskCourier*> ThreadTaskCourier::couriers;
+QMutex ThreadTaskCourier::couriersLock;
 
-ThreadTaskCourier::ThreadTaskCourier()
+ThreadTaskCourier::ThreadTaskCourier(QThread *thread)
+	: inFlight(0), finished(false), orphaned(false)
 {
 	qRegisterMetaType<ThreadTask*>("ThreadTask*");
+	connect(thread, SIGNAL(finished()), this, SLOT(threadFinished()), Qt::DirectConnection);
 }
 
-void ThreadTaskCourier::addTask(QObject *caller)
+ThreadTaskCourier *ThreadTaskCourier::addTask(QObject *caller)
 {
-	Q_ASSERT(QThread::currentThread() == qApp->thread());
-	Q_ASSERT(caller->thread() == qApp->thread());
-	if (!instance)
-		instance = new ThreadTaskCourier;
+	Q_ASSERT(caller->thread() == QThread::currentThread());
+
+	ThreadTaskCourier *instance;
+	{
+		QMutexLocker locker(&couriersLock);
+		instance = couriers.value(QThread::currentThread());
+		if (!instance)
+		{
+			instance = new ThreadTaskCourier(QThread::currentThread());
+			couriers.insert(QThread::currentThread(), instance);
+		}
+		instance->inFlight++;
+	}
 
 	QHash<QObject*,int>::iterator it = instance->pending.find(caller);
 	if (it != instance->pending.end())
 	{
 		(*it)++;
-		return;
+		return instance;
 	}
 
 	instance->pending.insert(caller, 1);
 	connect(caller, SIGNAL(destroyed()), instance, SLOT(objectDestroyed()), Qt::DirectConnection);
+	return instance;
 }
 
 void ThreadTaskCourier::notify(ThreadTask *task)
 {
-	Q_ASSERT(instance);
-	
-	bool ok = QMetaObject::invokeMethod(instance, "deliverNotify", Qt::QueuedConnection,
-										Q_ARG(ThreadTask*,task));
+	ThreadTaskCourier *courier = task->taskCourier;
+	Q_ASSERT(courier);
 
-	Q_ASSERT(ok);
-	Q_UNUSED(ok);
+	QMutexLocker locker(&couriersLock);
+	if (!courier->finished)
+	{
+		bool ok = QMetaObject::invokeMethod(courier, "deliverNotify", Qt::QueuedConnection,
+											Q_ARG(ThreadTask*,task));
+
+		Q_ASSERT(ok);
+		Q_UNUSED(ok);
+		return;
+	}
+
+	/* Nobody is left to take the result */
+	bool last = --courier->inFlight == 0 && courier->orphaned;
+	locker.unlock();
+
+	delete task;
+	if (last)
+		delete courier;
 }
 
 void ThreadTaskCourier::deliverNotify(ThreadTask *task)
@@ -67,6 +94,9 @@ void ThreadTaskCourier::deliverNotify(ThreadTask *task)
 	{
 		/* Caller has probably been deleted already */
 		delete task;
+
+		QMutexLocker locker(&couriersLock);
+		inFlight--;
 		return;
 	}
 
@@ -83,9 +113,33 @@ void ThreadTaskCourier::deliverNotify(ThreadTask *task)
 		(*it)--;
 
 	delete task;
+
+	QMutexLocker locker(&couriersLock);
+	inFlight--;
 }
 
 void ThreadTaskCourier::objectDestroyed()
 {
 	pending.remove(sender());
 }
+
+void ThreadTaskCourier::threadFinished()
+{
+	/* Called on the finishing thread. Results that arrived until now still go out;
+	 * later ones are dropped by notify(). */
+	QMutexLocker locker(&couriersLock);
+	couriers.remove(thread());
+	finished = true;
+	locker.unlock();
+
+	QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+
+	/* Whoever sees the last task gone deletes the courier */
+	locker.relock();
+	orphaned = true;
+	bool idle = !inFlight;
+	locker.unlock();
+
+	if (idle)
+		deleteLater();
+}
@@ -20,9 +20,15 @@
 
 #include <QObject>
 #include <QHash>
+#include <QMutex>
 
+class QThread;
 class ThreadTask;
 
+/* Delivers results of thread tasks to their callers. There is one courier for every
+ * thread that creates tasks, living on that thread. When the thread finishes, results
+ * that are waiting are delivered and its courier is removed; tasks still running then
+ * are deleted as they finish, and the last of them deletes the courier. */
 class ThreadTaskCourier : public QObject
 {
 	Q_OBJECT
@@ -33,14 +39,22 @@ class ThreadTaskCourier : public QObject
 private slots:
 	void deliverNotify(ThreadTask *task);
 	void objectDestroyed();
+	void threadFinished();
 
 private:
-	static ThreadTaskCourier *instance;
+	static QHash<QThread*,ThreadTaskCourier*> couriers;
+	static QMutex couriersLock;
 	QHash<QObject*,int> pending;
+	/* Under couriersLock: tasks not delivered yet; set when the thread finishes, and
+	 * once the results waiting then are delivered */
+	int inFlight;
+	bool finished;
+	bool orphaned;
 
-	ThreadTaskCourier();
+	explicit ThreadTaskCourier(QThread *thread);
 
-	static void addTask(QObject *caller);
+	/* Returns the courier of the current thread */
+	static ThreadTaskCourier *addTask(QObject *caller);
 	static void notify(ThreadTask *task);
 };
 
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadTaskExecutor.h"
+#include "ThreadTask.h"
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+class ThreadTaskExecutor::Job : public QRunnable
+{
+public:
+	Job(ThreadTaskExecutor *executor, ThreadTask *task, Pool pool, bool latestOnly)
+		: executor(executor), task(task), pool(pool), latestOnly(latestOnly)
+	{
+	}
+
+	virtual void run()
+	{
+		executor->runJob(task, pool, latestOnly);
+	}
+
+private:
+	ThreadTaskExecutor *executor;
+	ThreadTask *task;
+	Pool pool;
+	bool latestOnly;
+};
+
+ThreadTaskExecutor::Metrics::Metrics()
+	: maxThreadCount(0), running(0), queued(0), waiting(0), peakQueueDepth(0), started(0), coalesced(0)
+{
+}
+
+ThreadTaskExecutor *ThreadTaskExecutor::m_instance = 0;
+
+void ThreadTaskExecutor::init()
+{
+	Q_ASSERT(!QCoreApplication::instance() ||
+			 QThread::currentThread() == QCoreApplication::instance()->thread());
+	if (!m_instance)
+		m_instance = new ThreadTaskExecutor;
+}
+
+ThreadTaskExecutor *ThreadTaskExecutor::instance()
+{
+	Q_ASSERT(m_instance);
+	return m_instance;
+}
+
+ThreadTaskExecutor::ThreadTaskExecutor()
+{
+	m_pools[FrameDecodePool] = new QThreadPool;
+	m_pools[FrameDecodePool]->setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+	m_pools[BackgroundPool] = QThreadPool::globalInstance();
+}
+
+const char *ThreadTaskExecutor::poolName(Pool pool)
+{
+	switch (pool)
+	{
+	case FrameDecodePool: return "frameDecode";
+	case BackgroundPool: return "background";
+	default: return "";
+	}
+}
+
+void ThreadTaskExecutor::start(ThreadTask *task, Pool pool, Priority priority, Coalescing coalescing)
+{
+	Q_ASSERT(pool >= 0 && pool < PoolCount);
+
+	QMutexLocker locker(&m_lock);
+
+	if (coalescing == LatestOnly)
+	{
+		CallerState &state = m_callers[pool][task->taskCaller];
+		if (state.inFlight)
+		{
+			Metrics &metrics = m_metrics[pool];
+			if (state.waiting)
+			{
+				state.waiting->discard();
+				metrics.coalesced++;
+			}
+			else
+				metrics.waiting++;
+
+			state.waiting = task;
+			state.waitingPriority = priority;
+			metrics.peakQueueDepth = qMax(metrics.peakQueueDepth, metrics.queueDepth());
+			return;
+		}
+
+		state.inFlight = true;
+	}
+
+	submit(task, pool, priority, coalescing == LatestOnly);
+}
+
+void ThreadTaskExecutor::submit(ThreadTask *task, Pool pool, Priority priority, bool latestOnly)
+{
+	Metrics &metrics = m_metrics[pool];
+	metrics.queued++;
+	metrics.peakQueueDepth = qMax(metrics.peakQueueDepth, metrics.queueDepth());
+
+	m_pools[pool]->start(new Job(this, task, pool, latestOnly), priority);
+}
+
+void ThreadTaskExecutor::runJob(ThreadTask *task, Pool pool, bool latestOnly)
+{
+	const QObject *caller = task->taskCaller;
+
+	m_lock.lock();
+	m_metrics[pool].queued--;
+	m_metrics[pool].running++;
+	m_metrics[pool].started++;
+	m_lock.unlock();
+
+	task->run();
+	/* The courier may delete the task from here on */
+
+	QMutexLocker locker(&m_lock);
+	m_metrics[pool].running--;
+
+	if (!latestOnly)
+		return;
+
+	QHash<const QObject*,CallerState>::iterator it = m_callers[pool].find(caller);
+	Q_ASSERT(it != m_callers[pool].end());
+
+	if (it->waiting)
+	{
+		ThreadTask *next = it->waiting;
+		it->waiting = 0;
+		m_metrics[pool].waiting--;
+		submit(next, pool, it->waitingPriority, true);
+	}
+	else
+		m_callers[pool].erase(it);
+}
+
+void ThreadTaskExecutor::setMaxThreadCount(Pool pool, int count)
+{
+	Q_ASSERT(pool >= 0 && pool < PoolCount);
+	m_pools[pool]->setMaxThreadCount(qMax(1, count));
+}
+
+ThreadTaskExecutor::Metrics ThreadTaskExecutor::metrics(Pool pool) const
+{
+	Q_ASSERT(pool >= 0 && pool < PoolCount);
+
+	QMutexLocker locker(&m_lock);
+	Metrics metrics = m_metrics[pool];
+	metrics.maxThreadCount = m_pools[pool]->maxThreadCount();
+	return metrics;
+}
+
+QVariantMap ThreadTaskExecutor::diagnostics() const
+{
+	QVariantMap pools;
+	for (int i = 0; i < PoolCount; ++i)
+	{
+		Metrics poolMetrics = metrics(Pool(i));
+
+		QVariantMap map;
+		map.insert(QLatin1String("maxThreadCount"), poolMetrics.maxThreadCount);
+		map.insert(QLatin1String("running"), poolMetrics.running);
+		map.insert(QLatin1String("queued"), poolMetrics.queued);
+		map.insert(QLatin1String("waiting"), poolMetrics.waiting);
+		map.insert(QLatin1String("peakQueueDepth"), poolMetrics.peakQueueDepth);
+		map.insert(QLatin1String("started"), poolMetrics.started);
+		map.insert(QLatin1String("coalesced"), poolMetrics.coalesced);
+		pools.insert(QLatin1String(poolName(Pool(i))), map);
+	}
+
+	return pools;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2010-2019 Bluecherry, LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THREADTASKEXECUTOR_H
+#define THREADTASKEXECUTOR_H
+
+#include <QHash>
+#include <QMutex>
+#include <QVariantMap>
+
+class QThreadPool;
+class ThreadTask;
+
+/* Runs thread tasks on separate, bounded thread pools, so that a burst of one kind of
+ * work (e.g. decoding frames of many MJPEG streams) can not hold up another (e.g.
+ * parsing events), and the other way around.
+ *
+ * With LatestOnly, at most one task of a caller is running and one is waiting behind it.
+ * A newer task replaces the waiting one, which is cancelled and delivered to its caller
+ * without having run; callers must expect results of cancelled tasks to be empty.
+ *
+ * Background tasks share QThreadPool::globalInstance() with QtConcurrent::run. */
+class ThreadTaskExecutor
+{
+	Q_DISABLE_COPY(ThreadTaskExecutor)
+
+public:
+	enum Pool
+	{
+		FrameDecodePool,
+		BackgroundPool,
+		PoolCount
+	};
+
+	enum Priority
+	{
+		LowPriority = -1,
+		NormalPriority = 0,
+		HighPriority = 1
+	};
+
+	enum Coalescing
+	{
+		RunAll,
+		LatestOnly
+	};
+
+	struct Metrics
+	{
+		int maxThreadCount;
+		/* Tasks currently running */
+		int running;
+		/* Tasks handed to the pool, waiting for a thread */
+		int queued;
+		/* LatestOnly tasks waiting for an earlier task of their caller */
+		int waiting;
+		int peakQueueDepth;
+		int started;
+		int coalesced;
+
+		Metrics();
+		int queueDepth() const { return queued + waiting; }
+	};
+
+	/* Creates the executor; on the GUI thread at startup, before any task is started.
+	 * instance() is reached from other threads too and does not create it. */
+	static void init();
+	static ThreadTaskExecutor *instance();
+
+	void start(ThreadTask *task, Pool pool, Priority priority = NormalPriority, Coalescing coalescing = RunAll);
+
+	void setMaxThreadCount(Pool pool, int count);
+	Metrics metrics(Pool pool) const;
+	QVariantMap diagnostics() const;
+
+	static const char *poolName(Pool pool);
+
+private:
+	class Job;
+	friend class Job;
+
+	struct CallerState
+	{
+		/* A task of the caller is queued or running */
+		bool inFlight;
+		ThreadTask *waiting;
+		Priority waitingPriority;
+
+		CallerState() : inFlight(false), waiting(0), waitingPriority(NormalPriority) {}
+	};
+
+	static ThreadTaskExecutor *m_instance;
+
+	mutable QMutex m_lock;
+	QThreadPool *m_pools[PoolCount];
+	Metrics m_metrics[PoolCount];
+	QHash<const QObject*,CallerState> m_callers[PoolCount];
+
+	ThreadTaskExecutor();
+
+	/* Called with m_lock held */
+	void submit(ThreadTask *task, Pool pool, Priority priority, bool latestOnly);
+	/* Runs on a thread of the pool */
+	void runJob(ThreadTask *task, Pool pool, bool latestOnly);
+};
+
+#endif
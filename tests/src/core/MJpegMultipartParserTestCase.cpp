@@ -0,0 +1,225 @@
+#include "core/MJpegMultipartParser.h"
+#include <QtTest/QtTest>
+#include <QFile>
+#include <QList>
+
+const char *jpegFormatName = "jpeg"; // hack
+
+class MJpegMultipartParserTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testParts_data();
+    void testParts();
+    void testPartsOutliveBuffer();
+    void testFalseBoundary();
+    void testMaximumSize();
+    void testClear();
+
+    void benchmarkParse_data();
+    void benchmarkParse();
+
+};
+
+static QByteArray createFrame(int n, int size)
+{
+    QByteArray frame(size, Qt::Uninitialized);
+    frame[0] = char(0xff);
+    for (int i = 1; i < size; ++i)
+        frame[i] = char((n * 7 + i * 13) % 251);
+    return frame;
+}
+
+/* A stream like the server sends, with some garbage before the first part */
+static QByteArray createStream(const QByteArray &boundary, bool contentLength, int count, QList<QByteArray> *frames)
+{
+    QByteArray stream("garbage\r\n--\r\n");
+    for (int n = 0; n < count; ++n)
+    {
+        QByteArray frame = createFrame(n, 2000 + n * 977);
+        if (frames)
+            frames->append(contentLength ? frame : frame + "\r\n");
+
+        stream.append(boundary + "\r\nContent-Type: image/jpeg\r\n");
+        if (contentLength)
+            stream.append("Content-Length: " + QByteArray::number(frame.size()) + "\r\n");
+        stream.append("\r\n" + frame + "\r\n");
+    }
+    stream.append(boundary + "\r\n");
+    return stream;
+}
+
+static QList<MJpegMultipartParser::Part> feed(MJpegMultipartParser &parser, const QByteArray &stream, int readSize)
+{
+    QList<MJpegMultipartParser::Part> parts;
+    for (int pos = 0; pos < stream.size(); pos += readSize)
+    {
+        if (!parser.append(stream.constData() + pos, qMin(readSize, stream.size() - pos)))
+            break;
+
+        MJpegMultipartParser::Part part;
+        while (parser.takePart(&part))
+            parts.append(part);
+    }
+    return parts;
+}
+
+void MJpegMultipartParserTestCase::testParts_data()
+{
+    QTest::addColumn<bool>("contentLength");
+    QTest::addColumn<int>("readSize");
+
+    const int readSizes[] = { 1, 7, 1400, 16384, 1024 * 1024 };
+    for (int i = 0; i < 5; ++i)
+    {
+        QTest::newRow(QByteArray("Content-Length, reads of " + QByteArray::number(readSizes[i])))
+                << true << readSizes[i];
+        QTest::newRow(QByteArray("boundary only, reads of " + QByteArray::number(readSizes[i])))
+                << false << readSizes[i];
+    }
+}
+
+void MJpegMultipartParserTestCase::testParts()
+{
+    QFETCH(bool, contentLength);
+    QFETCH(int, readSize);
+
+    QList<QByteArray> frames;
+    QByteArray stream = createStream("--myboundary", contentLength, 50, &frames);
+
+    MJpegMultipartParser parser;
+    parser.setBoundary("--myboundary");
+    QList<MJpegMultipartParser::Part> parts = feed(parser, stream, readSize);
+
+    QCOMPARE(parts.size(), frames.size());
+    for (int i = 0; i < parts.size(); ++i)
+        QCOMPARE(parts[i].data(), frames[i]);
+}
+
+void MJpegMultipartParserTestCase::testPartsOutliveBuffer()
+{
+    /* More than a single buffer; earlier parts stay valid after the parser moved on */
+    QList<QByteArray> frames;
+    QByteArray stream = createStream("--b", true, 200, &frames);
+
+    MJpegMultipartParser parser;
+    parser.setBoundary("--b");
+    QList<MJpegMultipartParser::Part> parts = feed(parser, stream, 4096);
+    /* Only the partial parts at the end of each buffer were copied */
+    QVERIFY(parser.copiedBytes() > 0);
+    QVERIFY(parser.copiedBytes() < stream.size() / 2);
+    parser.clear();
+
+    QCOMPARE(parts.size(), 200);
+    QCOMPARE(parts.first().data(), frames.first());
+    QCOMPARE(parts.last().data(), frames.last());
+}
+
+void MJpegMultipartParserTestCase::testFalseBoundary()
+{
+    MJpegMultipartParser parser;
+    parser.setBoundary("--b");
+
+    QByteArray stream("--bx--b\r\nContent-Length: 3\r\n\r\nabc\r\n--b\r\n");
+    QList<MJpegMultipartParser::Part> parts = feed(parser, stream, stream.size());
+
+    QCOMPARE(parts.size(), 1);
+    QCOMPARE(parts[0].data(), QByteArray("abc"));
+}
+
+void MJpegMultipartParserTestCase::testMaximumSize()
+{
+    MJpegMultipartParser parser(1000);
+    parser.setBoundary("--b");
+
+    QVERIFY(parser.append("--b\r\n\r\n", 7));
+    QVERIFY(!parser.append(QByteArray(2000, 'x').constData(), 2000));
+
+    int size = -1;
+    QVERIFY(!parser.writePointer(&size));
+    QCOMPARE(size, 0);
+}
+
+void MJpegMultipartParserTestCase::testClear()
+{
+    MJpegMultipartParser parser;
+    parser.setBoundary("--b");
+
+    QByteArray partial("--b\r\nContent-Length: 10\r\n\r\nabc");
+    QVERIFY(parser.append(partial.constData(), partial.size()));
+    QVERIFY(!parser.takePart(0));
+
+    parser.clear();
+    QByteArray stream("--b\r\n\r\ndef\r\n--b\r\n");
+    QList<MJpegMultipartParser::Part> parts = feed(parser, stream, stream.size());
+
+    QCOMPARE(parts.size(), 1);
+    QCOMPARE(parts[0].data(), QByteArray("def\r\n"));
+}
+
+/* Recorded streams can be added with BLUECHERRY_MJPEG_CAPTURES, a list of files
+ * separated by the path separator, e.g. from "curl -o capture.raw <mjpeg url>".
+ * The first line of a capture is taken as its boundary. */
+void MJpegMultipartParserTestCase::benchmarkParse_data()
+{
+    QTest::addColumn<QByteArray>("stream");
+    QTest::addColumn<QByteArray>("boundary");
+    QTest::addColumn<int>("readSize");
+
+    QByteArray withLength = createStream("--myboundary", true, 100, 0);
+    QByteArray withoutLength = createStream("--myboundary", false, 100, 0);
+    QTest::newRow("Content-Length, reads of 1400") << withLength << QByteArray("--myboundary") << 1400;
+    QTest::newRow("Content-Length, reads of 16384") << withLength << QByteArray("--myboundary") << 16384;
+    QTest::newRow("boundary only, reads of 1400") << withoutLength << QByteArray("--myboundary") << 1400;
+    QTest::newRow("boundary only, reads of 16384") << withoutLength << QByteArray("--myboundary") << 16384;
+
+    QString captures = QString::fromLocal8Bit(qgetenv("BLUECHERRY_MJPEG_CAPTURES"));
+#ifdef Q_OS_WIN
+    QStringList files = captures.split(QLatin1Char(';'), QString::SkipEmptyParts);
+#else
+    QStringList files = captures.split(QLatin1Char(':'), QString::SkipEmptyParts);
+#endif
+    foreach (const QString &fileName, files)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            qWarning() << "Cannot read capture" << fileName << file.errorString();
+            continue;
+        }
+
+        QByteArray stream = file.readAll();
+        QByteArray boundary = stream.left(stream.indexOf('\n')).trimmed();
+        QTest::newRow(QFile::encodeName(fileName)) << stream << boundary << 16384;
+    }
+}
+
+void MJpegMultipartParserTestCase::benchmarkParse()
+{
+    QFETCH(QByteArray, stream);
+    QFETCH(QByteArray, boundary);
+    QFETCH(int, readSize);
+
+    MJpegMultipartParser parser;
+    int parts = 0;
+
+    QBENCHMARK {
+        parser.setBoundary(boundary);
+        parts = 0;
+
+        for (int pos = 0; pos < stream.size(); pos += readSize)
+        {
+            parser.append(stream.constData() + pos, qMin(readSize, stream.size() - pos));
+
+            MJpegMultipartParser::Part part;
+            while (parser.takePart(&part))
+                ++parts;
+        }
+    }
+
+    QVERIFY(parts > 0);
+}
+
+QTEST_MAIN(MJpegMultipartParserTestCase)
+#include "MJpegMultipartParserTestCase.moc"
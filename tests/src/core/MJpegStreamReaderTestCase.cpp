@@ -0,0 +1,107 @@
+#include "core/MJpegStreamReader.h"
+#include "utils/ThreadTask.h"
+#include "utils/ThreadTaskExecutor.h"
+#include <QtTest/QtTest>
+#include <QBuffer>
+#include <QImage>
+#include <QSemaphore>
+
+const char *jpegFormatName = "jpeg"; // hack
+
+/* Holds the only thread of the frame decode pool until released */
+class BlockingTask : public ThreadTask
+{
+public:
+    BlockingTask(QObject *caller, QSemaphore *started, QSemaphore *block)
+        : ThreadTask(caller, "finished"), m_started(started), m_block(block)
+    {
+    }
+
+protected:
+    virtual void runTask()
+    {
+        m_started->release();
+        m_block->acquire();
+    }
+
+private:
+    QSemaphore *m_started;
+    QSemaphore *m_block;
+};
+
+class BlockingReceiver : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void finished(ThreadTask *task) { Q_UNUSED(task); }
+};
+
+class MJpegStreamReaderTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void testPartsOfCoalescedFrames();
+
+private:
+    static MJpegMultipartParser::Part encodeJpeg(const QSize &size, QRgb color);
+};
+
+MJpegMultipartParser::Part MJpegStreamReaderTestCase::encodeJpeg(const QSize &size, QRgb color)
+{
+    QImage image(size, QImage::Format_RGB32);
+    image.fill(color);
+
+    QSharedPointer<QByteArray> data(new QByteArray);
+    QBuffer buffer(data.data());
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "JPEG");
+
+    MJpegMultipartParser::Part part;
+    part.buffer = data;
+    part.length = data->size();
+    return part;
+}
+
+void MJpegStreamReaderTestCase::initTestCase()
+{
+    ThreadTaskExecutor::init();
+    ThreadTaskExecutor::instance()->setMaxThreadCount(ThreadTaskExecutor::FrameDecodePool, 1);
+}
+
+/* Frame 1 waits behind a slow decode, frame 3 replaces frame 2; discarding frame 2 must
+ * not lose the data of frame 1 */
+void MJpegStreamReaderTestCase::testPartsOfCoalescedFrames()
+{
+    QSemaphore started, block;
+    BlockingReceiver blockingReceiver;
+    ThreadTaskExecutor::instance()->start(new BlockingTask(&blockingReceiver, &started, &block),
+                                          ThreadTaskExecutor::FrameDecodePool);
+    started.acquire();
+
+    MJpegStreamReader reader;
+    QSignalSpy spy(&reader, SIGNAL(frameDecoded(QImage,QSize,float,MJpegMultipartParser::Part)));
+
+    QList<MJpegMultipartParser::Part> parts;
+    parts << encodeJpeg(QSize(64, 48), qRgb(200, 40, 40))
+          << encodeJpeg(QSize(64, 48), qRgb(40, 200, 40))
+          << encodeJpeg(QSize(64, 48), qRgb(40, 40, 200));
+    foreach (const MJpegMultipartParser::Part &part, parts)
+        reader.decodeFrame(part);
+
+    /* Delivers frame 2 as cancelled first */
+    QCoreApplication::processEvents();
+    block.release();
+
+    QTRY_COMPARE(spy.count(), 2);
+    MJpegMultipartParser::Part first = qvariant_cast<MJpegMultipartParser::Part>(spy.at(0).at(3));
+    MJpegMultipartParser::Part last = qvariant_cast<MJpegMultipartParser::Part>(spy.at(1).at(3));
+    QCOMPARE(first.data(), parts.at(0).data());
+    QCOMPARE(last.data(), parts.at(2).data());
+    QVERIFY(reader.m_decodingParts.isEmpty());
+}
+
+QTEST_MAIN(MJpegStreamReaderTestCase)
+#include "MJpegStreamReaderTestCase.moc"
@@ -0,0 +1,82 @@
+#include "rtsp-stream/RtspStreamDecoderThreadBudget.h"
+#include <QtTest/QtTest>
+#include <QDebug>
+
+const char *jpegFormatName = "jpeg"; // hack
+
+class RtspStreamDecoderThreadBudgetTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testSmallStreamsAreSingleThreaded();
+    void testLargeStreamGetsSpareCores();
+    void testRebalanceOnStreamChanges();
+    void testMeasuredLoad();
+
+};
+
+void RtspStreamDecoderThreadBudgetTestCase::testSmallStreamsAreSingleThreaded()
+{
+    RtspStreamDecoderThreadBudget budget(8);
+    int streams[40];
+
+    for (int i = 0; i < 40; ++i)
+        QCOMPARE(budget.addStream(&streams[i], 704, 480), 1);
+
+    for (int i = 0; i < 40; ++i)
+        QCOMPARE(budget.threadCount(&streams[i]), 1);
+}
+
+void RtspStreamDecoderThreadBudgetTestCase::testLargeStreamGetsSpareCores()
+{
+    RtspStreamDecoderThreadBudget budget(8);
+    int streams[2];
+
+    QCOMPARE(budget.addStream(&streams[0], 3840, 2160), 5);
+    QCOMPARE(budget.addStream(&streams[1], 1920, 1080), 2);
+    QCOMPARE(budget.threadCount(&streams[0]), 5);
+
+    /* Unknown streams are single threaded */
+    QCOMPARE(budget.threadCount(&budget), 1);
+}
+
+void RtspStreamDecoderThreadBudgetTestCase::testRebalanceOnStreamChanges()
+{
+    RtspStreamDecoderThreadBudget budget(4);
+    int streams[4];
+
+    QCOMPARE(budget.addStream(&streams[0], 3840, 2160), 4);
+
+    /* Every new stream takes one core away from the spare ones */
+    budget.addStream(&streams[1], 704, 480);
+    budget.addStream(&streams[2], 704, 480);
+    QCOMPARE(budget.threadCount(&streams[0]), 2);
+
+    budget.addStream(&streams[3], 704, 480);
+    QCOMPARE(budget.threadCount(&streams[0]), 1);
+
+    budget.removeStream(&streams[1]);
+    budget.removeStream(&streams[2]);
+    budget.removeStream(&streams[3]);
+    QCOMPARE(budget.threadCount(&streams[0]), 4);
+}
+
+void RtspStreamDecoderThreadBudgetTestCase::testMeasuredLoad()
+{
+    RtspStreamDecoderThreadBudget budget(8);
+    int stream;
+
+    QCOMPARE(budget.addStream(&stream, 1280, 720), 1);
+
+    /* A single thread busy 90% of the time needs a second one */
+    budget.setDecodeLoad(&stream, 0.9);
+    QCOMPARE(budget.threadCount(&stream), 2);
+
+    budget.setDecodeLoad(&stream, 0.1);
+    QCOMPARE(budget.threadCount(&stream), 1);
+}
+
+QTEST_MAIN(RtspStreamDecoderThreadBudgetTestCase)
+
+#include "RtspStreamDecoderThreadBudgetTestCase.moc"
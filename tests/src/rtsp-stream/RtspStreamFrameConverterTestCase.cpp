@@ -0,0 +1,234 @@
+#include "rtsp-stream/RtspStreamFrameConverter.h"
+#include "rtsp-stream/RtspStreamFrameConverter_p.h"
+#include <QtTest/QtTest>
+#include <QDebug>
+
+extern "C" {
+#   include "libavutil/frame.h"
+#   include "libswscale/swscale.h"
+}
+
+const char *jpegFormatName = "jpeg"; // hack
+
+class RtspStreamFrameConverterTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testKernelsMatchGeneric();
+    void testCanConvert();
+    void testFlatColor_data();
+    void testFlatColor();
+    void testMatchesSwscale();
+
+    void benchmarkConversion_data();
+    void benchmarkConversion();
+
+private:
+    AVFrame * createFrame(AVPixelFormat format, int width, int height, uint8_t y, uint8_t u, uint8_t v);
+
+};
+
+AVFrame * RtspStreamFrameConverterTestCase::createFrame(AVPixelFormat format, int width, int height,
+                                                        uint8_t y, uint8_t u, uint8_t v)
+{
+    AVFrame *frame = av_frame_alloc();
+    frame->format = format;
+    frame->width = width;
+    frame->height = height;
+    av_frame_get_buffer(frame, 32);
+
+    for (int row = 0; row < height; ++row)
+        memset(frame->data[0] + row * frame->linesize[0], y, width);
+
+    for (int row = 0; row < (height + 1) / 2; ++row)
+    {
+        if (format == AV_PIX_FMT_NV12)
+        {
+            uint8_t *uv = frame->data[1] + row * frame->linesize[1];
+            for (int x = 0; x < (width + 1) / 2; ++x)
+            {
+                uv[2 * x] = u;
+                uv[2 * x + 1] = v;
+            }
+        }
+        else
+        {
+            memset(frame->data[1] + row * frame->linesize[1], u, (width + 1) / 2);
+            memset(frame->data[2] + row * frame->linesize[2], v, (width + 1) / 2);
+        }
+    }
+
+    return frame;
+}
+
+void RtspStreamFrameConverterTestCase::testKernelsMatchGeneric()
+{
+    RtspStreamConverterKernels kernels[4];
+    int count = rtspStreamSupportedConverterKernels(kernels, 4);
+    QVERIFY(count >= 1);
+    qDebug() << "Selected kernels:" << RtspStreamFrameConverter::kernelName();
+
+    const int maxWidth = 333;
+    QVector<uint8_t> y(maxWidth), u(maxWidth), v(maxWidth), row0(2 * maxWidth), row1(2 * maxWidth);
+    QVector<uint8_t> expected(4 * maxWidth), actual(4 * maxWidth);
+
+    qsrand(1);
+    for (int i = 0; i < maxWidth; ++i)
+    {
+        y[i] = qrand();
+        u[i] = qrand();
+        v[i] = qrand();
+    }
+    for (int i = 0; i < 2 * maxWidth; ++i)
+    {
+        row0[i] = qrand();
+        row1[i] = qrand();
+    }
+
+    /* Odd widths exercise the scalar tails of the SIMD kernels */
+    for (int k = 1; k < count; ++k)
+    {
+        for (int width = 1; width <= maxWidth; width += 7)
+        {
+            rtspStreamConvertRowGeneric(y.constData(), u.constData(), v.constData(), expected.data(), width);
+            kernels[k].convertRow(y.constData(), u.constData(), v.constData(), actual.data(), width);
+            QVERIFY2(!memcmp(expected.constData(), actual.constData(), 4 * width), kernels[k].name);
+
+            rtspStreamReduceRowGeneric(row0.constData(), row1.constData(), expected.data(), width);
+            kernels[k].reduceRow(row0.constData(), row1.constData(), actual.data(), width);
+            QVERIFY2(!memcmp(expected.constData(), actual.constData(), width), kernels[k].name);
+        }
+    }
+}
+
+void RtspStreamFrameConverterTestCase::testCanConvert()
+{
+    QVERIFY(RtspStreamFrameConverter::canConvert(AV_PIX_FMT_YUV420P, 1920, 1080, 960, 540));
+    QVERIFY(RtspStreamFrameConverter::canConvert(AV_PIX_FMT_YUVJ420P, 704, 480, 704, 480));
+    QVERIFY(RtspStreamFrameConverter::canConvert(AV_PIX_FMT_NV12, 1280, 720, 333, 187));
+    QVERIFY(!RtspStreamFrameConverter::canConvert(AV_PIX_FMT_YUV422P, 1280, 720, 640, 360));
+    QVERIFY(!RtspStreamFrameConverter::canConvert(AV_PIX_FMT_YUV420P, 640, 360, 1280, 720));
+    QVERIFY(!RtspStreamFrameConverter::canConvert(AV_PIX_FMT_YUV420P, 640, 360, 0, 0));
+}
+
+void RtspStreamFrameConverterTestCase::testFlatColor_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<int>("dstWidth");
+    QTest::addColumn<int>("dstHeight");
+
+    QTest::newRow("full size") << int(AV_PIX_FMT_YUV420P) << 64 << 48;
+    QTest::newRow("half size") << int(AV_PIX_FMT_YUV420P) << 32 << 24;
+    QTest::newRow("quarter size") << int(AV_PIX_FMT_YUV420P) << 16 << 12;
+    QTest::newRow("bilinear") << int(AV_PIX_FMT_YUV420P) << 37 << 21;
+    QTest::newRow("nv12 half size") << int(AV_PIX_FMT_NV12) << 32 << 24;
+    QTest::newRow("nv12 bilinear") << int(AV_PIX_FMT_NV12) << 37 << 21;
+}
+
+void RtspStreamFrameConverterTestCase::testFlatColor()
+{
+    QFETCH(int, format);
+    QFETCH(int, dstWidth);
+    QFETCH(int, dstHeight);
+
+    const uint8_t y = 81, u = 90, v = 240;
+    AVFrame *frame = createFrame((AVPixelFormat) format, 64, 48, y, u, v);
+
+    uint8_t expected[4];
+    rtspStreamConvertRowGeneric(&y, &u, &v, expected, 1);
+
+    QVector<uint8_t> image(4 * dstWidth * dstHeight);
+    RtspStreamFrameConverter converter;
+    QVERIFY(converter.convert(frame, image.data(), 4 * dstWidth, dstWidth, dstHeight));
+
+    for (int i = 0; i < dstWidth * dstHeight; ++i)
+        QVERIFY(!memcmp(image.constData() + 4 * i, expected, 4));
+
+    av_frame_free(&frame);
+}
+
+void RtspStreamFrameConverterTestCase::testMatchesSwscale()
+{
+    const int width = 64, height = 48;
+    const int tolerance = 3;
+
+    for (int color = 16; color < 240; color += 37)
+    {
+        AVFrame *frame = createFrame(AV_PIX_FMT_YUV420P, width, height, color, 255 - color, color);
+
+        QVector<uint8_t> converted(4 * width * height), scaled(4 * width * height);
+        RtspStreamFrameConverter converter;
+        QVERIFY(converter.convert(frame, converted.data(), 4 * width, width, height));
+
+        SwsContext *context = sws_getContext(width, height, AV_PIX_FMT_YUV420P, width, height, AV_PIX_FMT_BGRA,
+                                             SWS_FAST_BILINEAR, NULL, NULL, NULL);
+        uint8_t *dst[4] = { scaled.data(), 0, 0, 0 };
+        int dstStride[4] = { 4 * width, 0, 0, 0 };
+        sws_scale(context, (const uint8_t **)frame->data, frame->linesize, 0, height, dst, dstStride);
+        sws_freeContext(context);
+
+        for (int i = 0; i < converted.size(); ++i)
+            QVERIFY(qAbs(int(converted[i]) - int(scaled[i])) <= tolerance);
+
+        av_frame_free(&frame);
+    }
+}
+
+void RtspStreamFrameConverterTestCase::benchmarkConversion_data()
+{
+    QTest::addColumn<int>("srcWidth");
+    QTest::addColumn<int>("srcHeight");
+    QTest::addColumn<int>("divisor");
+    QTest::addColumn<bool>("swscale");
+
+    const int sizes[3][2] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int divisor = 1; divisor <= 4; divisor *= 2)
+        {
+            QByteArray name = QString::fromLatin1("%1p 1/%2").arg(sizes[i][1]).arg(divisor).toLatin1();
+            QTest::newRow(name + " converter") << sizes[i][0] << sizes[i][1] << divisor << false;
+            QTest::newRow(name + " swscale") << sizes[i][0] << sizes[i][1] << divisor << true;
+        }
+    }
+}
+
+void RtspStreamFrameConverterTestCase::benchmarkConversion()
+{
+    QFETCH(int, srcWidth);
+    QFETCH(int, srcHeight);
+    QFETCH(int, divisor);
+    QFETCH(bool, swscale);
+
+    const int dstWidth = srcWidth / divisor, dstHeight = srcHeight / divisor;
+    AVFrame *frame = createFrame(AV_PIX_FMT_YUV420P, srcWidth, srcHeight, 100, 120, 140);
+    QVector<uint8_t> image(4 * dstWidth * dstHeight);
+
+    if (swscale)
+    {
+        SwsContext *context = sws_getContext(srcWidth, srcHeight, AV_PIX_FMT_YUV420P, dstWidth, dstHeight,
+                                             AV_PIX_FMT_BGRA, SWS_FAST_BILINEAR, NULL, NULL, NULL);
+        uint8_t *dst[4] = { image.data(), 0, 0, 0 };
+        int dstStride[4] = { 4 * dstWidth, 0, 0, 0 };
+
+        QBENCHMARK {
+            sws_scale(context, (const uint8_t **)frame->data, frame->linesize, 0, srcHeight, dst, dstStride);
+        }
+
+        sws_freeContext(context);
+    }
+    else
+    {
+        RtspStreamFrameConverter converter;
+        QBENCHMARK {
+            converter.convert(frame, image.data(), 4 * dstWidth, dstWidth, dstHeight);
+        }
+    }
+
+    av_frame_free(&frame);
+}
+
+QTEST_MAIN(RtspStreamFrameConverterTestCase)
+
+#include "RtspStreamFrameConverterTestCase.moc"
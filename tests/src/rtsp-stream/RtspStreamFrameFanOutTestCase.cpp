@@ -0,0 +1,140 @@
+#include "rtsp-stream/RtspStreamFrameFanOut.h"
+#include <QtTest/QtTest>
+#include <QDebug>
+
+extern "C" {
+#   include "libavutil/frame.h"
+}
+
+const char *jpegFormatName = "jpeg"; // hack
+
+class RtspStreamFrameFanOutTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testStreamSizeWithoutConsumers();
+    void testSizePerConsumer();
+    void testSharedSize();
+    void testNoUpscaling();
+    void testHysteresis();
+    void testBucketsWhileResizing();
+
+private:
+    AVFrame *m_frame;
+    int m_consumers[2];
+
+};
+
+void RtspStreamFrameFanOutTestCase::init()
+{
+    m_frame = av_frame_alloc();
+    m_frame->format = AV_PIX_FMT_YUV420P;
+    m_frame->width = 640;
+    m_frame->height = 480;
+    av_frame_get_buffer(m_frame, 32);
+
+    memset(m_frame->data[0], 128, m_frame->linesize[0] * m_frame->height);
+    memset(m_frame->data[1], 128, m_frame->linesize[1] * m_frame->height / 2);
+    memset(m_frame->data[2], 128, m_frame->linesize[2] * m_frame->height / 2);
+}
+
+void RtspStreamFrameFanOutTestCase::cleanup()
+{
+    av_frame_free(&m_frame);
+}
+
+void RtspStreamFrameFanOutTestCase::testStreamSizeWithoutConsumers()
+{
+    RtspStreamFrameFanOut fanOut;
+    QVERIFY(fanOut.formatFrame(m_frame));
+
+    QCOMPARE(fanOut.streamSize(), QSize(640, 480));
+    QCOMPARE(fanOut.largestFrame().size(), QSize(640, 480));
+}
+
+void RtspStreamFrameFanOutTestCase::testSizePerConsumer()
+{
+    RtspStreamFrameFanOut fanOut;
+    fanOut.addConsumer(&m_consumers[0]);
+    fanOut.addConsumer(&m_consumers[1]);
+    fanOut.setFrameSizeHint(&m_consumers[0], QSize(320, 240));
+    fanOut.setFrameSizeHint(&m_consumers[1], QSize(200, 150));
+    QCOMPARE(fanOut.largestFrameSizeHint(), QSize(320, 240));
+
+    QVERIFY(fanOut.formatFrame(m_frame));
+    QCOMPARE(fanOut.frame(&m_consumers[0]).size(), QSize(320, 240));
+    QCOMPARE(fanOut.frame(&m_consumers[1]).size(), QSize(200, 150));
+
+    /* A consumer without a hint wants the stream size */
+    fanOut.setFrameSizeHint(&m_consumers[1], QSize());
+    QCOMPARE(fanOut.largestFrameSizeHint(), QSize());
+}
+
+void RtspStreamFrameFanOutTestCase::testSharedSize()
+{
+    RtspStreamFrameFanOut fanOut;
+    fanOut.setFrameSizeHint(&m_consumers[0], QSize(320, 240));
+    fanOut.setFrameSizeHint(&m_consumers[1], QSize(320, 240));
+    QVERIFY(fanOut.formatFrame(m_frame));
+
+    QCOMPARE(fanOut.frame(&m_consumers[0]).image().constBits(),
+             fanOut.frame(&m_consumers[1]).image().constBits());
+}
+
+void RtspStreamFrameFanOutTestCase::testNoUpscaling()
+{
+    RtspStreamFrameFanOut fanOut;
+    fanOut.setFrameSizeHint(&m_consumers[0], QSize(1280, 400));
+    QVERIFY(fanOut.formatFrame(m_frame));
+
+    QCOMPARE(fanOut.frame(&m_consumers[0]).size(), QSize(640, 400));
+}
+
+void RtspStreamFrameFanOutTestCase::testHysteresis()
+{
+    RtspStreamFrameFanOut fanOut;
+    fanOut.setFrameSizeHint(&m_consumers[0], QSize(320, 240));
+    QVERIFY(fanOut.formatFrame(m_frame));
+
+    /* Small changes keep the current size until the hint settles */
+    fanOut.setFrameSizeHint(&m_consumers[0], QSize(330, 248));
+    QVERIFY(fanOut.formatFrame(m_frame));
+    QCOMPARE(fanOut.frame(&m_consumers[0]).size(), QSize(320, 240));
+
+    QTest::qWait(300);
+    QVERIFY(fanOut.formatFrame(m_frame));
+    QCOMPARE(fanOut.frame(&m_consumers[0]).size(), QSize(330, 248));
+
+    /* Large changes apply right away, rounded up to a size bucket until the hint settles */
+    fanOut.setFrameSizeHint(&m_consumers[0], QSize(160, 120));
+    QVERIFY(fanOut.formatFrame(m_frame));
+    QCOMPARE(fanOut.frame(&m_consumers[0]).size(), QSize(160, 128));
+
+    QTest::qWait(300);
+    QVERIFY(fanOut.formatFrame(m_frame));
+    QCOMPARE(fanOut.frame(&m_consumers[0]).size(), QSize(160, 120));
+}
+
+void RtspStreamFrameFanOutTestCase::testBucketsWhileResizing()
+{
+    RtspStreamFrameFanOut fanOut;
+    fanOut.setFrameSizeHint(&m_consumers[0], QSize(320, 240));
+    fanOut.setFrameSizeHint(&m_consumers[1], QSize(320, 240));
+    QVERIFY(fanOut.formatFrame(m_frame));
+
+    /* Tiles resized together share a bucket, which is never above the stream size */
+    fanOut.setFrameSizeHint(&m_consumers[0], QSize(601, 470));
+    fanOut.setFrameSizeHint(&m_consumers[1], QSize(605, 465));
+    QVERIFY(fanOut.formatFrame(m_frame));
+    QCOMPARE(fanOut.frame(&m_consumers[0]).size(), QSize(608, 480));
+    QCOMPARE(fanOut.frame(&m_consumers[0]).image().constBits(),
+             fanOut.frame(&m_consumers[1]).image().constBits());
+}
+
+QTEST_MAIN(RtspStreamFrameFanOutTestCase)
+
+#include "RtspStreamFrameFanOutTestCase.moc"
@@ -0,0 +1,302 @@
+#include "rtsp-stream/RtspStreamFrame.h"
+#include "rtsp-stream/RtspStreamFrameQueue.h"
+#include <QtTest/QtTest>
+#include <QDebug>
+
+extern "C" {
+#   include "libavutil/frame.h"
+}
+
+const char *jpegFormatName = "jpeg"; // hack
+
+class RtspStreamFrameQueueTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testEmptyQueue();
+    void testFifoOrder();
+    void testSizeLimit();
+    void testClear();
+    void testNotification();
+    void testPresentationTime();
+    void testLateFramesSkipped();
+    void testDiscontinuity();
+    void testClockDrift();
+    void testLatencyTargetBoundedByDepth();
+    void testBackpressure();
+
+private:
+    RtspStreamFrame * createFrame(qint64 pts);
+
+};
+
+RtspStreamFrame * RtspStreamFrameQueueTestCase::createFrame(qint64 pts)
+{
+    AVFrame *avFrame = av_frame_alloc();
+    avFrame->pts = pts;
+    return new RtspStreamFrame(avFrame, 16, 16);
+}
+
+void RtspStreamFrameQueueTestCase::testEmptyQueue()
+{
+    RtspStreamFrameQueue queue(4);
+    QCOMPARE(queue.size(), 0);
+    QVERIFY(!queue.dequeue());
+
+    queue.enqueue(0);
+    QCOMPARE(queue.size(), 0);
+    QCOMPARE(queue.producedFrames(), 0);
+}
+
+void RtspStreamFrameQueueTestCase::testFifoOrder()
+{
+    RtspStreamFrameQueue queue(4);
+    queue.enqueue(createFrame(1));
+    queue.enqueue(createFrame(2));
+    queue.enqueue(createFrame(3));
+    QCOMPARE(queue.size(), 3);
+
+    for (qint64 pts = 1; pts <= 3; ++pts)
+    {
+        RtspStreamFrame *frame = queue.dequeue();
+        QVERIFY(frame);
+        QCOMPARE(frame->avFrame()->pts, pts);
+        delete frame;
+    }
+
+    QVERIFY(!queue.dequeue());
+    QCOMPARE(queue.producedFrames(), 3);
+    QCOMPARE(queue.displayedFrames(), 3);
+    QCOMPARE(queue.droppedFrames(), 0);
+}
+
+void RtspStreamFrameQueueTestCase::testSizeLimit()
+{
+    RtspStreamFrameQueue queue(3);
+    for (qint64 pts = 1; pts <= 10; ++pts)
+        queue.enqueue(createFrame(pts));
+
+    QCOMPARE(queue.size(), 3);
+    QCOMPARE(queue.producedFrames(), 10);
+    QCOMPARE(queue.droppedFrames(), 7);
+
+    /* Oldest frames are evicted, newest ones are kept */
+    RtspStreamFrame *frame = queue.dequeue();
+    QVERIFY(frame);
+    QCOMPARE(frame->avFrame()->pts, Q_INT64_C(8));
+    delete frame;
+}
+
+void RtspStreamFrameQueueTestCase::testClear()
+{
+    RtspStreamFrameQueue queue(3);
+    queue.enqueue(createFrame(1));
+    queue.enqueue(createFrame(2));
+    queue.clear();
+
+    QCOMPARE(queue.size(), 0);
+    QVERIFY(!queue.dequeue());
+    QCOMPARE(queue.droppedFrames(), 2);
+}
+
+void RtspStreamFrameQueueTestCase::testNotification()
+{
+    RtspStreamFrameQueue queue(3);
+    QVERIFY(!queue.enqueue(0));
+
+    /* Only the first frame after the consumer looked at the queue notifies it */
+    QVERIFY(queue.enqueue(createFrame(1)));
+    QVERIFY(!queue.enqueue(createFrame(2)));
+
+    delete queue.dequeue();
+    QVERIFY(queue.enqueue(createFrame(3)));
+
+    /* An empty dequeue also rearms the notification */
+    queue.clear();
+    QVERIFY(!queue.dequeue());
+    QVERIFY(queue.enqueue(createFrame(4)));
+}
+
+void RtspStreamFrameQueueTestCase::testPresentationTime()
+{
+    /* Millisecond timestamps, as used by some cameras instead of 90 kHz */
+    RtspStreamFrameQueue queue(8);
+    queue.setTimeBase(1, 1000);
+    queue.setLatencyProfile(RtspStreamFrameQueue::Smooth);
+    queue.setLatencyTarget(200);
+
+    queue.enqueue(createFrame(1000), 0);
+    queue.enqueue(createFrame(1040), 40000);
+    queue.enqueue(createFrame(1080), 80000);
+
+    QVERIFY(!queue.dequeue(100000));
+    QCOMPARE(queue.msecsToNextFrame(100000), 100);
+
+    for (qint64 pts = 1000; pts <= 1080; pts += 40)
+    {
+        qint64 now = (pts - 1000) * 1000 + 200000;
+        RtspStreamFrame *frame = queue.dequeue(now);
+        QVERIFY(frame);
+        QCOMPARE(frame->avFrame()->pts, pts);
+        delete frame;
+    }
+
+    QCOMPARE(queue.msecsToNextFrame(300000), -1);
+    QCOMPARE(queue.droppedFrames(), 0);
+}
+
+void RtspStreamFrameQueueTestCase::testLateFramesSkipped()
+{
+    RtspStreamFrameQueue queue(8);
+    queue.setTimeBase(1, 90000);
+    queue.setLatencyProfile(RtspStreamFrameQueue::LowestLatency);
+
+    queue.enqueue(createFrame(0), 0);
+    delete queue.dequeue(0);
+
+    /* A network stall delivers frames in a burst; only the newest one is shown */
+    queue.enqueue(createFrame(3600), 1000000);
+    queue.enqueue(createFrame(7200), 1000000);
+    queue.enqueue(createFrame(10800), 1000000);
+
+    RtspStreamFrame *frame = queue.dequeue(1000000);
+    QVERIFY(frame);
+    QCOMPARE(frame->avFrame()->pts, Q_INT64_C(10800));
+    delete frame;
+
+    QCOMPARE(queue.droppedFrames(), 2);
+    QCOMPARE(queue.discontinuities(), 0);
+}
+
+void RtspStreamFrameQueueTestCase::testDiscontinuity()
+{
+    RtspStreamFrameQueue queue(16);
+    queue.setTimeBase(1, 90000);
+    queue.setLatencyProfile(RtspStreamFrameQueue::Smooth);
+
+    queue.enqueue(createFrame(900000), 0);
+    delete queue.dequeue(200000);
+
+    /* Camera restarted; without a new mapping the frame would be due in ten seconds */
+    queue.enqueue(createFrame(0), 40000);
+    QVERIFY(!queue.dequeue(40000));
+    QCOMPARE(queue.msecsToNextFrame(40000), 200);
+    QCOMPARE(queue.discontinuities(), 1);
+
+    RtspStreamFrame *frame = queue.dequeue(240000);
+    QVERIFY(frame);
+    QCOMPARE(frame->avFrame()->pts, Q_INT64_C(0));
+    delete frame;
+}
+
+void RtspStreamFrameQueueTestCase::testClockDrift()
+{
+    RtspStreamFrameQueue queue(12);
+    queue.setTimeBase(1, 90000);
+    queue.setLatencyProfile(RtspStreamFrameQueue::Smooth);
+
+    /* The camera clock runs 1% fast: 25 fps by its clock, 24.75 fps by ours.
+     * Without correction frames would get late after 20 seconds. */
+    int frameNumber = 0;
+    qint64 nextArrival = 0;
+    qint64 latency = -1;
+    for (qint64 now = 0; now < 20000000; now += 4000)
+    {
+        while (nextArrival <= now)
+        {
+            queue.enqueue(createFrame(frameNumber * 3600), nextArrival);
+            nextArrival = qint64(++frameNumber) * 40400;
+        }
+
+        RtspStreamFrame *frame = queue.dequeue(now);
+        if (frame)
+        {
+            latency = now - frame->queueTime();
+            delete frame;
+        }
+    }
+
+    QVERIFY(latency > 120000);
+    QVERIFY(latency <= 200000);
+    QCOMPARE(queue.droppedFrames(), 0);
+}
+
+void RtspStreamFrameQueueTestCase::testLatencyTargetBoundedByDepth()
+{
+    RtspStreamFrameQueue queue(6);
+    queue.setTimeBase(1, 90000);
+    queue.setLatencyProfile(RtspStreamFrameQueue::Smooth);
+    queue.setLatencyTarget(2000);
+
+    /* At 25 fps, six slots less the headroom hold 160 ms; a longer wait would evict
+     * frames before they are due */
+    int frameNumber = 0;
+    qint64 nextArrival = 0;
+    qint64 latency = -1;
+    for (qint64 now = 0; now < 3000000; now += 4000)
+    {
+        while (nextArrival <= now)
+        {
+            queue.enqueue(createFrame(frameNumber * 3600), nextArrival);
+            nextArrival = qint64(++frameNumber) * 40000;
+        }
+
+        RtspStreamFrame *frame = queue.dequeue(now);
+        if (frame)
+        {
+            latency = now - frame->queueTime();
+            delete frame;
+        }
+    }
+
+    QVERIFY(latency > 120000);
+    QVERIFY(latency <= 160000);
+    QCOMPARE(queue.droppedFrames(), 0);
+    QCOMPARE(queue.latencyTarget(), 2000);
+}
+
+void RtspStreamFrameQueueTestCase::testBackpressure()
+{
+    RtspStreamFrameQueue queue(2);
+    QCOMPARE(queue.updateBackpressure(0), RtspStreamFrameQueue::NoBackpressure);
+
+    /* A single drop is jitter, not a consumer falling behind */
+    for (qint64 pts = 1; pts <= 3; ++pts)
+        queue.enqueue(createFrame(pts));
+    QCOMPARE(queue.updateBackpressure(1000000), RtspStreamFrameQueue::NoBackpressure);
+
+    /* Sustained drops raise the level once per window */
+    for (qint64 pts = 4; pts <= 8; ++pts)
+        queue.enqueue(createFrame(pts));
+    QCOMPARE(queue.updateBackpressure(1500000), RtspStreamFrameQueue::NoBackpressure);
+    QCOMPARE(queue.updateBackpressure(2000000), RtspStreamFrameQueue::SkipNonReferenceFrames);
+    QCOMPARE(queue.backpressure(), RtspStreamFrameQueue::SkipNonReferenceFrames);
+
+    for (qint64 pts = 9; pts <= 12; ++pts)
+        queue.enqueue(createFrame(pts));
+    QCOMPARE(queue.updateBackpressure(3000000), RtspStreamFrameQueue::SkipNonKeyframes);
+
+    for (qint64 pts = 13; pts <= 16; ++pts)
+        queue.enqueue(createFrame(pts));
+    QCOMPARE(queue.updateBackpressure(4000000), RtspStreamFrameQueue::SkipNonKeyframes);
+
+    /* Once the consumer keeps up, levels go down one recovery period at a time */
+    queue.clear();
+    queue.updateBackpressure(4000000);
+    QCOMPARE(queue.updateBackpressure(6500000), RtspStreamFrameQueue::SkipNonKeyframes);
+    QCOMPARE(queue.updateBackpressure(7000000), RtspStreamFrameQueue::SkipNonReferenceFrames);
+    QCOMPARE(queue.updateBackpressure(9000000), RtspStreamFrameQueue::SkipNonReferenceFrames);
+    QCOMPARE(queue.updateBackpressure(10000000), RtspStreamFrameQueue::NoBackpressure);
+
+    queue.frameSkipped(RtspStreamFrameQueue::SkipNonReferenceFrames);
+    queue.frameSkipped(RtspStreamFrameQueue::SkipNonKeyframes);
+    queue.frameSkipped(RtspStreamFrameQueue::SkipNonKeyframes);
+    queue.frameSkipped(RtspStreamFrameQueue::NoBackpressure);
+    QCOMPARE(queue.skippedNonReferenceFrames(), 1);
+    QCOMPARE(queue.skippedNonKeyframes(), 2);
+}
+
+QTEST_MAIN(RtspStreamFrameQueueTestCase)
+
+#include "RtspStreamFrameQueueTestCase.moc"
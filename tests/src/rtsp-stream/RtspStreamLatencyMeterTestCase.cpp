@@ -0,0 +1,101 @@
+#include "rtsp-stream/RtspStreamLatencyMeter.h"
+#include <QtTest/QtTest>
+
+const char *jpegFormatName = "jpeg"; // hack
+
+class RtspStreamLatencyMeterTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testEmpty();
+    void testPercentiles();
+    void testStagesMatchedByPts();
+    void testFirstPaintCounts();
+
+};
+
+void RtspStreamLatencyMeterTestCase::testEmpty()
+{
+    RtspStreamLatencyMeter meter;
+    RtspStreamLatencyMeter::Percentiles percentiles = meter.percentiles(RtspStreamLatencyMeter::Received,
+                                                                        RtspStreamLatencyMeter::Painted);
+    QCOMPARE(percentiles.samples, 0);
+    QCOMPARE(percentiles.max, Q_INT64_C(0));
+    QVERIFY(!meter.report().isEmpty());
+}
+
+void RtspStreamLatencyMeterTestCase::testPercentiles()
+{
+    RtspStreamLatencyMeter meter;
+
+    /* Frame n takes n ms from receiving to painting, for n = 1..100 */
+    for (qint64 n = 1; n <= 100; ++n)
+    {
+        qint64 received = n * 40000;
+        meter.mark(RtspStreamLatencyMeter::Received, n, received);
+        meter.mark(RtspStreamLatencyMeter::Decoded, n, received + 500);
+        meter.mark(RtspStreamLatencyMeter::Painted, n, received + n * 1000);
+    }
+
+    RtspStreamLatencyMeter::Percentiles total = meter.percentiles(RtspStreamLatencyMeter::Received,
+                                                                  RtspStreamLatencyMeter::Painted);
+    QCOMPARE(total.samples, 100);
+    QCOMPARE(total.median, Q_INT64_C(50000));
+    QCOMPARE(total.p90, Q_INT64_C(90000));
+    QCOMPARE(total.p99, Q_INT64_C(99000));
+    QCOMPARE(total.max, Q_INT64_C(100000));
+
+    RtspStreamLatencyMeter::Percentiles decode = meter.percentiles(RtspStreamLatencyMeter::Received,
+                                                                   RtspStreamLatencyMeter::Decoded);
+    QCOMPARE(decode.samples, 100);
+    QCOMPARE(decode.max, Q_INT64_C(500));
+
+    meter.clear();
+    QCOMPARE(meter.percentiles(RtspStreamLatencyMeter::Received, RtspStreamLatencyMeter::Painted).samples, 0);
+}
+
+void RtspStreamLatencyMeterTestCase::testStagesMatchedByPts()
+{
+    RtspStreamLatencyMeter meter;
+
+    /* Frames are received ahead of decoding; dropped ones never get painted */
+    meter.mark(RtspStreamLatencyMeter::Received, 3600, 1000);
+    meter.mark(RtspStreamLatencyMeter::Received, 7200, 2000);
+    meter.mark(RtspStreamLatencyMeter::Received, 10800, 3000);
+    meter.mark(RtspStreamLatencyMeter::Decoded, 3600, 4000);
+    meter.mark(RtspStreamLatencyMeter::Decoded, 7200, 6000);
+    meter.mark(RtspStreamLatencyMeter::Decoded, 10800, 7000);
+    meter.mark(RtspStreamLatencyMeter::Painted, 10800, 9000);
+    meter.mark(RtspStreamLatencyMeter::Painted, 3600, 10000);
+
+    /* Frames that were never received are not followed */
+    meter.mark(RtspStreamLatencyMeter::Decoded, 14400, 11000);
+    meter.mark(RtspStreamLatencyMeter::Painted, 14400, 12000);
+
+    RtspStreamLatencyMeter::Percentiles percentiles = meter.percentiles(RtspStreamLatencyMeter::Received,
+                                                                        RtspStreamLatencyMeter::Painted);
+    QCOMPARE(percentiles.samples, 2);
+    QCOMPARE(percentiles.median, Q_INT64_C(6000));
+    QCOMPARE(percentiles.max, Q_INT64_C(9000));
+}
+
+void RtspStreamLatencyMeterTestCase::testFirstPaintCounts()
+{
+    RtspStreamLatencyMeter meter;
+
+    meter.mark(RtspStreamLatencyMeter::Received, 1, 0);
+    meter.mark(RtspStreamLatencyMeter::Decoded, 1, 1000);
+    meter.mark(RtspStreamLatencyMeter::Painted, 1, 2000);
+    /* Painted again, e.g. in a second window */
+    meter.mark(RtspStreamLatencyMeter::Painted, 1, 5000);
+
+    RtspStreamLatencyMeter::Percentiles percentiles = meter.percentiles(RtspStreamLatencyMeter::Decoded,
+                                                                        RtspStreamLatencyMeter::Painted);
+    QCOMPARE(percentiles.samples, 1);
+    QCOMPARE(percentiles.max, Q_INT64_C(1000));
+}
+
+QTEST_MAIN(RtspStreamLatencyMeterTestCase)
+
+#include "RtspStreamLatencyMeterTestCase.moc"
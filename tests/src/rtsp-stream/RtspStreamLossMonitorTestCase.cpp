@@ -0,0 +1,138 @@
+#include "rtsp-stream/RtspStreamLossMonitor.h"
+#include <QtTest/QtTest>
+
+const char *jpegFormatName = "jpeg"; // hack
+
+class RtspStreamLossMonitorTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testNoLoss();
+    void testLoss();
+    void testReorder();
+    void testReorderedTimestamps();
+    void testConcealment();
+    void testConcealmentWindow();
+
+};
+
+/* 25 fps in the 90 kHz RTP clock */
+static const qint64 frameStep = 3600;
+
+void RtspStreamLossMonitorTestCase::testNoLoss()
+{
+    RtspStreamLossMonitor monitor;
+    monitor.setTimeBase(1, 90000);
+
+    for (qint64 frame = 0; frame < 200; ++frame)
+        monitor.packetReceived(900000 + frame * frameStep);
+
+    RtspStreamLossMonitor::Statistics statistics = monitor.statistics();
+    QCOMPARE(statistics.receivedFrames, 200);
+    QCOMPARE(statistics.lostFrames, 0);
+    QCOMPARE(statistics.reorderedFrames, 0);
+    QCOMPARE(statistics.lossRate(), 0.0);
+}
+
+void RtspStreamLossMonitorTestCase::testLoss()
+{
+    RtspStreamLossMonitor monitor;
+    monitor.setTimeBase(1, 90000);
+
+    /* Frames 10, 50 and 51 are lost; a two second stall is not loss */
+    for (qint64 frame = 0; frame < 100; ++frame)
+    {
+        if (frame == 10 || frame == 50 || frame == 51)
+            continue;
+        monitor.packetReceived(frame * frameStep + (frame >= 80 ? 2 * 90000 : 0));
+    }
+
+    RtspStreamLossMonitor::Statistics statistics = monitor.statistics();
+    QCOMPARE(statistics.receivedFrames, 97);
+    QCOMPARE(statistics.lostFrames, 3);
+    QCOMPARE(statistics.lossRate(), 0.03);
+}
+
+void RtspStreamLossMonitorTestCase::testReorder()
+{
+    RtspStreamLossMonitor monitor;
+    monitor.setTimeBase(1, 90000);
+
+    /* Frame 21 arrives after 22; both are counted as received, none as lost */
+    for (qint64 frame = 0; frame < 40; ++frame)
+    {
+        if (frame == 21)
+            continue;
+        monitor.packetReceived(frame * frameStep);
+        if (frame == 22)
+            monitor.packetReceived(21 * frameStep);
+    }
+
+    RtspStreamLossMonitor::Statistics statistics = monitor.statistics();
+    QCOMPARE(statistics.receivedFrames, 40);
+    QCOMPARE(statistics.reorderedFrames, 1);
+    /* The gap is counted before the late frame shows up */
+    QCOMPARE(statistics.lostFrames, 1);
+}
+
+void RtspStreamLossMonitorTestCase::testReorderedTimestamps()
+{
+    RtspStreamLossMonitor monitor;
+    monitor.setTimeBase(1, 90000);
+    monitor.setReorderedTimestamps(true);
+
+    /* I P B B order of a stream with B-frames */
+    qint64 order[] = { 0, 3, 1, 2, 6, 4, 5 };
+    for (unsigned i = 0; i < sizeof(order) / sizeof(order[0]); ++i)
+        monitor.packetReceived(order[i] * frameStep);
+
+    RtspStreamLossMonitor::Statistics statistics = monitor.statistics();
+    QCOMPARE(statistics.receivedFrames, 7);
+    QCOMPARE(statistics.lostFrames, 0);
+    QCOMPARE(statistics.reorderedFrames, 0);
+}
+
+void RtspStreamLossMonitorTestCase::testConcealment()
+{
+    RtspStreamLossMonitor monitor;
+    monitor.setTimeBase(1, 90000);
+    monitor.setConcealmentWindow(500);
+
+    for (qint64 frame = 0; frame < 10; ++frame)
+        monitor.packetReceived(frame * frameStep);
+    QVERIFY(monitor.frameDecoded(false, false, 0));
+
+    /* After a loss, frames are held back until an intact keyframe */
+    monitor.packetReceived(11 * frameStep);
+    QVERIFY(!monitor.frameDecoded(false, false, 40));
+    QVERIFY(!monitor.frameDecoded(true, false, 80));
+    QVERIFY(!monitor.frameDecoded(true, true, 120));
+    QVERIFY(monitor.frameDecoded(false, true, 160));
+    QVERIFY(monitor.frameDecoded(false, false, 200));
+
+    RtspStreamLossMonitor::Statistics statistics = monitor.statistics();
+    QCOMPARE(statistics.lostFrames, 1);
+    QCOMPARE(statistics.corruptFrames, 2);
+    QCOMPARE(statistics.concealedFrames, 3);
+}
+
+void RtspStreamLossMonitorTestCase::testConcealmentWindow()
+{
+    RtspStreamLossMonitor monitor;
+
+    /* Without a window, corrupt frames are shown as decoded */
+    QVERIFY(monitor.frameDecoded(true, false, 0));
+
+    /* The decoder's own concealment is shown once the window is over */
+    monitor.setConcealmentWindow(100);
+    QVERIFY(!monitor.frameDecoded(true, false, 1000));
+    QVERIFY(!monitor.frameDecoded(false, false, 1050));
+    QVERIFY(monitor.frameDecoded(false, false, 1100));
+    QVERIFY(monitor.frameDecoded(false, false, 1150));
+    QCOMPARE(monitor.statistics().concealedFrames, 2);
+}
+
+QTEST_MAIN(RtspStreamLossMonitorTestCase)
+
+#include "RtspStreamLossMonitorTestCase.moc"
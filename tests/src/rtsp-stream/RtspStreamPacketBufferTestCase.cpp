@@ -0,0 +1,181 @@
+#include "rtsp-stream/RtspStreamPacketBuffer.h"
+#include <QtTest/QtTest>
+
+extern "C" {
+#   include "libavcodec/avcodec.h"
+}
+
+const char *jpegFormatName = "jpeg"; // hack
+
+class RtspStreamPacketBufferTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void cleanup();
+
+    void testStartsWithKeyframe();
+    void testTrimByDuration();
+    void testReplayFromKeyframe();
+    void testMemoryLimit();
+    void testMemoryLimitShared();
+    void testMemoryLimitKeepsCurrentGroup();
+    void testDisabled();
+
+private:
+    /* 25 fps with a keyframe every second, in a 90 kHz time base */
+    void appendFrames(RtspStreamPacketBuffer &buffer, int first, int count, int size = 1000);
+    qint64 frameTime(int frame) const { return qint64(frame) * 3600; }
+
+};
+
+void RtspStreamPacketBufferTestCase::cleanup()
+{
+    RtspStreamPacketBuffer::setMemoryLimit(256 * 1024 * 1024);
+}
+
+void RtspStreamPacketBufferTestCase::appendFrames(RtspStreamPacketBuffer &buffer, int first, int count, int size)
+{
+    for (int frame = first; frame < first + count; ++frame)
+    {
+        AVPacket *packet = av_packet_alloc();
+        av_new_packet(packet, size);
+        packet->pts = packet->dts = frameTime(frame);
+        if (frame % 25 == 0)
+            packet->flags |= AV_PKT_FLAG_KEY;
+
+        buffer.append(packet);
+        av_packet_free(&packet);
+    }
+}
+
+void RtspStreamPacketBufferTestCase::testStartsWithKeyframe()
+{
+    RtspStreamPacketBuffer buffer;
+    buffer.setTimeBase(1, 90000);
+
+    appendFrames(buffer, 10, 15);
+    QCOMPARE(buffer.packetCount(), 0);
+
+    appendFrames(buffer, 25, 5);
+    QCOMPARE(buffer.packetCount(), 5);
+}
+
+void RtspStreamPacketBufferTestCase::testTrimByDuration()
+{
+    RtspStreamPacketBuffer buffer;
+    buffer.setTimeBase(1, 90000);
+    buffer.setDuration(4);
+
+    /* Whole groups of pictures are dropped once the newer ones cover 4 seconds */
+    appendFrames(buffer, 0, 25 * 10);
+    QCOMPARE(buffer.packetCount(), 25 * 5);
+    QCOMPARE(buffer.bufferedMsecs(), 4960);
+}
+
+void RtspStreamPacketBufferTestCase::testReplayFromKeyframe()
+{
+    RtspStreamPacketBuffer buffer;
+    buffer.setTimeBase(1, 90000);
+    buffer.setDuration(30);
+
+    appendFrames(buffer, 0, 25 * 10 + 12);
+
+    QList<AVPacket *> packets = buffer.packets(3);
+    QCOMPARE(packets.size(), 25 * 3 + 12);
+    QVERIFY(packets.first()->flags & AV_PKT_FLAG_KEY);
+    QCOMPARE(packets.first()->pts, frameTime(25 * 7));
+    QCOMPARE(buffer.packetTime(packets.first()), Q_INT64_C(7000000));
+
+    foreach (AVPacket *packet, packets)
+        av_packet_free(&packet);
+
+    /* More than is buffered */
+    packets = buffer.packets(60);
+    QCOMPARE(packets.size(), buffer.packetCount());
+
+    foreach (AVPacket *packet, packets)
+        av_packet_free(&packet);
+}
+
+void RtspStreamPacketBufferTestCase::testMemoryLimit()
+{
+    RtspStreamPacketBuffer::setMemoryLimit(100 * 1024);
+
+    RtspStreamPacketBuffer buffer;
+    buffer.setTimeBase(1, 90000);
+    buffer.setDuration(30);
+
+    appendFrames(buffer, 0, 25 * 10);
+    QVERIFY(buffer.memoryUsage() <= 100 * 1024);
+    QVERIFY(RtspStreamPacketBuffer::totalMemoryUsage() <= 100 * 1024);
+    QVERIFY(buffer.packetCount() > 0);
+
+    buffer.clear();
+    QCOMPARE(buffer.memoryUsage(), 0);
+    QCOMPARE(RtspStreamPacketBuffer::totalMemoryUsage(), Q_INT64_C(0));
+}
+
+void RtspStreamPacketBufferTestCase::testMemoryLimitShared()
+{
+    RtspStreamPacketBuffer::setMemoryLimit(100 * 1024);
+
+    RtspStreamPacketBuffer first;
+    first.setTimeBase(1, 90000);
+    first.setDuration(30);
+    appendFrames(first, 0, 25 * 10);
+    int firstUsage = first.memoryUsage();
+
+    /* A stream started later keeps its groups while it holds less than half the budget;
+     * it does not evict the first stream either */
+    RtspStreamPacketBuffer second;
+    second.setTimeBase(1, 90000);
+    second.setDuration(30);
+    appendFrames(second, 0, 25 + 12);
+    QCOMPARE(second.packetCount(), 25 + 12);
+    QCOMPARE(first.memoryUsage(), firstUsage);
+
+    /* Above its share, it drops its oldest group but keeps the one in progress */
+    appendFrames(second, 25 + 12, 25 * 2);
+    QList<AVPacket *> packets = second.packets(60);
+    QCOMPARE(packets.size(), 25 + 12);
+    QVERIFY(packets.first()->flags & AV_PKT_FLAG_KEY);
+    foreach (AVPacket *packet, packets)
+        av_packet_free(&packet);
+
+    /* The first stream gives up its excess once it appends again */
+    appendFrames(first, 25 * 10, 1);
+    QVERIFY(first.memoryUsage() <= 50 * 1024);
+}
+
+void RtspStreamPacketBufferTestCase::testMemoryLimitKeepsCurrentGroup()
+{
+    RtspStreamPacketBuffer::setMemoryLimit(10 * 1024);
+
+    RtspStreamPacketBuffer buffer;
+    buffer.setTimeBase(1, 90000);
+    buffer.setDuration(30);
+
+    /* A single group of pictures larger than the budget */
+    appendFrames(buffer, 0, 20);
+    QCOMPARE(buffer.packetCount(), 20);
+
+    /* The next keyframe lets the old group go */
+    appendFrames(buffer, 20, 6);
+    QCOMPARE(buffer.packetCount(), 1);
+}
+
+void RtspStreamPacketBufferTestCase::testDisabled()
+{
+    RtspStreamPacketBuffer buffer;
+    buffer.setTimeBase(1, 90000);
+    buffer.setDuration(0);
+
+    appendFrames(buffer, 0, 50);
+    QCOMPARE(buffer.packetCount(), 0);
+    QVERIFY(buffer.packets(10).isEmpty());
+}
+
+QTEST_MAIN(RtspStreamPacketBufferTestCase)
+
+#include "RtspStreamPacketBufferTestCase.moc"
@@ -0,0 +1,86 @@
+#include "rtsp-stream/RtspStreamProbeCache.h"
+#include <QtTest/QtTest>
+#include <QDebug>
+#include <QUrl>
+
+extern "C" {
+#   include "libavformat/avformat.h"
+}
+
+const char *jpegFormatName = "jpeg"; // hack
+
+class RtspStreamProbeCacheTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testMissingEntry();
+    void testApplyStoredParameters();
+    void testMismatchDropsEntry();
+
+private:
+    AVFormatContext * createContext(AVCodecID codecId, int width, int height);
+
+};
+
+AVFormatContext * RtspStreamProbeCacheTestCase::createContext(AVCodecID codecId, int width, int height)
+{
+    AVFormatContext *context = avformat_alloc_context();
+    AVStream *stream = avformat_new_stream(context, 0);
+    stream->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    stream->codecpar->codec_id = codecId;
+    stream->codecpar->width = width;
+    stream->codecpar->height = height;
+    return context;
+}
+
+void RtspStreamProbeCacheTestCase::testMissingEntry()
+{
+    RtspStreamProbeCache cache;
+    AVFormatContext *context = createContext(AV_CODEC_ID_H264, 0, 0);
+
+    QVERIFY(!cache.apply(QUrl(QLatin1String("rtsp://server/live/1")), context));
+
+    avformat_free_context(context);
+}
+
+void RtspStreamProbeCacheTestCase::testApplyStoredParameters()
+{
+    RtspStreamProbeCache cache;
+    QUrl url(QLatin1String("rtsp://server/live/1"));
+
+    AVFormatContext *probed = createContext(AV_CODEC_ID_H264, 1280, 720);
+    probed->streams[0]->codecpar->format = AV_PIX_FMT_YUV420P;
+    cache.store(url, probed);
+    avformat_free_context(probed);
+
+    /* The server only describes the codec; the rest comes from the cache */
+    AVFormatContext *described = createContext(AV_CODEC_ID_H264, 0, 0);
+    QVERIFY(cache.apply(url, described));
+    QCOMPARE(described->streams[0]->codecpar->width, 1280);
+    QCOMPARE(described->streams[0]->codecpar->height, 720);
+    QCOMPARE(described->streams[0]->codecpar->format, int(AV_PIX_FMT_YUV420P));
+    avformat_free_context(described);
+}
+
+void RtspStreamProbeCacheTestCase::testMismatchDropsEntry()
+{
+    RtspStreamProbeCache cache;
+    QUrl url(QLatin1String("rtsp://server/live/1"));
+
+    AVFormatContext *probed = createContext(AV_CODEC_ID_H264, 1280, 720);
+    cache.store(url, probed);
+    avformat_free_context(probed);
+
+    AVFormatContext *described = createContext(AV_CODEC_ID_MJPEG, 0, 0);
+    QVERIFY(!cache.apply(url, described));
+    avformat_free_context(described);
+
+    described = createContext(AV_CODEC_ID_H264, 0, 0);
+    QVERIFY(!cache.apply(url, described));
+    avformat_free_context(described);
+}
+
+QTEST_MAIN(RtspStreamProbeCacheTestCase)
+
+#include "RtspStreamProbeCacheTestCase.moc"
@@ -0,0 +1,233 @@
+#include "rtsp-stream/RtspStreamReconnectScheduler.h"
+#include "core/LiveStream.h"
+#include <QtTest/QtTest>
+
+const char *jpegFormatName = "jpeg"; // hack
+
+class TestServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    void setOnline(bool online) { emit onlineChanged(online); }
+
+signals:
+    void onlineChanged(bool online);
+};
+
+/* Reports its attempts to the scheduler like RtspStream; connecting never finishes on its own */
+class TestStream : public LiveStream
+{
+public:
+    int starts;
+
+    TestStream(RtspStreamReconnectScheduler *scheduler, QObject *server)
+        : starts(0), m_scheduler(scheduler), m_server(server), m_state(NotConnected)
+    {
+    }
+
+    virtual ~TestStream() { m_scheduler->remove(this); }
+
+    void fail()
+    {
+        m_state = Error;
+        m_scheduler->failed(this);
+    }
+
+    void succeed()
+    {
+        m_state = Streaming;
+        m_scheduler->connected(this);
+    }
+
+    int bandwidthMode() const { return 0; }
+    bool hwAccelStatus() const { return false; }
+    State state() const { return m_state; }
+    QString errorMessage() const { return QString(); }
+    LiveStreamFrame currentFrame() const { return LiveStreamFrame(); }
+    QSize streamSize() const { return QSize(); }
+    float receivedFps() const { return 0; }
+    bool isPaused() const { return false; }
+    bool isConnected() const { return m_state > Connecting; }
+    bool hasAudio() const { return false; }
+    bool isAudioEnabled() const { return false; }
+    void setFrameSizeHint(const QObject *consumer, int width, int height) { Q_UNUSED(consumer); Q_UNUSED(width); Q_UNUSED(height); }
+    void ref(const QObject *consumer) { Q_UNUSED(consumer); }
+    void unref(const QObject *consumer) { Q_UNUSED(consumer); }
+
+    void start()
+    {
+        ++starts;
+        m_state = Connecting;
+        m_scheduler->connecting(this, m_server);
+    }
+
+    void stop() { m_state = NotConnected; }
+    void setPaused(bool paused) { Q_UNUSED(paused); }
+    void setOnline(bool online) { Q_UNUSED(online); }
+    void setBandwidthMode(int bandwidthMode) { Q_UNUSED(bandwidthMode); }
+    void enableAudio(bool enable) { Q_UNUSED(enable); }
+    void enableHWAccel(bool hwAccel) { Q_UNUSED(hwAccel); }
+
+private:
+    RtspStreamReconnectScheduler *m_scheduler;
+    QObject *m_server;
+    State m_state;
+};
+
+class RtspStreamReconnectSchedulerTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testBackoffDelay();
+    void testJitter();
+    void testServerLimit();
+    void testServerOnline();
+
+private:
+    static int startedCount(const QList<TestStream *> &streams);
+    /* Milliseconds until the stream is due */
+    static qint64 delay(const RtspStreamReconnectScheduler &scheduler, TestStream *stream);
+};
+
+int RtspStreamReconnectSchedulerTestCase::startedCount(const QList<TestStream *> &streams)
+{
+    int count = 0;
+    foreach (TestStream *stream, streams)
+    {
+        if (stream->starts)
+            ++count;
+    }
+    return count;
+}
+
+qint64 RtspStreamReconnectSchedulerTestCase::delay(const RtspStreamReconnectScheduler &scheduler, TestStream *stream)
+{
+    return scheduler.m_streams.value(stream).dueTime - scheduler.m_clock.elapsed();
+}
+
+void RtspStreamReconnectSchedulerTestCase::testBackoffDelay()
+{
+    QCOMPARE(RtspStreamReconnectScheduler::backoffDelay(1), 1000);
+    QCOMPARE(RtspStreamReconnectScheduler::backoffDelay(2), 2000);
+    QCOMPARE(RtspStreamReconnectScheduler::backoffDelay(3), 4000);
+    QCOMPARE(RtspStreamReconnectScheduler::backoffDelay(6), 32000);
+    QCOMPARE(RtspStreamReconnectScheduler::backoffDelay(7), 60000);
+    QCOMPARE(RtspStreamReconnectScheduler::backoffDelay(100), 60000);
+}
+
+void RtspStreamReconnectSchedulerTestCase::testJitter()
+{
+    RtspStreamReconnectScheduler scheduler;
+    TestServer server;
+
+    for (int attempt = 1; attempt <= 8; ++attempt)
+    {
+        int backoff = RtspStreamReconnectScheduler::backoffDelay(attempt);
+        qint64 shortest = backoff, longest = 0;
+
+        QList<TestStream *> streams;
+        for (int i = 0; i < 50; ++i)
+        {
+            TestStream *stream = new TestStream(&scheduler, &server);
+            streams.append(stream);
+
+            for (int failures = 0; failures < attempt; ++failures)
+            {
+                scheduler.connecting(stream, &server);
+                stream->fail();
+            }
+
+            qint64 streamDelay = delay(scheduler, stream);
+            /* Some time passes between failing and measuring */
+            QVERIFY(streamDelay >= backoff / 2 - 100);
+            QVERIFY(streamDelay <= backoff);
+            shortest = qMin(shortest, streamDelay);
+            longest = qMax(longest, streamDelay);
+        }
+
+        /* Streams that failed together are spread out */
+        QVERIFY(longest - shortest >= backoff / 10);
+        qDeleteAll(streams);
+    }
+}
+
+void RtspStreamReconnectSchedulerTestCase::testServerLimit()
+{
+    RtspStreamReconnectScheduler scheduler;
+    TestServer first, second;
+
+    QList<TestStream *> firstStreams, secondStreams;
+    for (int i = 0; i < 6; ++i)
+        firstStreams.append(new TestStream(&scheduler, &first));
+    for (int i = 0; i < 2; ++i)
+        secondStreams.append(new TestStream(&scheduler, &second));
+
+    foreach (TestStream *stream, firstStreams)
+        scheduler.queueStart(stream, &first);
+    foreach (TestStream *stream, secondStreams)
+        scheduler.queueStart(stream, &second);
+
+    /* The limit is per server */
+    QTRY_COMPARE(startedCount(firstStreams), 4);
+    QTRY_COMPARE(startedCount(secondStreams), 2);
+    QTest::qWait(100);
+    QCOMPARE(startedCount(firstStreams), 4);
+
+    /* Every finished attempt lets one more start */
+    TestStream *connecting = 0;
+    foreach (TestStream *stream, firstStreams)
+    {
+        if (stream->starts)
+            connecting = stream;
+    }
+    connecting->succeed();
+    QTRY_COMPARE(startedCount(firstStreams), 5);
+
+    /* A failure also ends the attempt, and the stream waits for its retry */
+    foreach (TestStream *stream, firstStreams)
+    {
+        if (stream->state() == LiveStream::Connecting)
+        {
+            stream->fail();
+            break;
+        }
+    }
+    QTRY_COMPARE(startedCount(firstStreams), 6);
+
+    qDeleteAll(firstStreams);
+    qDeleteAll(secondStreams);
+}
+
+void RtspStreamReconnectSchedulerTestCase::testServerOnline()
+{
+    RtspStreamReconnectScheduler scheduler;
+    TestServer server, otherServer;
+    TestStream stream(&scheduler, &server);
+    TestStream otherStream(&scheduler, &otherServer);
+
+    /* Retrying would take at least 16 seconds */
+    for (int failures = 0; failures < 6; ++failures)
+    {
+        scheduler.connecting(&stream, &server);
+        stream.fail();
+        scheduler.connecting(&otherStream, &otherServer);
+        otherStream.fail();
+    }
+    QVERIFY(delay(scheduler, &stream) >= 16000 - 100);
+
+    server.setOnline(false);
+    QTest::qWait(100);
+    QCOMPARE(stream.starts, 0);
+
+    /* Only streams of the server coming online retry, with their backoff reset */
+    server.setOnline(true);
+    QTRY_COMPARE(stream.starts, 1);
+    QCOMPARE(scheduler.m_streams.value(&stream).failedAttempts, 0);
+    QCOMPARE(otherStream.starts, 0);
+    QCOMPARE(scheduler.m_streams.value(&otherStream).failedAttempts, 6);
+}
+
+QTEST_MAIN(RtspStreamReconnectSchedulerTestCase)
+#include "RtspStreamReconnectSchedulerTestCase.moc"
@@ -0,0 +1,154 @@
+#include "rtsp-stream/RtspStreamRecorder.h"
+#include <QtTest/QtTest>
+#include <QDir>
+#include <QEventLoop>
+#include <QPointer>
+#include <QTimer>
+
+extern "C" {
+#   include "libavcodec/avcodec.h"
+#   include "libavformat/avformat.h"
+}
+
+const char *jpegFormatName = "jpeg"; // hack
+
+class RtspStreamRecorderTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testRemux_data();
+    void testRemux();
+    void testUnsupportedFileType();
+
+private:
+    AVFormatContext * createInput();
+    void writeFrames(RtspStreamRecorder *recorder, int first, int count);
+    void stopAndWait(RtspStreamRecorder *recorder);
+    int countPackets(const QString &fileName);
+
+};
+
+void RtspStreamRecorderTestCase::initTestCase()
+{
+    av_register_all();
+}
+
+AVFormatContext * RtspStreamRecorderTestCase::createInput()
+{
+    AVFormatContext *context = avformat_alloc_context();
+    AVStream *stream = avformat_new_stream(context, 0);
+    stream->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    stream->codecpar->codec_id = AV_CODEC_ID_MJPEG;
+    stream->codecpar->width = 320;
+    stream->codecpar->height = 240;
+    stream->time_base.num = 1;
+    stream->time_base.den = 90000;
+    return context;
+}
+
+void RtspStreamRecorderTestCase::writeFrames(RtspStreamRecorder *recorder, int first, int count)
+{
+    for (int frame = first; frame < first + count; ++frame)
+    {
+        AVPacket *packet = av_packet_alloc();
+        av_new_packet(packet, 512);
+        memset(packet->data, frame, packet->size);
+        /* RTSP timestamps don't start at 0 */
+        packet->pts = packet->dts = 900000 + frame * 3600;
+        packet->stream_index = 0;
+        if (frame % 10 == 0)
+            packet->flags |= AV_PKT_FLAG_KEY;
+
+        recorder->write(packet);
+        av_packet_free(&packet);
+    }
+}
+
+void RtspStreamRecorderTestCase::stopAndWait(RtspStreamRecorder *recorder)
+{
+    QPointer<RtspStreamRecorder> guard(recorder);
+    QEventLoop loop;
+    connect(recorder, SIGNAL(destroyed()), &loop, SLOT(quit()));
+    QTimer::singleShot(10000, &loop, SLOT(quit()));
+
+    recorder->stop();
+    loop.exec();
+
+    QVERIFY(!guard);
+}
+
+int RtspStreamRecorderTestCase::countPackets(const QString &fileName)
+{
+    AVFormatContext *context = 0;
+    if (avformat_open_input(&context, QFile::encodeName(fileName).constData(), NULL, NULL) < 0)
+        return -1;
+
+    int count = 0;
+    AVPacket packet;
+    while (av_read_frame(context, &packet) == 0)
+    {
+        if (count == 0 && (!(packet.flags & AV_PKT_FLAG_KEY) || packet.data[0] != 10))
+            count = -100;
+        ++count;
+        av_packet_unref(&packet);
+    }
+
+    avformat_close_input(&context);
+    return count;
+}
+
+void RtspStreamRecorderTestCase::testRemux_data()
+{
+    QTest::addColumn<QString>("extension");
+
+    QTest::newRow("Matroska") << QString::fromLatin1("mkv");
+    QTest::newRow("MP4") << QString::fromLatin1("mp4");
+}
+
+void RtspStreamRecorderTestCase::testRemux()
+{
+    QFETCH(QString, extension);
+
+    QString fileName = QDir::temp().filePath(QString::fromLatin1("RtspStreamRecorderTestCase.%1").arg(extension));
+    QFile::remove(fileName);
+
+    AVFormatContext *input = createInput();
+    RtspStreamRecorder *recorder = new RtspStreamRecorder(fileName, input, 0, -1);
+    avformat_free_context(input);
+
+    QSignalSpy failedSpy(recorder, SIGNAL(failed(QString)));
+    recorder->start();
+
+    /* Frames before the first keyframe are left out */
+    writeFrames(recorder, 5, 45);
+    stopAndWait(recorder);
+
+    QCOMPARE(failedSpy.count(), 0);
+    QCOMPARE(countPackets(fileName), 40);
+
+    QFile::remove(fileName);
+}
+
+void RtspStreamRecorderTestCase::testUnsupportedFileType()
+{
+    QString fileName = QDir::temp().filePath(QLatin1String("RtspStreamRecorderTestCase.unknown"));
+
+    AVFormatContext *input = createInput();
+    RtspStreamRecorder *recorder = new RtspStreamRecorder(fileName, input, 0, -1);
+    avformat_free_context(input);
+
+    QSignalSpy failedSpy(recorder, SIGNAL(failed(QString)));
+    recorder->start();
+    writeFrames(recorder, 0, 10);
+    stopAndWait(recorder);
+
+    QCOMPARE(failedSpy.count(), 1);
+    QVERIFY(!QFile::exists(fileName));
+}
+
+QTEST_MAIN(RtspStreamRecorderTestCase)
+
+#include "RtspStreamRecorderTestCase.moc"
@@ -0,0 +1,132 @@
+#include "rtsp-stream/RtspStreamStatistics.h"
+#include <QtTest/QtTest>
+#include <climits>
+
+const char *jpegFormatName = "jpeg"; // hack
+
+class RtspStreamStatisticsTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testEmpty();
+    void testPercentiles();
+    void testExactValues();
+    void testCounters();
+    void testClear();
+    void testRollingWindow();
+
+};
+
+void RtspStreamStatisticsTestCase::testEmpty()
+{
+    RtspStreamStatistics statistics;
+    RtspStreamStatistics::Snapshot snapshot = statistics.snapshot();
+
+    for (int i = 0; i < RtspStreamStatistics::TimingCount; ++i)
+    {
+        QCOMPARE(snapshot.timings[i].samples, 0);
+        QCOMPARE(snapshot.timings[i].max, Q_INT64_C(0));
+    }
+    for (int i = 0; i < RtspStreamStatistics::CounterCount; ++i)
+        QCOMPARE(snapshot.counters[i], 0);
+}
+
+void RtspStreamStatisticsTestCase::testPercentiles()
+{
+    RtspStreamStatistics statistics;
+
+    /* 1 to 100 ms */
+    for (qint64 n = 1; n <= 100; ++n)
+        statistics.record(RtspStreamStatistics::Decode, n * 1000);
+
+    RtspStreamStatistics::Percentiles percentiles = statistics.percentiles(RtspStreamStatistics::Decode);
+    QCOMPARE(percentiles.samples, 100);
+    /* Upper bound of the bucket from 32768 to 65535 us, which holds 50 ms */
+    QCOMPARE(percentiles.median, Q_INT64_C(65535));
+    /* Buckets are capped by the maximum */
+    QCOMPARE(percentiles.p90, Q_INT64_C(100000));
+    QCOMPARE(percentiles.p99, Q_INT64_C(100000));
+    QCOMPARE(percentiles.max, Q_INT64_C(100000));
+
+    /* Other timings are not affected */
+    QCOMPARE(statistics.percentiles(RtspStreamStatistics::Paint).samples, 0);
+}
+
+void RtspStreamStatisticsTestCase::testExactValues()
+{
+    RtspStreamStatistics statistics;
+
+    statistics.record(RtspStreamStatistics::Convert, 0);
+    statistics.record(RtspStreamStatistics::Convert, -10);
+    statistics.record(RtspStreamStatistics::Convert, 1);
+
+    RtspStreamStatistics::Percentiles percentiles = statistics.percentiles(RtspStreamStatistics::Convert);
+    QCOMPARE(percentiles.samples, 3);
+    QCOMPARE(percentiles.median, Q_INT64_C(0));
+    QCOMPARE(percentiles.p99, Q_INT64_C(1));
+    QCOMPARE(percentiles.max, Q_INT64_C(1));
+
+    /* Values beyond the range of the histogram end up in the last bucket */
+    statistics.record(RtspStreamStatistics::ReadWait, Q_INT64_C(10000000000));
+    QCOMPARE(statistics.percentiles(RtspStreamStatistics::ReadWait).max, qint64(INT_MAX));
+}
+
+void RtspStreamStatisticsTestCase::testCounters()
+{
+    RtspStreamStatistics statistics;
+
+    statistics.increment(RtspStreamStatistics::DecodeErrors);
+    statistics.increment(RtspStreamStatistics::DecodeErrors);
+    statistics.increment(RtspStreamStatistics::ConvertFailures);
+
+    QCOMPARE(statistics.counter(RtspStreamStatistics::DecodeErrors), 2);
+    QCOMPARE(statistics.counter(RtspStreamStatistics::ConvertFailures), 1);
+    QCOMPARE(statistics.snapshot().counters[RtspStreamStatistics::DecodeErrors], 2);
+    QCOMPARE(QByteArray(RtspStreamStatistics::counterName(RtspStreamStatistics::DecodeErrors)),
+             QByteArray("decodeErrors"));
+    QCOMPARE(QByteArray(RtspStreamStatistics::timingName(RtspStreamStatistics::QueueResidency)),
+             QByteArray("queueResidency"));
+}
+
+void RtspStreamStatisticsTestCase::testClear()
+{
+    RtspStreamStatistics statistics;
+
+    statistics.record(RtspStreamStatistics::Paint, 500);
+    statistics.increment(RtspStreamStatistics::ConvertFailures);
+    statistics.clear();
+
+    QCOMPARE(statistics.percentiles(RtspStreamStatistics::Paint).samples, 0);
+    QCOMPARE(statistics.percentiles(RtspStreamStatistics::Paint).max, Q_INT64_C(0));
+    QCOMPARE(statistics.counter(RtspStreamStatistics::ConvertFailures), 0);
+}
+
+void RtspStreamStatisticsTestCase::testRollingWindow()
+{
+    RtspStreamStatistics statistics;
+    const qint64 window = RtspStreamStatistics::windowLength();
+
+    statistics.record(RtspStreamStatistics::Decode, 40000, 0);
+    statistics.record(RtspStreamStatistics::Decode, 1000, window + 1);
+
+    /* The previous window still counts */
+    RtspStreamStatistics::Percentiles percentiles = statistics.percentiles(RtspStreamStatistics::Decode, window + 1);
+    QCOMPARE(percentiles.samples, 2);
+    QCOMPARE(percentiles.max, Q_INT64_C(40000));
+
+    /* Older ones are forgotten, also when nothing new is recorded */
+    percentiles = statistics.percentiles(RtspStreamStatistics::Decode, 2 * window);
+    QCOMPARE(percentiles.samples, 1);
+    QCOMPARE(percentiles.max, Q_INT64_C(1000));
+    QCOMPARE(statistics.percentiles(RtspStreamStatistics::Decode, 3 * window).samples, 0);
+
+    /* A new window reuses the oldest set of histograms */
+    statistics.record(RtspStreamStatistics::Decode, 2000, 2 * window);
+    percentiles = statistics.percentiles(RtspStreamStatistics::Decode, 2 * window);
+    QCOMPARE(percentiles.samples, 2);
+    QCOMPARE(percentiles.max, Q_INT64_C(2000));
+}
+
+QTEST_MAIN(RtspStreamStatisticsTestCase)
+#include "RtspStreamStatisticsTestCase.moc"
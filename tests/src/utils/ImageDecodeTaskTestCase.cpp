@@ -0,0 +1,143 @@
+#include "utils/ImageDecodeTask.h"
+#include <QtTest/QtTest>
+#include <QBuffer>
+#include <QImage>
+#include <QThreadPool>
+
+const char *jpegFormatName = "jpeg"; // hack
+
+class DecodeReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    QImage result;
+    QSize imageSize;
+    bool finished;
+
+    DecodeReceiver() : finished(false) {}
+
+public slots:
+    void decoded(ThreadTask *task)
+    {
+        ImageDecodeTask *decodeTask = static_cast<ImageDecodeTask*>(task);
+        result = decodeTask->result();
+        imageSize = decodeTask->imageSize();
+        finished = true;
+    }
+};
+
+class ImageDecodeTaskTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testScaleDivisor_data();
+    void testScaleDivisor();
+    void testScaledDecode();
+    void testOutputImage();
+
+private:
+    static QByteArray encodeJpeg(const QSize &size);
+    static void decode(DecodeReceiver *receiver, const QByteArray &data, const QSize &scaleHint,
+                       QImage *outputImage = 0);
+};
+
+QByteArray ImageDecodeTaskTestCase::encodeJpeg(const QSize &size)
+{
+    QImage image(size, QImage::Format_RGB32);
+    image.fill(qRgb(40, 120, 200));
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "JPEG");
+    return data;
+}
+
+void ImageDecodeTaskTestCase::decode(DecodeReceiver *receiver, const QByteArray &data, const QSize &scaleHint,
+                                     QImage *outputImage)
+{
+    ImageDecodeTask *task = new ImageDecodeTask(receiver, "decoded", 1);
+    task->setData(data);
+    task->setScaleHint(scaleHint);
+    if (outputImage)
+    {
+        /* Handed over, so the task holds the only reference */
+        task->setOutputImage(*outputImage);
+        *outputImage = QImage();
+    }
+    QThreadPool::globalInstance()->start(task);
+
+    QTRY_VERIFY(receiver->finished);
+}
+
+void ImageDecodeTaskTestCase::testScaleDivisor_data()
+{
+    QTest::addColumn<QSize>("imageSize");
+    QTest::addColumn<QSize>("hint");
+    QTest::addColumn<int>("divisor");
+
+    QTest::newRow("no hint") << QSize(1920, 1080) << QSize() << 1;
+    QTest::newRow("empty hint") << QSize(1920, 1080) << QSize(0, 0) << 1;
+    QTest::newRow("invalid image") << QSize() << QSize(320, 240) << 1;
+    QTest::newRow("full size") << QSize(1920, 1080) << QSize(1920, 1080) << 1;
+    QTest::newRow("larger than image") << QSize(640, 480) << QSize(1280, 960) << 1;
+    QTest::newRow("half") << QSize(1920, 1080) << QSize(960, 540) << 2;
+    QTest::newRow("just over half") << QSize(1920, 1080) << QSize(961, 540) << 1;
+    QTest::newRow("quarter") << QSize(1920, 1080) << QSize(400, 250) << 4;
+    QTest::newRow("eighth") << QSize(1920, 1080) << QSize(240, 135) << 8;
+    QTest::newRow("tiny tile") << QSize(1920, 1080) << QSize(16, 16) << 8;
+    QTest::newRow("limited by height") << QSize(1920, 1080) << QSize(200, 300) << 2;
+    QTest::newRow("rounded up") << QSize(704, 485) << QSize(88, 61) << 8;
+}
+
+void ImageDecodeTaskTestCase::testScaleDivisor()
+{
+    QFETCH(QSize, imageSize);
+    QFETCH(QSize, hint);
+    QFETCH(int, divisor);
+
+    QCOMPARE(ImageDecodeTask::scaleDivisor(imageSize, hint), divisor);
+}
+
+void ImageDecodeTaskTestCase::testScaledDecode()
+{
+    QByteArray data = encodeJpeg(QSize(640, 480));
+
+    DecodeReceiver fullReceiver;
+    decode(&fullReceiver, data, QSize());
+    QCOMPARE(fullReceiver.imageSize, QSize(640, 480));
+    QCOMPARE(fullReceiver.result.size(), QSize(640, 480));
+
+    DecodeReceiver scaledReceiver;
+    decode(&scaledReceiver, data, QSize(150, 100));
+    QCOMPARE(scaledReceiver.imageSize, QSize(640, 480));
+    QCOMPARE(scaledReceiver.result.size(), QSize(160, 120));
+}
+
+void ImageDecodeTaskTestCase::testOutputImage()
+{
+    QByteArray data = encodeJpeg(QSize(320, 240));
+
+    DecodeReceiver firstReceiver;
+    decode(&firstReceiver, data, QSize());
+    QVERIFY(!firstReceiver.result.isNull());
+
+    QImage outputImage = firstReceiver.result;
+    const uchar *outputBits = outputImage.constBits();
+    firstReceiver.result = QImage();
+
+    DecodeReceiver secondReceiver;
+    decode(&secondReceiver, data, QSize(), &outputImage);
+    QCOMPARE(secondReceiver.result.size(), QSize(320, 240));
+    QVERIFY(secondReceiver.result.constBits() == outputBits);
+
+    /* Garbage leaves nothing of the output image behind */
+    DecodeReceiver garbageReceiver;
+    decode(&garbageReceiver, QByteArray("not an image"), QSize(), &secondReceiver.result);
+    QVERIFY(garbageReceiver.result.isNull());
+}
+
+QTEST_MAIN(ImageDecodeTaskTestCase)
+#include "ImageDecodeTaskTestCase.moc"
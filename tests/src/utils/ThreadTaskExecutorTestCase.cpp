@@ -0,0 +1,164 @@
+#include "utils/ThreadTask.h"
+#include "utils/ThreadTaskExecutor.h"
+#include <QtTest/QtTest>
+#include <QSemaphore>
+#include <QThread>
+
+const char *jpegFormatName = "jpeg"; // hack
+
+class TestTask : public ThreadTask
+{
+public:
+    const int id;
+    bool ran;
+
+    TestTask(QObject *caller, int id, QSemaphore *block = 0)
+        : ThreadTask(caller, "finished"), id(id), ran(false), m_block(block)
+    {
+    }
+
+protected:
+    virtual void runTask()
+    {
+        if (isCancelled())
+            return;
+
+        ran = true;
+        if (m_block)
+            m_block->acquire();
+    }
+
+private:
+    QSemaphore *m_block;
+};
+
+class TaskReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    QList<int> ran;
+    QList<int> discarded;
+
+    int count() const { return ran.size() + discarded.size(); }
+
+public slots:
+    void finished(ThreadTask *task)
+    {
+        TestTask *testTask = static_cast<TestTask*>(task);
+        if (testTask->ran)
+            ran.append(testTask->id);
+        else
+            discarded.append(testTask->id);
+    }
+};
+
+class ThreadTaskExecutorTestCase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void testRunAll();
+    void testLatestOnly();
+    void testLatestOnlyPerCaller();
+    void testSeparatePools();
+};
+
+void ThreadTaskExecutorTestCase::initTestCase()
+{
+    ThreadTaskExecutor::init();
+}
+
+void ThreadTaskExecutorTestCase::testRunAll()
+{
+    ThreadTaskExecutor *executor = ThreadTaskExecutor::instance();
+    TaskReceiver receiver;
+
+    for (int i = 0; i < 10; ++i)
+        executor->start(new TestTask(&receiver, i), ThreadTaskExecutor::BackgroundPool);
+
+    QTRY_COMPARE(receiver.count(), 10);
+    QCOMPARE(receiver.ran.size(), 10);
+}
+
+void ThreadTaskExecutorTestCase::testLatestOnly()
+{
+    ThreadTaskExecutor *executor = ThreadTaskExecutor::instance();
+    ThreadTaskExecutor::Metrics before = executor->metrics(ThreadTaskExecutor::FrameDecodePool);
+    TaskReceiver receiver;
+    QSemaphore block;
+
+    executor->start(new TestTask(&receiver, 1, &block), ThreadTaskExecutor::FrameDecodePool,
+                    ThreadTaskExecutor::NormalPriority, ThreadTaskExecutor::LatestOnly);
+    QTRY_COMPARE(executor->metrics(ThreadTaskExecutor::FrameDecodePool).running, before.running + 1);
+
+    for (int i = 2; i <= 4; ++i)
+        executor->start(new TestTask(&receiver, i), ThreadTaskExecutor::FrameDecodePool,
+                        ThreadTaskExecutor::NormalPriority, ThreadTaskExecutor::LatestOnly);
+
+    ThreadTaskExecutor::Metrics metrics = executor->metrics(ThreadTaskExecutor::FrameDecodePool);
+    QCOMPARE(metrics.waiting, before.waiting + 1);
+    QCOMPARE(metrics.coalesced, before.coalesced + 2);
+
+    /* Replaced tasks are delivered while the first one is still running */
+    QTRY_COMPARE(receiver.discarded, QList<int>() << 2 << 3);
+    QVERIFY(receiver.ran.isEmpty());
+
+    block.release();
+    QTRY_COMPARE(receiver.ran, QList<int>() << 1 << 4);
+
+    metrics = executor->metrics(ThreadTaskExecutor::FrameDecodePool);
+    QCOMPARE(metrics.waiting, before.waiting);
+    QCOMPARE(metrics.started, before.started + 2);
+}
+
+void ThreadTaskExecutorTestCase::testLatestOnlyPerCaller()
+{
+    ThreadTaskExecutor *executor = ThreadTaskExecutor::instance();
+    executor->setMaxThreadCount(ThreadTaskExecutor::FrameDecodePool, 2);
+    TaskReceiver first, second;
+    QSemaphore block;
+
+    executor->start(new TestTask(&first, 1, &block), ThreadTaskExecutor::FrameDecodePool,
+                    ThreadTaskExecutor::NormalPriority, ThreadTaskExecutor::LatestOnly);
+    executor->start(new TestTask(&second, 1), ThreadTaskExecutor::FrameDecodePool,
+                    ThreadTaskExecutor::NormalPriority, ThreadTaskExecutor::LatestOnly);
+    executor->start(new TestTask(&second, 2), ThreadTaskExecutor::FrameDecodePool,
+                    ThreadTaskExecutor::NormalPriority, ThreadTaskExecutor::LatestOnly);
+
+    /* One caller waiting for its decode does not hold up another one */
+    QTRY_COMPARE(second.ran, QList<int>() << 1 << 2);
+    QVERIFY(first.ran.isEmpty());
+
+    block.release();
+    QTRY_COMPARE(first.ran, QList<int>() << 1);
+
+    executor->setMaxThreadCount(ThreadTaskExecutor::FrameDecodePool, QThread::idealThreadCount());
+}
+
+void ThreadTaskExecutorTestCase::testSeparatePools()
+{
+    ThreadTaskExecutor *executor = ThreadTaskExecutor::instance();
+    executor->setMaxThreadCount(ThreadTaskExecutor::FrameDecodePool, 1);
+    TaskReceiver decode, background;
+    QSemaphore block;
+
+    executor->start(new TestTask(&decode, 1, &block), ThreadTaskExecutor::FrameDecodePool);
+    executor->start(new TestTask(&decode, 2), ThreadTaskExecutor::FrameDecodePool);
+    QTRY_COMPARE(executor->metrics(ThreadTaskExecutor::FrameDecodePool).queued, 1);
+    QCOMPARE(executor->metrics(ThreadTaskExecutor::FrameDecodePool).queueDepth(), 1);
+
+    /* A saturated decode pool does not hold up background work */
+    executor->start(new TestTask(&background, 1), ThreadTaskExecutor::BackgroundPool);
+    QTRY_COMPARE(background.ran, QList<int>() << 1);
+    QVERIFY(decode.ran.isEmpty());
+
+    block.release();
+    QTRY_COMPARE(decode.ran, QList<int>() << 1 << 2);
+
+    executor->setMaxThreadCount(ThreadTaskExecutor::FrameDecodePool, QThread::idealThreadCount());
+}
+
+QTEST_MAIN(ThreadTaskExecutorTestCase)
+#include "ThreadTaskExecutorTestCase.moc"